@@ -165,6 +165,8 @@ setup(
             sources=sorted(
                 set(glob("src/beanmachine/graph/**/*.cpp", recursive=True))
                 - set(glob("src/beanmachine/graph/**/*_test.cpp", recursive=True))
+                # the bmg_run command-line runner is built by `make bmg_run`
+                - set(glob("src/beanmachine/graph/cli/*.cpp"))
             ),
             include_dirs=INCLUDE_DIRS,
             extra_compile_args=CPP_COMPILE_ARGS,
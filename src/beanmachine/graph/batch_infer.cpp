@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+#include "beanmachine/graph/batch_infer.h"
+
+namespace beanmachine {
+namespace graph {
+
+namespace {
+
+struct ChainTask {
+  uint job;
+  uint chain;
+};
+
+// The chains of a job that are still running, with their graph copies.
+struct JobState {
+  std::vector<std::unique_ptr<Graph>> copies;
+  uint remaining = 0;
+  // the caller's setting, restored when the job finishes
+  bool show_progress = true;
+};
+
+class BatchScheduler {
+ public:
+  explicit BatchScheduler(std::vector<BatchInferJob>& jobs)
+      : jobs(jobs), states(jobs.size()) {
+    // the graphs of the jobs accepted so far, since the chains of a job
+    // write the inference results of its graph
+    std::set<const Graph*> graphs;
+    for (uint j = 0; j < jobs.size(); j++) {
+      BatchInferJob& job = jobs[j];
+      job.error.clear();
+      if (job.graph == nullptr or job.n_chains < 1) {
+        job.error = "a batch job needs a graph and at least one chain";
+      } else if (
+          job.infer_config.use_processes or job.infer_config.pin_threads or
+          job.infer_config.max_threads > 0 or
+          not job.infer_config.sample_store_path.empty()) {
+        job.error = "use_processes, pin_threads, max_threads and "
+                    "sample_store_path are not supported in batches";
+      } else if (not graphs.insert(job.graph).second) {
+        job.error = "the graph of a batch job is already used by another job";
+      } else {
+        // the first chain of a job copies the graph for the others
+        tasks.push_back({j, 0});
+        num_pending += job.n_chains;
+      }
+    }
+  }
+
+  void run(uint num_threads) {
+    std::vector<std::thread> threads;
+    for (uint i = 0; i < num_threads; i++) {
+      threads.emplace_back([this]() { work(); });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+
+ private:
+  void work() {
+    while (true) {
+      ChainTask task;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this]() {
+          return not tasks.empty() or num_pending == 0;
+        });
+        if (tasks.empty()) {
+          return;
+        }
+        task = tasks.front();
+        tasks.pop_front();
+      }
+      run_chain(task);
+    }
+  }
+
+  void run_chain(const ChainTask& task) {
+    BatchInferJob& job = jobs[task.job];
+    JobState& state = states[task.job];
+    Graph* graph = job.graph;
+    std::string error;
+    try {
+      if (task.chain == 0) {
+        start_job(task.job);
+      } else {
+        graph = state.copies[task.chain - 1].get();
+      }
+      graph->_infer(
+          job.num_samples,
+          job.algorithm,
+          job.seed + 13 * task.chain,
+          job.infer_config);
+    } catch (const std::exception& e) {
+      error = e.what();
+    } catch (...) {
+      error = "unknown error in chain " + std::to_string(task.chain);
+    }
+    std::unique_ptr<Graph> finished_copy;
+    bool job_finished = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (not error.empty() and job.error.empty()) {
+        job.error = error;
+      }
+      if (task.chain == 0 and state.remaining == 0) {
+        // the job failed before its other chains were scheduled
+        num_pending -= job.n_chains;
+        job_finished = true;
+      } else {
+        if (task.chain > 0) {
+          finished_copy = std::move(state.copies[task.chain - 1]);
+        }
+        num_pending--;
+        job_finished = --state.remaining == 0;
+      }
+    }
+    if (job_finished) {
+      job.graph->master_graph = nullptr;
+      job.graph->show_progress = state.show_progress;
+      state.copies.clear();
+    }
+    cv.notify_all();
+  }
+
+  // Prepares the result collectors of a job's graph like the multi-chain
+  // Graph::infer, and schedules its other chains on copies of the graph.
+  void start_job(uint j) {
+    BatchInferJob& job = jobs[j];
+    JobState& state = states[j];
+    Graph* graph = job.graph;
+    state.show_progress = graph->show_progress;
+    graph->agg_type = AggregationType::NONE;
+    graph->samples.clear();
+    graph->samples_allchains.clear();
+    graph->samples_allchains.resize(job.n_chains);
+    graph->log_prob_vals.clear();
+    graph->log_prob_allchains.clear();
+    graph->log_prob_allchains.resize(job.n_chains);
+    graph->master_graph = graph;
+    graph->thread_index = 0;
+    graph->show_progress = false;
+    // the copies are made before the first chain changes the graph
+    for (uint i = 1; i < job.n_chains; i++) {
+      auto copy = std::make_unique<Graph>(*graph);
+      copy->thread_index = i;
+      state.copies.push_back(std::move(copy));
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    state.remaining = job.n_chains;
+    // run the chains of a started job first, so that few copies are alive
+    for (uint i = job.n_chains - 1; i > 0; i--) {
+      tasks.push_front({j, i});
+    }
+  }
+
+  std::vector<BatchInferJob>& jobs;
+  std::vector<JobState> states;
+  std::deque<ChainTask> tasks;
+  // the number of chains that have not finished
+  uint num_pending = 0;
+  std::mutex mutex;
+  std::condition_variable cv;
+};
+
+} // namespace
+
+void infer_batch(std::vector<BatchInferJob>& jobs, uint num_threads) {
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  BatchScheduler scheduler(jobs);
+  scheduler.run(num_threads);
+}
+
+} // namespace graph
+} // namespace beanmachine
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+
+#include "beanmachine/graph/graph.h"
+
+namespace beanmachine {
+namespace graph {
+
+/*
+The inference of one graph in a batch, with the same arguments as the
+multi-chain Graph::infer.
+*/
+struct BatchInferJob {
+  Graph* graph;
+  uint num_samples;
+  InferenceType algorithm;
+  uint seed;
+  uint n_chains;
+  InferConfig infer_config;
+  // Set by infer_batch to the error of the first failed chain, if any.
+  std::string error;
+
+  BatchInferJob(
+      Graph* graph,
+      uint num_samples,
+      InferenceType algorithm,
+      uint seed,
+      uint n_chains = 1,
+      InferConfig infer_config = InferConfig())
+      : graph(graph),
+        num_samples(num_samples),
+        algorithm(algorithm),
+        seed(seed),
+        n_chains(n_chains),
+        infer_config(infer_config) {}
+};
+
+/*
+Run the inference of many independent graphs, scheduling the chains of all
+of them on a single pool of worker threads rather than starting threads for
+each graph as Graph::infer does. This amortizes the thread creation of small
+graphs, whose chains are too short to pay for it, across the whole batch.
+
+Each chain draws the same samples as with Graph::infer, and the results are
+stored in each job's graph, i.e. graph->samples_allchains and
+graph->get_log_prob(). A failed job does not stop the others: its error is
+recorded in the job. The graphs must be distinct (a job whose graph is
+already used by an earlier job fails), and their progress bars are not
+displayed. InferConfig::use_processes, pin_threads, max_threads
+and sample_store_path are not supported in batches.
+
+:param jobs: The inference jobs.
+:param num_threads: The number of worker threads; 0 uses one per hardware
+                    thread.
+*/
+void infer_batch(std::vector<BatchInferJob>& jobs, uint num_threads = 0);
+
+} // namespace graph
+} // namespace beanmachine
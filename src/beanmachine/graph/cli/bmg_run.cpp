@@ -0,0 +1,455 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/*
+bmg_run: runs inference on a graph saved with serialize_graph (see
+serialization.h) without going through Python, and writes the samples, the
+log probs and the performance report to files. It is not part of the Python
+extension; build it from the repository root with
+
+  make bmg_run
+
+which writes build/bmg_run (see the Makefile for the include directories).
+Run bmg_run --help for the options.
+*/
+
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "beanmachine/graph/cli/bmg_run.h"
+#include "beanmachine/graph/global/hmc.h"
+#include "beanmachine/graph/global/multiple_try.h"
+#include "beanmachine/graph/global/nuts.h"
+#include "beanmachine/graph/global/random_walk.h"
+#include "beanmachine/graph/graph.h"
+#include "beanmachine/graph/serialization.h"
+#include "beanmachine/graph/thread_pool.h"
+
+using namespace beanmachine::graph;
+using beanmachine::util::ChainScope;
+using beanmachine::util::ThreadBudget;
+
+namespace {
+
+const char* USAGE =
+    "usage: bmg_run --graph FILE [options]\n"
+    "\n"
+    "  --graph FILE            graph written by serialize_graph\n"
+    "  --algorithm NAME        rejection, gibbs, nmc (default), hmc, nuts,\n"
+    "                          random_walk or multiple_try\n"
+    "  --num-samples N         samples per chain (default 1000)\n"
+    "  --seed N                seed of the first chain (default 5123401)\n"
+    "  --chains N              number of chains (default 1)\n"
+    "  --samples FILE          CSV file for the samples\n"
+    "  --log-prob FILE         CSV file for the log probs\n"
+    "                          (implies --keep-log-prob)\n"
+    "  --report FILE           JSON file for the performance report\n"
+    "                          (rejection, gibbs and nmc only)\n"
+    "  --speculative-nuts      build the NUTS trajectory in both directions\n"
+    "                          on two threads per chain\n"
+    "  --adapt-path-length     adapt the HMC path length during warmup,\n"
+    "                          starting from --path-length\n"
+    "  --adapt-covariance      adapt the random_walk proposal during warmup,\n"
+    "                          starting from --step-size\n"
+    "  --compile-density       evaluate the log density of hmc, nuts,\n"
+    "                          random_walk and multiple_try with generated\n"
+    "                          and compiled C++ code\n"
+    "  --num-tries N           candidates of each multiple_try iteration,\n"
+    "                          on a thread each (default 4)\n"
+    "\n"
+    "InferConfig options:\n"
+    "  --keep-log-prob\n"
+    "  --path-length X         (default 1.0)\n"
+    "  --step-size X           (default 1.0)\n"
+    "  --num-warmup N          (default 0)\n"
+    "  --keep-warmup\n"
+    "  --thinning N            (default 1)\n"
+    "  --delayed-acceptance-subset-size N\n"
+    "  --pin-threads\n"
+    "  --use-processes\n"
+    "  --sample-store FILE     write the samples to a columnar sample store\n"
+    "                          instead of keeping them in memory (not with\n"
+    "                          --samples)\n"
+    "  --max-threads N         threads shared by the chains and their large\n"
+    "                          matrix kernels (default 0: one per chain)\n";
+
+struct Options {
+  std::string graph_file;
+  std::string algorithm = "nmc";
+  uint num_samples = 1000;
+  uint seed = 5123401;
+  uint chains = 1;
+  std::string samples_file;
+  std::string log_prob_file;
+  std::string report_file;
+  bool speculative_nuts = false;
+  bool adapt_path_length = false;
+  bool adapt_covariance = false;
+  uint num_tries = 4;
+  bool compile_density = false;
+  InferConfig config;
+};
+
+uint parse_uint(const std::string& flag, const std::string& text) {
+  if (text.empty()) {
+    throw std::invalid_argument(flag + " expects a non-negative integer");
+  }
+  std::size_t end = 0;
+  unsigned long value = 0;
+  try {
+    value = std::stoul(text, &end);
+  } catch (const std::exception&) {
+    end = 0;
+  }
+  if (end != text.size() or text[0] == '-' or
+      value > std::numeric_limits<uint>::max()) {
+    throw std::invalid_argument(flag + " expects a non-negative integer");
+  }
+  return static_cast<uint>(value);
+}
+
+double parse_double(const std::string& flag, const std::string& text) {
+  std::size_t end = 0;
+  double value = 0;
+  try {
+    value = std::stod(text, &end);
+  } catch (const std::exception&) {
+    end = 0;
+  }
+  if (end == 0 or end != text.size()) {
+    throw std::invalid_argument(flag + " expects a number");
+  }
+  return value;
+}
+
+Options parse_options(int argc, char* argv[]) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    std::string flag = argv[i];
+    // boolean flags
+    if (flag == "--keep-log-prob") {
+      options.config.keep_log_prob = true;
+      continue;
+    } else if (flag == "--keep-warmup") {
+      options.config.keep_warmup = true;
+      continue;
+    } else if (flag == "--pin-threads") {
+      options.config.pin_threads = true;
+      continue;
+    } else if (flag == "--use-processes") {
+      options.config.use_processes = true;
+      continue;
+    } else if (flag == "--speculative-nuts") {
+      options.speculative_nuts = true;
+      continue;
+    } else if (flag == "--adapt-path-length") {
+      options.adapt_path_length = true;
+      continue;
+    } else if (flag == "--compile-density") {
+      options.compile_density = true;
+      continue;
+    } else if (flag == "--adapt-covariance") {
+      options.adapt_covariance = true;
+      continue;
+    }
+    // flags with a value
+    if (i + 1 >= argc) {
+      throw std::invalid_argument("unknown option or missing value: " + flag);
+    }
+    std::string value = argv[++i];
+    if (flag == "--graph") {
+      options.graph_file = value;
+    } else if (flag == "--algorithm") {
+      options.algorithm = value;
+    } else if (flag == "--num-samples") {
+      options.num_samples = parse_uint(flag, value);
+    } else if (flag == "--seed") {
+      options.seed = parse_uint(flag, value);
+    } else if (flag == "--chains") {
+      options.chains = parse_uint(flag, value);
+    } else if (flag == "--samples") {
+      options.samples_file = value;
+    } else if (flag == "--log-prob") {
+      options.log_prob_file = value;
+      options.config.keep_log_prob = true;
+    } else if (flag == "--report") {
+      options.report_file = value;
+    } else if (flag == "--num-tries") {
+      options.num_tries = parse_uint(flag, value);
+    } else if (flag == "--path-length") {
+      options.config.path_length = parse_double(flag, value);
+    } else if (flag == "--step-size") {
+      options.config.step_size = parse_double(flag, value);
+    } else if (flag == "--num-warmup") {
+      options.config.num_warmup = parse_uint(flag, value);
+    } else if (flag == "--thinning") {
+      options.config.thinning = parse_uint(flag, value);
+    } else if (flag == "--sample-store") {
+      options.config.sample_store_path = value;
+    } else if (flag == "--max-threads") {
+      options.config.max_threads = parse_uint(flag, value);
+    } else if (flag == "--delayed-acceptance-subset-size") {
+      options.config.delayed_acceptance_subset_size = parse_uint(flag, value);
+    } else {
+      throw std::invalid_argument("unknown option: " + flag);
+    }
+  }
+  if (options.graph_file.empty()) {
+    throw std::invalid_argument("--graph is required");
+  }
+  if (options.chains == 0 or options.config.thinning == 0) {
+    throw std::invalid_argument("--chains and --thinning must be positive");
+  }
+  // the samples written to a sample store are not kept for --samples
+  if (not options.samples_file.empty() and
+      not options.config.sample_store_path.empty()) {
+    throw std::invalid_argument("--samples cannot be used with --sample-store");
+  }
+  return options;
+}
+
+std::ofstream open_output(const std::string& file) {
+  std::ofstream os(file);
+  if (not os) {
+    throw std::runtime_error("cannot write " + file);
+  }
+  os.precision(std::numeric_limits<double>::max_digits10);
+  return os;
+}
+
+void write_element(const NodeValue& value, uint i, std::ostream& os) {
+  switch (value.type.atomic_type) {
+    case AtomicType::BOOLEAN:
+      os << (value.type.variable_type == VariableType::SCALAR
+                 ? value._bool
+                 : value._bmatrix(i));
+      break;
+    case AtomicType::NATURAL:
+      os << (value.type.variable_type == VariableType::SCALAR
+                 ? value._natural
+                 : value._nmatrix(i));
+      break;
+    default:
+      os << (value.type.variable_type == VariableType::SCALAR
+                 ? value._double
+                 : value._matrix(i));
+      break;
+  }
+}
+
+uint num_elements(const NodeValue& value) {
+  return value.type.variable_type == VariableType::SCALAR
+      ? 1
+      : value.type.rows * value.type.cols;
+}
+
+/*
+Writes one row per sample with its chain, its index in the chain and the
+values of the queries. Matrix queries are flattened in column-major order
+into columns named node<id>_<row>_<col>.
+*/
+void write_samples(
+    const std::string& file,
+    const std::vector<uint>& queries,
+    const std::vector<std::vector<std::vector<NodeValue>>>& samples) {
+  std::ofstream os = open_output(file);
+  os << "chain,draw";
+  const std::vector<NodeValue>* first = nullptr;
+  for (auto const& chain : samples) {
+    if (not chain.empty()) {
+      first = &chain[0];
+      break;
+    }
+  }
+  for (uint q = 0; q < queries.size(); q++) {
+    if (first == nullptr or
+        (*first)[q].type.variable_type == VariableType::SCALAR) {
+      os << ",node" << queries[q];
+      continue;
+    }
+    const ValueType& type = (*first)[q].type;
+    for (uint c = 0; c < type.cols; c++) {
+      for (uint r = 0; r < type.rows; r++) {
+        os << ",node" << queries[q] << "_" << r << "_" << c;
+      }
+    }
+  }
+  os << "\n";
+  for (uint chain = 0; chain < samples.size(); chain++) {
+    for (uint draw = 0; draw < samples[chain].size(); draw++) {
+      os << chain << "," << draw;
+      for (const NodeValue& value : samples[chain][draw]) {
+        for (uint i = 0; i < num_elements(value); i++) {
+          os << ",";
+          write_element(value, i, os);
+        }
+      }
+      os << "\n";
+    }
+  }
+}
+
+void write_log_probs(
+    const std::string& file,
+    const std::vector<std::vector<double>>& log_probs) {
+  std::ofstream os = open_output(file);
+  os << "chain,draw,log_prob\n";
+  for (uint chain = 0; chain < log_probs.size(); chain++) {
+    for (uint draw = 0; draw < log_probs[chain].size(); draw++) {
+      os << chain << "," << draw << "," << log_probs[chain][draw] << "\n";
+    }
+  }
+}
+
+std::unique_ptr<GlobalMH> make_global_mh(Graph& graph, const Options& options) {
+  const InferConfig& config = options.config;
+  if (options.algorithm == "hmc") {
+    auto hmc =
+        std::make_unique<HMC>(graph, config.path_length, config.step_size);
+    hmc->set_path_length_adaptation(options.adapt_path_length);
+    return hmc;
+  } else if (options.algorithm == "nuts") {
+    auto nuts = std::make_unique<NUTS>(graph);
+    nuts->set_speculative_tree_building(options.speculative_nuts);
+    return nuts;
+  } else if (options.algorithm == "random_walk") {
+    auto random_walk = std::make_unique<RandomWalkMH>(graph, config.step_size);
+    random_walk->set_covariance_adaptation(options.adapt_covariance);
+    return random_walk;
+  } else if (options.algorithm == "multiple_try") {
+    return std::make_unique<MultipleTryMH>(
+        graph, config.step_size, options.num_tries);
+  }
+  throw std::invalid_argument("unknown algorithm: " + options.algorithm);
+}
+
+// The global algorithms run one chain per thread on copies of the graph,
+// seeded like Graph::infer does, and share --max-threads like its chains.
+// The other InferConfig options only apply to Graph::infer.
+std::vector<std::vector<std::vector<NodeValue>>> run_global_mh(
+    Graph& graph,
+    const Options& options) {
+  const InferConfig& config = options.config;
+  if (not options.report_file.empty() or config.keep_log_prob or
+      config.thinning != 1 or not config.sample_store_path.empty() or
+      config.pin_threads or config.use_processes or
+      config.delayed_acceptance_subset_size > 0) {
+    throw std::invalid_argument(
+        "--report, --log-prob, --thinning, --sample-store, --pin-threads, "
+        "--use-processes and --delayed-acceptance-subset-size are not "
+        "supported with " +
+        options.algorithm);
+  }
+  std::unique_ptr<ThreadBudget> budget;
+  if (config.max_threads > 0) {
+    budget = std::make_unique<ThreadBudget>(config.max_threads);
+  }
+  std::vector<std::unique_ptr<Graph>> copies;
+  std::vector<std::unique_ptr<GlobalMH>> samplers;
+  for (uint chain = 0; chain < options.chains; chain++) {
+    copies.push_back(std::make_unique<Graph>(graph));
+    samplers.push_back(make_global_mh(*copies.back(), options));
+    samplers.back()->set_density_compilation(options.compile_density);
+  }
+  std::vector<std::vector<std::vector<NodeValue>>> samples(options.chains);
+  std::vector<std::exception_ptr> errors(options.chains);
+  std::vector<std::thread> threads;
+  for (uint chain = 0; chain < options.chains; chain++) {
+    threads.emplace_back([&, chain]() {
+      try {
+        ChainScope chain_scope(budget.get());
+        samples[chain] = samplers[chain]->infer(
+            options.num_samples,
+            options.seed + 13 * chain,
+            options.config.num_warmup,
+            options.config.keep_warmup);
+      } catch (...) {
+        errors[chain] = std::current_exception();
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (auto& error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+  return samples;
+}
+
+const std::map<std::string, InferenceType> GRAPH_ALGORITHMS = {
+    {"rejection", InferenceType::REJECTION},
+    {"gibbs", InferenceType::GIBBS},
+    {"nmc", InferenceType::NMC},
+};
+
+void run(const Options& options) {
+  std::ifstream is(options.graph_file);
+  if (not is) {
+    throw std::runtime_error("cannot read " + options.graph_file);
+  }
+  std::unique_ptr<Graph> graph = read_graph(is);
+  auto algorithm = GRAPH_ALGORITHMS.find(options.algorithm);
+  std::vector<std::vector<std::vector<NodeValue>>> samples;
+  if (algorithm != GRAPH_ALGORITHMS.end()) {
+    graph->collect_performance_data(not options.report_file.empty());
+    samples = graph->infer(
+        options.num_samples,
+        algorithm->second,
+        options.seed,
+        options.chains,
+        options.config);
+  } else {
+    samples = run_global_mh(*graph, options);
+  }
+  if (not options.samples_file.empty()) {
+    write_samples(options.samples_file, graph->queries, samples);
+  }
+  if (not options.log_prob_file.empty()) {
+    write_log_probs(options.log_prob_file, graph->get_log_prob());
+  }
+  if (not options.report_file.empty()) {
+    std::ofstream os = open_output(options.report_file);
+    os << graph->performance_report() << "\n";
+  }
+}
+
+} // namespace
+
+namespace beanmachine {
+namespace graph {
+
+int bmg_run_main(int argc, char* argv[]) {
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--help") == 0 or
+        std::strcmp(argv[i], "-h") == 0) {
+      std::cout << USAGE;
+      return 0;
+    }
+  }
+  try {
+    run(parse_options(argc, argv));
+  } catch (const std::exception& e) {
+    std::cerr << "bmg_run: " << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
+
+} // namespace graph
+} // namespace beanmachine
@@ -0,0 +1,24 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+namespace beanmachine {
+namespace graph {
+
+/*
+The bmg_run command-line runner (see bmg_run.cpp), callable in-process.
+Errors are printed to stderr.
+
+:param argc: The number of arguments, the program name included.
+:param argv: The arguments, as given to main.
+:returns: The exit status: 0 on success, 1 on error.
+*/
+int bmg_run_main(int argc, char* argv[]);
+
+} // namespace graph
+} // namespace beanmachine
@@ -0,0 +1,12 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "beanmachine/graph/cli/bmg_run.h"
+
+int main(int argc, char* argv[]) {
+  return beanmachine::graph::bmg_run_main(argc, argv);
+}
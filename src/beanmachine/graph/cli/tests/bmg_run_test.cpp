@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "beanmachine/graph/cli/bmg_run.h"
+#include "beanmachine/graph/graph.h"
+#include "beanmachine/graph/serialization.h"
+
+using namespace beanmachine::graph;
+
+namespace {
+
+int run_cli(std::vector<std::string> args) {
+  args.insert(args.begin(), "bmg_run");
+  std::vector<char*> argv;
+  for (auto& arg : args) {
+    argv.push_back(arg.data());
+  }
+  return bmg_run_main(static_cast<int>(argv.size()), argv.data());
+}
+
+std::vector<std::string> read_lines(const std::string& file) {
+  std::ifstream is(file);
+  std::vector<std::string> lines;
+  std::string line;
+  while (std::getline(is, line)) {
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+} // namespace
+
+TEST(testbmgrun, smoke) {
+  // x ~ Normal(0, 1), y ~ Normal(x, 1) observed as 0.5; queries x
+  Graph g;
+  uint zero = g.add_constant(0.0);
+  uint one = g.add_constant_pos_real(1.0);
+  uint x = g.add_operator(
+      OperatorType::SAMPLE,
+      {g.add_distribution(
+          DistributionType::NORMAL, AtomicType::REAL, {zero, one})});
+  uint y = g.add_operator(
+      OperatorType::SAMPLE,
+      {g.add_distribution(
+          DistributionType::NORMAL, AtomicType::REAL, {x, one})});
+  g.observe(y, 0.5);
+  g.query(x);
+
+  std::string directory = "/tmp/bmg_run_test_XXXXXX";
+  ASSERT_NE(mkdtemp(directory.data()), nullptr);
+  std::string graph_file = directory + "/graph.bmg";
+  std::string samples_file = directory + "/samples.csv";
+  std::string log_prob_file = directory + "/log_prob.csv";
+  {
+    std::ofstream os(graph_file);
+    write_graph(g, os);
+  }
+
+  EXPECT_EQ(run_cli({"--help"}), 0);
+  EXPECT_EQ(
+      run_cli(
+          {"--graph",
+           graph_file,
+           "--num-samples",
+           "10",
+           "--chains",
+           "2",
+           "--samples",
+           samples_file,
+           "--log-prob",
+           log_prob_file}),
+      0);
+  auto samples = read_lines(samples_file);
+  ASSERT_EQ(samples.size(), 21);
+  EXPECT_EQ(samples[0], "chain,draw,node" + std::to_string(x));
+  EXPECT_EQ(samples[20].substr(0, 4), "1,9,");
+  EXPECT_EQ(read_lines(log_prob_file).size(), 21);
+
+  EXPECT_EQ(
+      run_cli(
+          {"--graph",
+           graph_file,
+           "--algorithm",
+           "nuts",
+           "--num-samples",
+           "10",
+           "--samples",
+           samples_file}),
+      0);
+  EXPECT_EQ(read_lines(samples_file).size(), 11);
+
+  // options the global algorithms do not support are errors
+  EXPECT_EQ(
+      run_cli(
+          {"--graph", graph_file, "--algorithm", "nuts", "--thinning", "2"}),
+      1);
+  EXPECT_EQ(run_cli({"--graph", directory + "/missing.bmg"}), 1);
+  EXPECT_EQ(run_cli({"--num-samples", "10"}), 1);
+  EXPECT_EQ(run_cli({"--graph", graph_file, "--seed", ""}), 1);
+  EXPECT_EQ(
+      run_cli(
+          {"--graph",
+           graph_file,
+           "--samples",
+           samples_file,
+           "--sample-store",
+           directory + "/store"}),
+      1);
+
+  std::remove(graph_file.c_str());
+  std::remove(samples_file.c_str());
+  std::remove(log_prob_file.c_str());
+  rmdir(directory.c_str());
+}
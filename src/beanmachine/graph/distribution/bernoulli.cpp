@@ -114,6 +114,23 @@ void Bernoulli::gradient_log_prob_param(
           prob1 * prob1;
 }
 
+void Bernoulli::gradient_log_prob_param_lanes(
+    const graph::NodeValue& value,
+    Eigen::ArrayXd& grad1,
+    Eigen::ArrayXd& grad2) const {
+  assert(value.type.variable_type == graph::VariableType::SCALAR);
+  double val = value._bool ? 1.0 : 0.0;
+  double prob = in_nodes[0]->value._double;
+  double grad2_prob2 =
+      -(val / (prob * prob)) - ((1 - val) / ((1 - prob) * (1 - prob)));
+  add_param_lanes(
+      0,
+      _grad1_log_prob_param(value._bool, prob),
+      grad2_prob2,
+      grad1,
+      grad2);
+}
+
 void Bernoulli::backward_param(const graph::NodeValue& value, double adjunct)
     const {
   assert(value.type.variable_type == graph::VariableType::SCALAR);
@@ -118,6 +118,19 @@ void BernoulliLogit::gradient_log_prob_param(
   }
 }
 
+void BernoulliLogit::gradient_log_prob_param_lanes(
+    const NodeValue& value,
+    Eigen::ArrayXd& grad1,
+    Eigen::ArrayXd& grad2) const {
+  assert(value.type.variable_type == graph::VariableType::SCALAR);
+  if (param_has_lanes(0)) {
+    double l = in_nodes[0]->value._double;
+    double grad_l = _grad1_log_prob_param(value._bool, l);
+    double grad2_l2 = -1 / (2 + std::exp(-l) + std::exp(l));
+    add_param_lanes(0, grad_l, grad2_l2, grad1, grad2);
+  }
+}
+
 void BernoulliLogit::backward_param(
     const graph::NodeValue& value,
     double adjunct) const {
@@ -114,6 +114,18 @@ void BernoulliNoisyOr::gradient_log_prob_param(
       grad_param * in_nodes[0]->grad2;
 }
 
+void BernoulliNoisyOr::gradient_log_prob_param_lanes(
+    const graph::NodeValue& value,
+    Eigen::ArrayXd& grad1,
+    Eigen::ArrayXd& grad2) const {
+  double param = in_nodes[0]->value._double;
+  double mexpm1m = -std::expm1(-param); // 1 - exp(-param)
+  double val = (double)value._bool;
+  double grad_param = val / mexpm1m - 1;
+  double grad2_param = -val * std::exp(-param) / (mexpm1m * mexpm1m);
+  add_param_lanes(0, grad_param, grad2_param, grad1, grad2);
+}
+
 void BernoulliNoisyOr::backward_param(
     const graph::NodeValue& value,
     double adjunct) const {
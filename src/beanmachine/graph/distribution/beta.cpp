@@ -116,6 +116,16 @@ void Beta::gradient_log_prob_param(
   forward_gradient_scalarops(jacobian, hessian, grad1, grad2);
 }
 
+void Beta::gradient_log_prob_param_lanes(
+    const graph::NodeValue& value,
+    Eigen::ArrayXd& grad1,
+    Eigen::ArrayXd& grad2) const {
+  Eigen::Matrix<double, 1, 2> jacobian;
+  Eigen::Matrix2d hessian;
+  compute_jacobian_hessian(value, jacobian, hessian);
+  forward_gradient_scalarops_lanes(jacobian, hessian, grad1, grad2);
+}
+
 void Beta::compute_jacobian_hessian(
     const graph::NodeValue& value,
     Eigen::Matrix<double, 1, 2>& jacobian,
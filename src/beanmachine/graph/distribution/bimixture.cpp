@@ -106,7 +106,7 @@ double Bimixture::log_prob(const graph::NodeValue& value) const {
     double z1 = std::log(in_nodes[0]->value._double) + d1->log_prob(value);
     double z2 =
         std::log(1.0 - in_nodes[0]->value._double) + d2->log_prob(value);
-    return util::log_sum_exp(std::vector<double>{z1, z2});
+    return util::log_sum_exp(z1, z2);
   } else if (
       value.type.variable_type == graph::VariableType::BROADCAST_MATRIX) {
     Eigen::MatrixXd log_probs;
@@ -127,6 +127,18 @@ void Binomial::gradient_log_prob_param(
       grad_p * in_nodes[1]->grad2;
 }
 
+void Binomial::gradient_log_prob_param_lanes(
+    const graph::NodeValue& value,
+    Eigen::ArrayXd& grad1,
+    Eigen::ArrayXd& grad2) const {
+  double n = (double)in_nodes[0]->value._natural;
+  double p = in_nodes[1]->value._double;
+  double k = (double)value._natural;
+  double grad_p = (k / p) - (n - k) / (1 - p);
+  double grad2_p2 = (-k / (p * p)) - (n - k) / ((1 - p) * (1 - p));
+  add_param_lanes(1, grad_p, grad2_p2, grad1, grad2);
+}
+
 // log_prob is k log(p) + (n-k) log(1-p) as a function of p
 // grad1 is  (k/p) * p' - ((n-k) / (1-p)) * p'
 void Binomial::backward_param(const graph::NodeValue& value, double adjunct)
@@ -29,6 +29,10 @@ class Binomial : public Distribution {
       const graph::NodeValue& value,
       double& grad1,
       double& grad2) const override;
+  void gradient_log_prob_param_lanes(
+      const graph::NodeValue& value,
+      Eigen::ArrayXd& grad1,
+      Eigen::ArrayXd& grad2) const override;
   void backward_value(
       const graph::NodeValue& /* value */,
       graph::DoubleMatrix& /* back_grad */,
@@ -192,6 +192,29 @@ void Cauchy::gradient_log_prob_param(
   }
 }
 
+void Cauchy::gradient_log_prob_param_lanes(
+    const NodeValue& value,
+    Eigen::ArrayXd& grad1,
+    Eigen::ArrayXd& grad2) const {
+  assert(value.type.variable_type == graph::VariableType::SCALAR);
+  // see gradient_log_prob_param for the derivatives
+  double x = value._double;
+  double x0 = in_nodes[0]->value._double;
+  double s = in_nodes[1]->value._double;
+  double t1 = x - x0; // (x - x0)
+  double t2 = t1 * t1; // (x - x0)^2
+  double t3 = s * s; // s^2
+  double t4 = t3 + t2; // s^2 + (x - x0)^2
+  if (param_has_lanes(0)) {
+    add_param_lanes(0, 2 * t1 / t4, 2 * (t2 - t3) / (t4 * t4), grad1, grad2);
+  }
+  if (param_has_lanes(1)) {
+    double d1 = (t2 - t3) / (s * t4);
+    double d2 = (t3 * t3 - 4 * t3 * t2 - t2 * t2) / (t3 * t4 * t4);
+    add_param_lanes(1, d1, d2, grad1, grad2);
+  }
+}
+
 void Cauchy::backward_value(
     const graph::NodeValue& value,
     graph::DoubleMatrix& back_grad,
@@ -21,6 +21,7 @@
 #include "beanmachine/graph/distribution/half_cauchy.h"
 #include "beanmachine/graph/distribution/half_normal.h"
 #include "beanmachine/graph/distribution/log_normal.h"
+#include "beanmachine/graph/distribution/mixture.h"
 #include "beanmachine/graph/distribution/normal.h"
 #include "beanmachine/graph/distribution/poisson.h"
 #include "beanmachine/graph/distribution/student_t.h"
@@ -79,6 +80,9 @@ std::unique_ptr<Distribution> Distribution::new_distribution(
       case graph::DistributionType::BIMIXTURE: {
         return std::make_unique<Bimixture>(atype, in_nodes);
       }
+      case graph::DistributionType::MIXTURE: {
+        return std::make_unique<Mixture>(atype, in_nodes);
+      }
       case graph::DistributionType::CATEGORICAL: {
         return std::make_unique<Categorical>(atype, in_nodes);
       }
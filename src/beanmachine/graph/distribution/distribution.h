@@ -107,6 +107,20 @@ class Distribution : public graph::Node {
       double& grad1,
       double& grad2) const = 0;
 
+  // Vector-mode counterpart of gradient_log_prob_param: *adds* to each lane
+  // of grad1 and grad2 the gradients through the parameters w.r.t. the
+  // source of that lane, using the grad1_lanes and grad2_lanes fields of
+  // the parameters (see Graph::gradient_log_prob<N>). The derivatives of the
+  // log probability w.r.t. the parameters are computed once for all lanes.
+  virtual void gradient_log_prob_param_lanes(
+      const graph::NodeValue& /* value */,
+      Eigen::ArrayXd& /* grad1 */,
+      Eigen::ArrayXd& /* grad2 */) const {
+    throw std::runtime_error(
+        "gradient_log_prob_param_lanes has not been implemented for this "
+        "distribution.");
+  }
+
   /*
   In backward gradient propagation, increments the back_grad by the gradient of
   the log prob of the distribution w.r.t. the sampled value.
@@ -157,6 +171,7 @@ class Distribution : public graph::Node {
   graph::DistributionType dist_type;
   graph::ValueType sample_type;
 
+
   virtual double _double_sampler(std::mt19937& /* gen */) const {
     throw std::runtime_error(
         "_double_sampler has not been implemented for this distribution.");
@@ -173,6 +188,26 @@ class Distribution : public graph::Node {
     throw std::runtime_error(
         "_matrix_sampler has not been implemented for this distribution.");
   }
+
+ protected:
+  // Whether some source of a vector-mode pass reaches parameter i.
+  bool param_has_lanes(uint i) const {
+    return (in_nodes[i]->grad1_lanes != 0).any() or
+        (in_nodes[i]->grad2_lanes != 0).any();
+  }
+  // Applies the chain rule of gradient_log_prob_param to each lane of
+  // parameter i, given the first and second derivatives d1 and d2 of the
+  // log probability w.r.t. it.
+  void add_param_lanes(
+      uint i,
+      double d1,
+      double d2,
+      Eigen::ArrayXd& grad1,
+      Eigen::ArrayXd& grad2) const {
+    grad1 += d1 * in_nodes[i]->grad1_lanes;
+    grad2 += d2 * in_nodes[i]->grad1_lanes.square() +
+        d1 * in_nodes[i]->grad2_lanes;
+  }
 };
 
 } // namespace distribution
@@ -99,5 +99,10 @@ void Flat::gradient_log_prob_param(
     double& /* grad1 */,
     double& /* grad2 */) const {}
 
+void Flat::gradient_log_prob_param_lanes(
+    const NodeValue& /* value */,
+    Eigen::ArrayXd& /* grad1 */,
+    Eigen::ArrayXd& /* grad2 */) const {}
+
 } // namespace distribution
 } // namespace beanmachine
@@ -31,6 +31,10 @@ class Flat : public Distribution {
       const graph::NodeValue& value,
       double& grad1,
       double& grad2) const override;
+  void gradient_log_prob_param_lanes(
+      const graph::NodeValue& value,
+      Eigen::ArrayXd& grad1,
+      Eigen::ArrayXd& grad2) const override;
   std::uniform_real_distribution<double> _get_uniform_real_distribution() const;
 };
 
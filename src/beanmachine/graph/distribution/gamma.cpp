@@ -123,6 +123,20 @@ void Gamma::gradient_log_prob_param(
       grad2_b2 * in_nodes[1]->grad1 * in_nodes[1]->grad1;
 }
 
+void Gamma::gradient_log_prob_param_lanes(
+    const graph::NodeValue& value,
+    Eigen::ArrayXd& grad1,
+    Eigen::ArrayXd& grad2) const {
+  double param_a = in_nodes[0]->value._double;
+  double param_b = in_nodes[1]->value._double;
+  double grad_a = std::log(param_b) - util::polygamma(0, param_a) +
+      std::log(value._double);
+  add_param_lanes(0, grad_a, -util::polygamma(1, param_a), grad1, grad2);
+  double grad_b = param_a / param_b - value._double;
+  double grad2_b2 = -param_a / (param_b * param_b);
+  add_param_lanes(1, grad_b, grad2_b2, grad1, grad2);
+}
+
 void Gamma::backward_value(
     const graph::NodeValue& value,
     graph::DoubleMatrix& back_grad,
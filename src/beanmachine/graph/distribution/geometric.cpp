@@ -88,6 +88,21 @@ void Geometric::gradient_log_prob_param(
       grad_p * grad_p * (-1 / (p * p) - k / ((1 - p) * (1 - p)));
 }
 
+void Geometric::gradient_log_prob_param_lanes(
+    const graph::NodeValue& value,
+    Eigen::ArrayXd& grad1,
+    Eigen::ArrayXd& grad2) const {
+  assert(value.type.variable_type == graph::VariableType::SCALAR);
+  graph::natural_t k = value._natural;
+  double p = in_nodes[0]->value._double;
+  add_param_lanes(
+      0,
+      1 / p - k / (1 - p),
+      -1 / (p * p) - k / ((1 - p) * (1 - p)),
+      grad1,
+      grad2);
+}
+
 void Geometric::backward_param(const graph::NodeValue& value, double adjunct)
     const {
   assert(value.type.variable_type == graph::VariableType::SCALAR);
@@ -127,6 +127,22 @@ void HalfCauchy::gradient_log_prob_param(
   }
 }
 
+void HalfCauchy::gradient_log_prob_param_lanes(
+    const NodeValue& value,
+    Eigen::ArrayXd& grad1,
+    Eigen::ArrayXd& grad2) const {
+  assert(value.type.variable_type == graph::VariableType::SCALAR);
+  if (param_has_lanes(0)) {
+    double x = value._double;
+    double s = in_nodes[0]->value._double;
+    double s2_p_x2 = s * s + x * x;
+    double grad_s = _grad1_log_prob_param(s, s2_p_x2);
+    double grad2_s2 =
+        -1 / (s * s) - 2 / s2_p_x2 + 4 * s * s / (s2_p_x2 * s2_p_x2);
+    add_param_lanes(0, grad_s, grad2_s2, grad1, grad2);
+  }
+}
+
 void HalfCauchy::backward_value(
     const graph::NodeValue& value,
     graph::DoubleMatrix& back_grad,
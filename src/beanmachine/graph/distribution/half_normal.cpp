@@ -134,6 +134,21 @@ void Half_Normal::gradient_log_prob_param(
   }
 }
 
+void Half_Normal::gradient_log_prob_param_lanes(
+    const NodeValue& value,
+    Eigen::ArrayXd& grad1,
+    Eigen::ArrayXd& grad2) const {
+  assert(value.type.variable_type == graph::VariableType::SCALAR);
+  if (param_has_lanes(0)) {
+    double x = value._double;
+    double s = in_nodes[0]->value._double;
+    double s_sq = s * s;
+    double grad_s = -1 / s + x * x / (s * s * s);
+    double grad2_s2 = 1 / s_sq - 3 * x * x / (s_sq * s_sq);
+    add_param_lanes(0, grad_s, grad2_s2, grad1, grad2);
+  }
+}
+
 void Half_Normal::backward_value(
     const graph::NodeValue& value,
     graph::DoubleMatrix& back_grad,
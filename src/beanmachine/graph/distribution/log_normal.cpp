@@ -149,6 +149,25 @@ void LogNormal::gradient_log_prob_param(
   }
 }
 
+void LogNormal::gradient_log_prob_param_lanes(
+    const NodeValue& value,
+    Eigen::ArrayXd& grad1,
+    Eigen::ArrayXd& grad2) const {
+  assert(value.type.variable_type == graph::VariableType::SCALAR);
+  double log_x = std::log(value._double);
+  double m = in_nodes[0]->value._double;
+  double s = in_nodes[1]->value._double;
+  double s_sq = s * s;
+  if (param_has_lanes(0)) {
+    add_param_lanes(0, (log_x - m) / s_sq, -1 / s_sq, grad1, grad2);
+  }
+  if (param_has_lanes(1)) {
+    double grad_s = -1 / s + (log_x - m) * (log_x - m) / (s * s * s);
+    double grad2_s2 = 1 / s_sq - 3 * (log_x - m) * (log_x - m) / (s_sq * s_sq);
+    add_param_lanes(1, grad_s, grad2_s2, grad1, grad2);
+  }
+}
+
 void LogNormal::backward_value(
     const graph::NodeValue& value,
     graph::DoubleMatrix& back_grad,
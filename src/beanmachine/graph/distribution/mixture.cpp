@@ -0,0 +1,363 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <string>
+
+#include "beanmachine/graph/distribution/mixture.h"
+#include "beanmachine/graph/thread_pool.h"
+
+namespace beanmachine {
+namespace distribution {
+
+using namespace graph;
+
+// A rough cost of the log prob of a component and of its share of the
+// log-sum-exp, per observation.
+const double IID_FLOPS_PER_OBSERVATION = 40;
+
+Mixture::Mixture(ValueType sample_type, const std::vector<Node*>& in_nodes)
+    : Distribution(DistributionType::MIXTURE, sample_type) {
+  // a Mixture distribution has K + 1 parents:
+  // [the K x 1 simplex of component weights, Dist_1, ..., Dist_K]
+  if (in_nodes.size() < 2) {
+    throw std::invalid_argument(
+        "Mixture distribution must have at least two parents");
+  }
+  uint num_components = static_cast<uint>(in_nodes.size()) - 1;
+  const auto& weights = in_nodes[0]->value;
+  if (weights.type.variable_type != VariableType::COL_SIMPLEX_MATRIX or
+      weights.type.cols != 1 or weights.type.rows != num_components) {
+    throw std::invalid_argument(
+        "the first parent for mixture distribution must be a one-column "
+        "simplex with one row per component");
+  }
+  for (uint k = 1; k <= num_components; k++) {
+    if (in_nodes[k]->node_type != NodeType::DISTRIBUTION) {
+      throw std::invalid_argument(
+          "the components of a mixture distribution must be distributions");
+    }
+    auto dist = static_cast<const distribution::Distribution*>(in_nodes[k]);
+    if (sample_type != dist->sample_type) {
+      throw std::invalid_argument(
+          "sample type must be consistent with the distribution parents");
+    }
+  }
+  ratios.resize(num_components);
+}
+
+Mixture::Mixture(AtomicType sample_type, const std::vector<Node*>& in_nodes)
+    : Mixture(ValueType(sample_type), in_nodes) {}
+
+uint Mixture::sample_component(std::mt19937& gen) const {
+  const Eigen::MatrixXd& weights = in_nodes[0]->value._matrix;
+  double u = std::uniform_real_distribution<double>(0.0, 1.0)(gen);
+  uint last = num_components() - 1;
+  for (uint k = 0; k < last; k++) {
+    u -= weights(k);
+    if (u < 0) {
+      return k;
+    }
+  }
+  return last;
+}
+
+bool Mixture::_bool_sampler(std::mt19937& gen) const {
+  return component(sample_component(gen))->_bool_sampler(gen);
+}
+
+double Mixture::_double_sampler(std::mt19937& gen) const {
+  return component(sample_component(gen))->_double_sampler(gen);
+}
+
+natural_t Mixture::_natural_sampler(std::mt19937& gen) const {
+  return component(sample_component(gen))->_natural_sampler(gen);
+}
+
+// log f = logsumexp_k(log(w_k) + log(f_k)), computed in two passes over the
+// components with `ratios` holding log(f_k) in between.
+double Mixture::compute_ratios(const graph::NodeValue& value) const {
+  const Eigen::MatrixXd& weights = in_nodes[0]->value._matrix;
+  uint K = num_components();
+  double max_z = -std::numeric_limits<double>::infinity();
+  for (uint k = 0; k < K; k++) {
+    ratios(k) = component(k)->log_prob(value);
+    max_z = std::max(max_z, std::log(weights(k)) + ratios(k));
+  }
+  if (not std::isfinite(max_z)) {
+    ratios.setZero();
+    return max_z;
+  }
+  double sum = 0.0;
+  for (uint k = 0; k < K; k++) {
+    sum += std::exp(std::log(weights(k)) + ratios(k) - max_z);
+  }
+  double log_f = max_z + std::log(sum);
+  for (uint k = 0; k < K; k++) {
+    ratios(k) = std::exp(ratios(k) - log_f);
+  }
+  return log_f;
+}
+
+// The observations begin, ..., begin + size - 1 of an iid value, taken in
+// the column-major order of its matrix, as a column.
+static graph::NodeValue observation_block(
+    const graph::NodeValue& value,
+    Eigen::Index begin,
+    Eigen::Index size) {
+  graph::NodeValue block;
+  block.type = graph::ValueType(
+      graph::VariableType::BROADCAST_MATRIX,
+      value.type.atomic_type,
+      static_cast<uint>(size),
+      1);
+  if (value.type.atomic_type == graph::AtomicType::BOOLEAN) {
+    block._bmatrix = Eigen::Map<const Eigen::MatrixXb>(
+        value._bmatrix.data() + begin, size, 1);
+  } else if (value.type.atomic_type == graph::AtomicType::NATURAL) {
+    block._nmatrix = Eigen::Map<const Eigen::MatrixXn>(
+        value._nmatrix.data() + begin, size, 1);
+  } else {
+    block._matrix = Eigen::Map<const Eigen::MatrixXd>(
+        value._matrix.data() + begin, size, 1);
+  }
+  return block;
+}
+
+void Mixture::compute_iid_ratios(
+    const graph::NodeValue& value,
+    Eigen::MatrixXd& log_probs,
+    Eigen::MatrixXd& observation_ratios) const {
+  assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
+  const Eigen::MatrixXd& weights = in_nodes[0]->value._matrix;
+  Eigen::ArrayXd log_weights = weights.col(0).array().log();
+  uint K = num_components();
+  Eigen::Index n = static_cast<Eigen::Index>(value.type.rows) *
+      static_cast<Eigen::Index>(value.type.cols);
+  observation_ratios.resize(K, n);
+  log_probs.resize(value.type.rows, value.type.cols);
+  // large batches split their observations into ranges evaluated
+  // concurrently (see util::use_parallel_kernel); each range evaluates the
+  // components on its own copy of its observations, then its share of the
+  // log-sum-exp, writing disjoint columns of the ratios
+  bool parallel = util::use_parallel_kernel(
+      IID_FLOPS_PER_OBSERVATION * static_cast<double>(K * n));
+  std::size_t grain = parallel
+      ? static_cast<std::size_t>(std::ceil(
+            util::PARALLEL_KERNEL_THRESHOLD / 8 /
+            (IID_FLOPS_PER_OBSERVATION * K)))
+      : static_cast<std::size_t>(n);
+  util::parallel_for(n, grain, [&](std::size_t begin, std::size_t end) {
+    auto first = static_cast<Eigen::Index>(begin);
+    auto size = static_cast<Eigen::Index>(end - begin);
+    graph::NodeValue block;
+    const graph::NodeValue* observations = &value;
+    if (size < n) {
+      block = observation_block(value, first, size);
+      observations = &block;
+    }
+    Eigen::MatrixXd logf_k;
+    for (uint k = 0; k < K; k++) {
+      component(k)->log_prob_iid(*observations, logf_k);
+      observation_ratios.block(k, first, 1, size) =
+          Eigen::Map<const Eigen::RowVectorXd>(logf_k.data(), size);
+    }
+    for (Eigen::Index j = first; j < first + size; j++) {
+      auto logf = observation_ratios.col(j).array();
+      double max_z = (logf + log_weights).maxCoeff();
+      if (not std::isfinite(max_z)) {
+        logf.setZero();
+        log_probs(j) = max_z;
+        continue;
+      }
+      double log_f = max_z +
+          std::log((weights.col(0).array() * (logf - max_z).exp()).sum());
+      logf = (logf - log_f).exp();
+      log_probs(j) = log_f;
+    }
+  });
+}
+
+double Mixture::log_prob(const graph::NodeValue& value) const {
+  if (value.type.variable_type == graph::VariableType::SCALAR) {
+    return compute_ratios(value);
+  } else if (
+      value.type.variable_type == graph::VariableType::BROADCAST_MATRIX) {
+    Eigen::MatrixXd log_probs;
+    log_prob_iid(value, log_probs);
+    return log_probs.sum();
+  } else {
+    throw std::runtime_error(
+        "Mixture::log_prob applied to invalid variable type");
+  }
+}
+
+void Mixture::log_prob_iid(
+    const graph::NodeValue& value,
+    Eigen::MatrixXd& log_probs) const {
+  // a local buffer of ratios, since the components of a mixture may be
+  // evaluated on several ranges of observations at once
+  Eigen::MatrixXd ratios_k;
+  compute_iid_ratios(value, log_probs, ratios_k);
+}
+
+// Let r_k = w_k * f_k / f be the responsibility of component k, then
+// grad1 w.r.t. x: log(f)' = sum_k r_k * log(f_k)'
+// grad2 w.r.t. x: log(f)'' = sum_k r_k * ((log(f_k)')^2 + log(f_k)'')
+//                            - (log(f)')^2
+void Mixture::gradient_log_prob_value(
+    const graph::NodeValue& value,
+    double& grad1,
+    double& grad2) const {
+  assert(value.type.variable_type == graph::VariableType::SCALAR);
+  compute_ratios(value);
+  const Eigen::MatrixXd& weights = in_nodes[0]->value._matrix;
+  double logf_grad1 = 0.0, f_grad2 = 0.0;
+  for (uint k = 0; k < num_components(); k++) {
+    double r_k = weights(k) * ratios(k);
+    if (r_k == 0.0) {
+      continue;
+    }
+    double logfk_grad1 = 0.0, logfk_grad2 = 0.0;
+    component(k)->gradient_log_prob_value(value, logfk_grad1, logfk_grad2);
+    logf_grad1 += r_k * logfk_grad1;
+    f_grad2 += r_k * (logfk_grad1 * logfk_grad1 + logfk_grad2);
+  }
+  grad1 += logf_grad1;
+  grad2 += f_grad2 - logf_grad1 * logf_grad1;
+}
+
+// With f = sum_k w_k * f_k and q_k = log(f_k), all depending on a source z:
+// f' / f = sum_k (f_k / f) * w_k' + r_k * q_k'
+// f'' / f = sum_k (f_k / f) * (w_k'' + 2 * w_k' * q_k')
+//           + r_k * ((q_k')^2 + q_k'')
+// log(f)'' = f'' / f - (log(f)')^2
+// The weights contribute only when their Grad1 (and Grad2) have been set up by
+// forward propagation, i.e. when they depend on the source.
+void Mixture::gradient_log_prob_param(
+    const graph::NodeValue& value,
+    double& grad1,
+    double& grad2) const {
+  assert(value.type.variable_type == graph::VariableType::SCALAR);
+  compute_ratios(value);
+  const Node* weights_node = in_nodes[0];
+  const Eigen::MatrixXd& weights = weights_node->value._matrix;
+  uint K = num_components();
+  bool has_weight_grad1 = weights_node->Grad1.size() == K;
+  bool has_weight_grad2 = weights_node->Grad2.size() == K;
+  double logf_grad1 = 0.0, f_grad2 = 0.0;
+  for (uint k = 0; k < K; k++) {
+    if (ratios(k) == 0.0) {
+      continue;
+    }
+    double r_k = weights(k) * ratios(k);
+    double q_grad1 = 0.0, q_grad2 = 0.0;
+    component(k)->gradient_log_prob_param(value, q_grad1, q_grad2);
+    double w_grad1 = has_weight_grad1 ? weights_node->Grad1(k) : 0.0;
+    double w_grad2 = has_weight_grad2 ? weights_node->Grad2(k) : 0.0;
+    logf_grad1 += ratios(k) * w_grad1 + r_k * q_grad1;
+    f_grad2 += ratios(k) * (w_grad2 + 2 * w_grad1 * q_grad1) +
+        r_k * (q_grad1 * q_grad1 + q_grad2);
+  }
+  grad1 += logf_grad1;
+  grad2 += f_grad2 - logf_grad1 * logf_grad1;
+}
+
+// for x being the value:
+// dlog(f)/dx = sum_k r_k * log(f_k)'
+void Mixture::backward_value(
+    const graph::NodeValue& value,
+    graph::DoubleMatrix& back_grad,
+    double adjunct) const {
+  compute_ratios(value);
+  const Eigen::MatrixXd& weights = in_nodes[0]->value._matrix;
+  for (uint k = 0; k < num_components(); k++) {
+    double r_k = weights(k) * ratios(k);
+    if (r_k != 0.0) {
+      component(k)->backward_value(value, back_grad, adjunct * r_k);
+    }
+  }
+}
+
+void Mixture::backward_value_iid(
+    const graph::NodeValue& value,
+    graph::DoubleMatrix& back_grad) const {
+  Eigen::MatrixXd adjunct =
+      Eigen::MatrixXd::Ones(value._matrix.rows(), value._matrix.cols());
+  backward_value_iid(value, back_grad, adjunct);
+}
+
+void Mixture::backward_value_iid(
+    const graph::NodeValue& value,
+    graph::DoubleMatrix& back_grad,
+    Eigen::MatrixXd& adjunct) const {
+  Eigen::MatrixXd log_probs;
+  compute_iid_ratios(value, log_probs, iid_ratios);
+  const Eigen::MatrixXd& weights = in_nodes[0]->value._matrix;
+  auto n = value._matrix.size();
+  Eigen::MatrixXd adjunct_k(value._matrix.rows(), value._matrix.cols());
+  for (uint k = 0; k < num_components(); k++) {
+    Eigen::Map<Eigen::RowVectorXd>(adjunct_k.data(), n) = weights(k) *
+        iid_ratios.row(k).cwiseProduct(
+            Eigen::Map<const Eigen::RowVectorXd>(adjunct.data(), n));
+    component(k)->backward_value_iid(value, back_grad, adjunct_k);
+  }
+}
+
+// for x being the parameter:
+// backprop thru w_k: dlog(f)/dw_k = f_k / f
+// backprop thru f_k: dlog(f)/dlog(f_k) = r_k
+void Mixture::backward_param(const graph::NodeValue& value, double adjunct)
+    const {
+  compute_ratios(value);
+  const Eigen::MatrixXd& weights = in_nodes[0]->value._matrix;
+  uint K = num_components();
+  if (in_nodes[0]->needs_gradient()) {
+    for (uint k = 0; k < K; k++) {
+      in_nodes[0]->back_grad1(k) += adjunct * ratios(k);
+    }
+  }
+  for (uint k = 0; k < K; k++) {
+    double r_k = weights(k) * ratios(k);
+    if (r_k != 0.0) {
+      component(k)->backward_param(value, adjunct * r_k);
+    }
+  }
+}
+
+void Mixture::backward_param_iid(const graph::NodeValue& value) const {
+  Eigen::MatrixXd adjunct =
+      Eigen::MatrixXd::Ones(value._matrix.rows(), value._matrix.cols());
+  backward_param_iid(value, adjunct);
+}
+
+void Mixture::backward_param_iid(
+    const graph::NodeValue& value,
+    Eigen::MatrixXd& adjunct) const {
+  Eigen::MatrixXd log_probs;
+  compute_iid_ratios(value, log_probs, iid_ratios);
+  const Eigen::MatrixXd& weights = in_nodes[0]->value._matrix;
+  uint K = num_components();
+  auto n = value._matrix.size();
+  Eigen::Map<const Eigen::RowVectorXd> flat_adjunct(adjunct.data(), n);
+  if (in_nodes[0]->needs_gradient()) {
+    for (uint k = 0; k < K; k++) {
+      in_nodes[0]->back_grad1(k) += iid_ratios.row(k).dot(flat_adjunct);
+    }
+  }
+  Eigen::MatrixXd adjunct_k(value._matrix.rows(), value._matrix.cols());
+  for (uint k = 0; k < K; k++) {
+    Eigen::Map<Eigen::RowVectorXd>(adjunct_k.data(), n) =
+        weights(k) * iid_ratios.row(k).cwiseProduct(flat_adjunct);
+    component(k)->backward_param_iid(value, adjunct_k);
+  }
+}
+
+} // namespace distribution
+} // namespace beanmachine
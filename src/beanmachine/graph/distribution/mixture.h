@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+#include "beanmachine/graph/distribution/distribution.h"
+
+namespace beanmachine {
+namespace distribution {
+
+/*
+A mixture of K component distributions of the same sample type.
+The parents are [weights, Dist_1, ..., Dist_K] where weights is a
+one-column simplex with K rows giving the probability of sampling from
+each component.
+*/
+class Mixture : public Distribution {
+ public:
+  Mixture(
+      graph::ValueType sample_type,
+      const std::vector<graph::Node*>& in_nodes);
+  Mixture(
+      graph::AtomicType sample_type,
+      const std::vector<graph::Node*>& in_nodes);
+  ~Mixture() override {}
+
+  bool _bool_sampler(std::mt19937& gen) const override;
+  double _double_sampler(std::mt19937& gen) const override;
+  graph::natural_t _natural_sampler(std::mt19937& gen) const override;
+
+  double log_prob(const graph::NodeValue& value) const override;
+  void log_prob_iid(const graph::NodeValue& value, Eigen::MatrixXd& log_probs)
+      const override;
+  void gradient_log_prob_value(
+      const graph::NodeValue& value,
+      double& grad1,
+      double& grad2) const override;
+  void gradient_log_prob_param(
+      const graph::NodeValue& value,
+      double& grad1,
+      double& grad2) const override;
+
+  void backward_value(
+      const graph::NodeValue& value,
+      graph::DoubleMatrix& back_grad,
+      double adjunct = 1.0) const override;
+  void backward_value_iid(
+      const graph::NodeValue& value,
+      graph::DoubleMatrix& back_grad) const override;
+  void backward_value_iid(
+      const graph::NodeValue& value,
+      graph::DoubleMatrix& back_grad,
+      Eigen::MatrixXd& adjunct) const override;
+
+  void backward_param(const graph::NodeValue& value, double adjunct = 1.0)
+      const override;
+  void backward_param_iid(const graph::NodeValue& value) const override;
+  void backward_param_iid(
+      const graph::NodeValue& value,
+      Eigen::MatrixXd& adjunct) const override;
+
+ private:
+  uint num_components() const {
+    return static_cast<uint>(in_nodes.size()) - 1;
+  }
+  const Distribution* component(uint k) const {
+    return static_cast<const Distribution*>(in_nodes[k + 1]);
+  }
+  uint sample_component(std::mt19937& gen) const;
+  // Computes log f(value) and fills `ratios` with f_k(value) / f(value) for
+  // each component k. Note that w_k * ratios(k) is the responsibility of
+  // component k, and ratios(k) is also d log f / d w_k.
+  double compute_ratios(const graph::NodeValue& value) const;
+  // The iid counterpart: `observation_ratios` becomes a K x N matrix with one
+  // column per element of value, and log_probs gets the log f of each
+  // element.
+  void compute_iid_ratios(
+      const graph::NodeValue& value,
+      Eigen::MatrixXd& log_probs,
+      Eigen::MatrixXd& observation_ratios) const;
+
+  // Scratch buffers reused across calls so that the scalar paths, which run
+  // once per node per inference step, do not allocate. Parallel chains each
+  // own a copy of the graph. Within a chain, log_prob_iid may run on several
+  // ranges of observations at once (a mixture may be a component of another
+  // one), so it keeps its ratios in a local buffer; only the backward passes,
+  // which run serially, fill `iid_ratios`.
+  mutable Eigen::VectorXd ratios;
+  mutable Eigen::MatrixXd iid_ratios;
+};
+
+} // namespace distribution
+} // namespace beanmachine
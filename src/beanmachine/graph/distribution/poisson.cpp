@@ -92,6 +92,16 @@ void Poisson::gradient_log_prob_param(
       k * grad_lambda * grad_lambda / (lambda * lambda);
 }
 
+void Poisson::gradient_log_prob_param_lanes(
+    const graph::NodeValue& value,
+    Eigen::ArrayXd& grad1,
+    Eigen::ArrayXd& grad2) const {
+  assert(value.type.variable_type == graph::VariableType::SCALAR);
+  graph::natural_t k = value._natural;
+  double lambda = in_nodes[0]->value._double;
+  add_param_lanes(0, k / lambda - 1, -(k / (lambda * lambda)), grad1, grad2);
+}
+
 void Poisson::backward_param(const graph::NodeValue& value, double adjunct)
     const {
   assert(value.type.variable_type == graph::VariableType::SCALAR);
@@ -208,6 +208,41 @@ void StudentT::gradient_log_prob_param(
   }
 }
 
+void StudentT::gradient_log_prob_param_lanes(
+    const NodeValue& value,
+    Eigen::ArrayXd& grad1,
+    Eigen::ArrayXd& grad2) const {
+  assert(value.type.variable_type == graph::VariableType::SCALAR);
+  T_PREPARE_GRAD()
+  // see gradient_log_prob_param for the derivatives
+  if (param_has_lanes(0)) {
+    double grad_n = _grad1_log_prob_n(n, s, n_s_sq_p_x_m_l_sq);
+    double grad2_n2 = 0.25 * util::polygamma(1, (n + 1) / 2) -
+        0.25 * util::polygamma(1, n / 2) + 0.5 / (n * n) -
+        (s * s / n_s_sq_p_x_m_l_sq - 1 / n) -
+        0.5 * (n + 1) *
+            (-std::pow(s, 4) / (n_s_sq_p_x_m_l_sq * n_s_sq_p_x_m_l_sq) +
+             1 / (n * n));
+    add_param_lanes(0, grad_n, grad2_n2, grad1, grad2);
+  }
+  if (param_has_lanes(1)) {
+    double grad_l = _grad1_log_prob_l(x, n, l, n_s_sq_p_x_m_l_sq);
+    double grad2_l2 = -(n + 1) / n_s_sq_p_x_m_l_sq +
+        2 * (n + 1) * (x - l) * (x - l) /
+            (n_s_sq_p_x_m_l_sq * n_s_sq_p_x_m_l_sq);
+    add_param_lanes(1, grad_l, grad2_l2, grad1, grad2);
+  }
+  if (param_has_lanes(2)) {
+    double grad_s = _grad1_log_prob_s(n, s, n_s_sq_p_x_m_l_sq);
+    double grad2_s2 = 1 / (s * s) -
+        (n + 1) *
+            (n / n_s_sq_p_x_m_l_sq -
+             2 * n * n * s * s / (n_s_sq_p_x_m_l_sq * n_s_sq_p_x_m_l_sq) +
+             1 / (s * s));
+    add_param_lanes(2, grad_s, grad2_s2, grad1, grad2);
+  }
+}
+
 void StudentT::backward_value(
     const graph::NodeValue& value,
     graph::DoubleMatrix& back_grad,
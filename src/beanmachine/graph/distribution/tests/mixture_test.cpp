@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "beanmachine/graph/graph.h"
+
+using namespace beanmachine::graph;
+
+TEST(testdistrib, mixture) {
+  Graph g;
+  auto real1 = g.add_constant(-1.0);
+  auto real2 = g.add_constant(0.0);
+  auto real3 = g.add_constant(2.0);
+  auto pos1 = g.add_constant_pos_real(1.0);
+  Eigen::MatrixXd w(3, 1);
+  w << 0.2, 0.3, 0.5;
+  auto weights = g.add_constant_col_simplex_matrix(w);
+  Eigen::MatrixXd w2(2, 1);
+  w2 << 0.4, 0.6;
+  auto weights2 = g.add_constant_col_simplex_matrix(w2);
+  auto gamma_dist = g.add_distribution(
+      DistributionType::GAMMA,
+      AtomicType::POS_REAL,
+      std::vector<uint>{pos1, pos1});
+  auto d1 = g.add_distribution(
+      DistributionType::NORMAL,
+      AtomicType::REAL,
+      std::vector<uint>{real1, pos1});
+  auto d2 = g.add_distribution(
+      DistributionType::NORMAL,
+      AtomicType::REAL,
+      std::vector<uint>{real2, pos1});
+  auto d3 = g.add_distribution(
+      DistributionType::NORMAL,
+      AtomicType::REAL,
+      std::vector<uint>{real3, pos1});
+  // negative test: needs weights and at least one component
+  EXPECT_THROW(
+      g.add_distribution(
+          DistributionType::MIXTURE,
+          AtomicType::REAL,
+          std::vector<uint>{weights}),
+      std::invalid_argument);
+  // negative test: weights must be a simplex with one row per component
+  EXPECT_THROW(
+      g.add_distribution(
+          DistributionType::MIXTURE,
+          AtomicType::REAL,
+          std::vector<uint>{real1, d1, d2, d3}),
+      std::invalid_argument);
+  EXPECT_THROW(
+      g.add_distribution(
+          DistributionType::MIXTURE,
+          AtomicType::REAL,
+          std::vector<uint>{weights2, d1, d2, d3}),
+      std::invalid_argument);
+  // negative test: components must be distributions of the sample type
+  EXPECT_THROW(
+      g.add_distribution(
+          DistributionType::MIXTURE,
+          AtomicType::REAL,
+          std::vector<uint>{weights, d1, real2, d3}),
+      std::invalid_argument);
+  EXPECT_THROW(
+      g.add_distribution(
+          DistributionType::MIXTURE,
+          AtomicType::REAL,
+          std::vector<uint>{weights, d1, gamma_dist, d3}),
+      std::invalid_argument);
+  auto mix_dist = g.add_distribution(
+      DistributionType::MIXTURE,
+      AtomicType::REAL,
+      std::vector<uint>{weights, d1, d2, d3});
+  // mean = 0.2 * -1 + 0.5 * 2 = 0.8
+  // second moment = 1 + 0.2 * 1 + 0.5 * 4 = 3.2
+  auto x = g.add_operator(OperatorType::SAMPLE, std::vector<uint>{mix_dist});
+  auto x_sq = g.add_operator(OperatorType::MULTIPLY, std::vector<uint>{x, x});
+  g.query(x);
+  g.query(x_sq);
+  const std::vector<double>& means =
+      g.infer_mean(100000, InferenceType::REJECTION);
+  EXPECT_NEAR(means[0], 0.8, 0.02);
+  EXPECT_NEAR(means[1], 3.2, 0.05);
+  // a single-component mixture is the component itself
+  Eigen::MatrixXd w1(1, 1);
+  w1 << 1.0;
+  auto weights1 = g.add_constant_col_simplex_matrix(w1);
+  auto single = g.add_distribution(
+      DistributionType::MIXTURE,
+      AtomicType::REAL,
+      std::vector<uint>{weights1, d3});
+  auto y = g.add_operator(OperatorType::SAMPLE, std::vector<uint>{single});
+  auto z = g.add_operator(OperatorType::SAMPLE, std::vector<uint>{d3});
+  g.observe(y, 0.7);
+  g.observe(z, 0.7);
+  EXPECT_NEAR(g.log_prob(y), g.log_prob(z), 1e-10);
+}
+
+// Builds the three component mixture of bimixture_of_mixture from
+// bimixture_test.cpp either with nested bimixtures or with a single mixture
+// whose weights are (q, (1-q) * p, (1-q) * (1-p)).
+static Graph build_mixture_model(bool nested, bool with_iid = true) {
+  Graph g;
+  auto size = g.add_constant((natural_t)2);
+  auto flat_real = g.add_distribution(
+      DistributionType::FLAT, AtomicType::REAL, std::vector<uint>{});
+  auto flat_pos = g.add_distribution(
+      DistributionType::FLAT, AtomicType::POS_REAL, std::vector<uint>{});
+  auto m1 = g.add_operator(OperatorType::SAMPLE, std::vector<uint>{flat_real});
+  auto m2 = g.add_operator(OperatorType::SAMPLE, std::vector<uint>{flat_real});
+  auto m3 = g.add_operator(OperatorType::SAMPLE, std::vector<uint>{flat_real});
+  auto s = g.add_operator(OperatorType::SAMPLE, std::vector<uint>{flat_pos});
+  auto d1 = g.add_distribution(
+      DistributionType::NORMAL, AtomicType::REAL, std::vector<uint>{m1, s});
+  auto d2 = g.add_distribution(
+      DistributionType::NORMAL, AtomicType::REAL, std::vector<uint>{m2, s});
+  auto d3 = g.add_distribution(
+      DistributionType::NORMAL, AtomicType::REAL, std::vector<uint>{m3, s});
+  double p_val = 0.37, q_val = 0.62;
+  uint dist;
+  if (nested) {
+    auto flat_prob = g.add_distribution(
+        DistributionType::FLAT, AtomicType::PROBABILITY, std::vector<uint>{});
+    auto p = g.add_operator(OperatorType::SAMPLE, std::vector<uint>{flat_prob});
+    auto q = g.add_operator(OperatorType::SAMPLE, std::vector<uint>{flat_prob});
+    g.observe(p, p_val);
+    g.observe(q, q_val);
+    auto dist_a = g.add_distribution(
+        DistributionType::BIMIXTURE,
+        AtomicType::REAL,
+        std::vector<uint>{p, d1, d2});
+    dist = g.add_distribution(
+        DistributionType::BIMIXTURE,
+        AtomicType::REAL,
+        std::vector<uint>{q, d3, dist_a});
+  } else {
+    Eigen::MatrixXd alpha = Eigen::MatrixXd::Ones(3, 1);
+    auto alpha_node = g.add_constant_pos_matrix(alpha);
+    auto diri = g.add_distribution(
+        DistributionType::DIRICHLET,
+        ValueType(
+            VariableType::COL_SIMPLEX_MATRIX, AtomicType::PROBABILITY, 3, 1),
+        std::vector<uint>{alpha_node});
+    auto w = g.add_operator(OperatorType::SAMPLE, std::vector<uint>{diri});
+    Eigen::MatrixXd w_obs(3, 1);
+    w_obs << q_val, (1 - q_val) * p_val, (1 - q_val) * (1 - p_val);
+    g.observe(w, w_obs);
+    dist = g.add_distribution(
+        DistributionType::MIXTURE,
+        AtomicType::REAL,
+        std::vector<uint>{w, d3, d1, d2});
+  }
+  auto x = g.add_operator(OperatorType::SAMPLE, std::vector<uint>{dist});
+  g.observe(m1, -1.2);
+  g.observe(m2, 0.4);
+  g.observe(m3, -0.3);
+  g.observe(s, 1.8);
+  g.observe(x, -0.5);
+  if (with_iid) {
+    auto xiid = g.add_operator(
+        OperatorType::IID_SAMPLE, std::vector<uint>{dist, size});
+    Eigen::MatrixXd xobs(2, 1);
+    xobs << 0.5, -1.5;
+    g.observe(xiid, xobs);
+  }
+  return g;
+}
+
+TEST(testdistrib, mixture_vs_bimixture) {
+  Graph nested = build_mixture_model(true);
+  Graph mix = build_mixture_model(false);
+  // the Dirichlet(1, 1, 1) prior on the weights contributes log(2)
+  EXPECT_NEAR(mix.full_log_prob(), -4.9374 + std::log(2.0), 1e-3);
+  EXPECT_NEAR(
+      mix.full_log_prob() - std::log(2.0), nested.full_log_prob(), 1e-8);
+
+  // forward gradients w.r.t. the component parameters (bimixture only
+  // supports these for scalar values)
+  Graph nested_scalar = build_mixture_model(true, false);
+  Graph mix_scalar = build_mixture_model(false, false);
+  for (uint node : std::vector<uint>{3, 4, 5, 6}) {
+    double nested_grad1 = 0, nested_grad2 = 0, mix_grad1 = 0, mix_grad2 = 0;
+    nested_scalar.gradient_log_prob(node, nested_grad1, nested_grad2);
+    mix_scalar.gradient_log_prob(node, mix_grad1, mix_grad2);
+    EXPECT_NEAR(mix_grad1, nested_grad1, 1e-6);
+    EXPECT_NEAR(mix_grad2, nested_grad2, 1e-6);
+  }
+
+  // backward gradients, see bimixture_of_mixture for the PyTorch values
+  std::vector<DoubleMatrix*> back_grad;
+  mix.eval_and_grad(back_grad);
+  EXPECT_EQ(back_grad.size(), 7);
+  EXPECT_NEAR((*back_grad[0]), 0.0658, 1e-3); // m1
+  EXPECT_NEAR((*back_grad[1]), -0.1571, 1e-3); // m2
+  EXPECT_NEAR((*back_grad[2]), -0.1221, 1e-3); // m3
+  EXPECT_NEAR((*back_grad[3]), -1.2290, 1e-3); // s
+  EXPECT_NEAR((*back_grad[5]), 0.0716, 1e-3); // x
+  EXPECT_NEAR(back_grad[6]->coeff(0), -0.2170, 1e-3); // xiid
+  EXPECT_NEAR(back_grad[6]->coeff(1), 0.3589, 1e-3);
+  // weights: the Dirichlet(1, 1, 1) prior has zero gradient, and by the chain
+  // rule through w = (q, (1-q) * p, (1-q) * (1-p)) we recover the gradients
+  // w.r.t. p and q of the nested model.
+  double p = 0.37, q = 0.62;
+  const DoubleMatrix& w_grad = *back_grad[4];
+  EXPECT_NEAR((1 - q) * (w_grad(1) - w_grad(2)), 0.0683, 1e-3); // p
+  EXPECT_NEAR(w_grad(0) - p * w_grad(1) - (1 - p) * w_grad(2), 0.2410, 1e-3);
+}
@@ -92,19 +92,6 @@ DoubleMatrix& DoubleMatrix::operator+=(double d) {
   }
 }
 
-DoubleMatrix& DoubleMatrix::operator+=(const Matrix& matrix) {
-  switch (TYPE(*this)) {
-    case DOUBLE:
-      throw double_matrix_error(
-          "In-place addition of matrix to 'DoubleMatrix' containing double");
-    case MATRIX:
-      get<Matrix>(*this) += matrix;
-      return *this;
-    default:
-      throw double_matrix_error("In-place addition to empty DoubleMatrix");
-  }
-}
-
 DoubleMatrix& DoubleMatrix::operator+=(const DoubleMatrix& another) {
   switch (TYPE(*this)) {
     case DOUBLE:
@@ -133,19 +120,6 @@ DoubleMatrix& DoubleMatrix::operator-=(double d) {
   }
 }
 
-DoubleMatrix& DoubleMatrix::operator-=(const Matrix& matrix) {
-  switch (TYPE(*this)) {
-    case DOUBLE:
-      throw double_matrix_error(
-          "In-place subtraction of matrix to 'DoubleMatrix' containing double");
-    case MATRIX:
-      get<Matrix>(*this) -= matrix;
-      return *this;
-    default:
-      throw double_matrix_error("In-place subtraction to empty DoubleMatrix");
-  }
-}
-
 DoubleMatrix& DoubleMatrix::operator-=(const DoubleMatrix& another) {
   switch (TYPE(*this)) {
     case DOUBLE:
@@ -14,6 +14,14 @@
 namespace beanmachine {
 namespace graph {
 
+struct DoubleMatrixError : public std::runtime_error {
+  explicit DoubleMatrixError(const char* message)
+      : std::runtime_error(message) {}
+};
+
+template <typename Derived, bool double_matrix_on_left>
+class DoubleMatrixProduct;
+
 struct DoubleMatrix : public std::variant<double, Eigen::MatrixXd> {
   using Matrix = Eigen::MatrixXd;
   using Index = Matrix::Index;
@@ -57,13 +65,36 @@ struct DoubleMatrix : public std::variant<double, Eigen::MatrixXd> {
   DoubleMatrix& operator=(DoubleMatrix&& another);
 
   DoubleMatrix& operator+=(double d);
-  DoubleMatrix& operator+=(const Matrix& matrix);
   DoubleMatrix& operator+=(const DoubleMatrix& another);
 
   DoubleMatrix& operator-=(double d);
-  DoubleMatrix& operator-=(const Matrix& matrix);
   DoubleMatrix& operator-=(const DoubleMatrix& another);
 
+  // In-place addition and subtraction of matrices take any Eigen matrix or
+  // array expression and evaluate it directly into the held matrix, so that
+  // the coefficient-wise expressions of gradient updates run as a single
+  // loop without an intermediate matrix.
+  template <typename Derived>
+  DoubleMatrix& operator+=(const Eigen::MatrixBase<Derived>& matrix);
+  template <typename Derived>
+  DoubleMatrix& operator+=(const Eigen::ArrayBase<Derived>& array) {
+    return *this += array.matrix();
+  }
+  template <typename Derived>
+  DoubleMatrix& operator-=(const Eigen::MatrixBase<Derived>& matrix);
+  template <typename Derived>
+  DoubleMatrix& operator-=(const Eigen::ArrayBase<Derived>& array) {
+    return *this -= array.matrix();
+  }
+
+  // Accumulates a lazy product (see DoubleMatrixProduct).
+  template <typename Derived, bool double_matrix_on_left>
+  DoubleMatrix& operator+=(
+      const DoubleMatrixProduct<Derived, double_matrix_on_left>& product);
+  template <typename Derived, bool double_matrix_on_left>
+  DoubleMatrix& operator-=(
+      const DoubleMatrixProduct<Derived, double_matrix_on_left>& product);
+
   // A substitute for operator*(DoubleMatrix, Matrix).
   //
   // One might ask why we need these method instead of operator*(DoubleMatrix,
@@ -92,35 +123,15 @@ struct DoubleMatrix : public std::variant<double, Eigen::MatrixXd> {
   // but this would prevent generic code that works for both doubles and
   // matrices.
   template <typename Derived>
-  static DoubleMatrix times(
+  static DoubleMatrixProduct<Derived, true> times(
       const DoubleMatrix& dm,
-      const Eigen::MatrixBase<Derived>& matrix) {
-    switch (dm.index()) {
-      case 0:
-        return DoubleMatrix{std::get<double>(dm) * matrix};
-      case 1:
-        return DoubleMatrix{std::get<Matrix>(dm) * matrix};
-      default:
-        throw std::runtime_error(
-            "Multiplying DoubleMatrix that does not hold a value.");
-    }
-  }
+      const Eigen::MatrixBase<Derived>& matrix);
 
   // A substitute for operator*(Matrix, DoubleMatrix).
   template <typename Derived>
-  static DoubleMatrix times(
+  static DoubleMatrixProduct<Derived, false> times(
       const Eigen::MatrixBase<Derived>& matrix,
-      const DoubleMatrix& dm) {
-    switch (dm.index()) {
-      case 0:
-        return DoubleMatrix{matrix * std::get<double>(dm)};
-      case 1:
-        return DoubleMatrix{matrix * std::get<Matrix>(dm)};
-      default:
-        throw std::runtime_error(
-            "Multiplying DoubleMatrix that does not hold a value.");
-    }
-  }
+      const DoubleMatrix& dm);
 
   Array array();
   const ArrayOfConst array() const;
@@ -156,38 +167,170 @@ DoubleMatrix operator*(const DoubleMatrix& double_matrix, double d);
 
 DoubleMatrix operator*(double d, const DoubleMatrix& double_matrix);
 
+/*
+The product of a DoubleMatrix and an Eigen matrix expression, in either
+order, as returned by DoubleMatrix::times and operator*. Like Eigen's own
+expressions it is evaluated lazily: accumulating it into a DoubleMatrix with
++= or -= computes it directly into the destination. That is a single scaled
+loop if the DoubleMatrix holds a double, and a matrix product accumulated
+without a temporary (as with Eigen's noalias()) if it holds a matrix, so the
+operands must not alias the destination. Used anywhere else, it converts to
+the DoubleMatrix it evaluates to. It refers to its operands, so it must not
+outlive the full expression creating it (do not store it with `auto`).
+*/
+template <typename Derived, bool double_matrix_on_left>
+class DoubleMatrixProduct {
+ public:
+  DoubleMatrixProduct(
+      const DoubleMatrix& double_matrix,
+      const Eigen::MatrixBase<Derived>& matrix)
+      : double_matrix(double_matrix), matrix(matrix) {}
+
+  DoubleMatrix eval() const {
+    switch (double_matrix.index()) {
+      case 0:
+        return DoubleMatrix{std::get<double>(double_matrix) * matrix};
+      case 1:
+        if constexpr (double_matrix_on_left) {
+          return DoubleMatrix{
+              std::get<DoubleMatrix::Matrix>(double_matrix) * matrix};
+        } else {
+          return DoubleMatrix{
+              matrix * std::get<DoubleMatrix::Matrix>(double_matrix)};
+        }
+      default:
+        throw DoubleMatrixError(
+            "Multiplying DoubleMatrix that does not hold a value.");
+    }
+  }
+
+  /* implicit */ operator DoubleMatrix() const {
+    return eval();
+  }
+
+  // destination += product if add, destination -= product otherwise
+  template <bool add>
+  void accumulate_into(DoubleMatrix::Matrix& destination) const {
+    switch (double_matrix.index()) {
+      case 0: {
+        double d = std::get<double>(double_matrix);
+        if constexpr (add) {
+          destination += d * matrix;
+        } else {
+          destination -= d * matrix;
+        }
+        return;
+      }
+      case 1: {
+        const auto& m = std::get<DoubleMatrix::Matrix>(double_matrix);
+        if constexpr (double_matrix_on_left and add) {
+          destination.noalias() += m * matrix;
+        } else if constexpr (double_matrix_on_left) {
+          destination.noalias() -= m * matrix;
+        } else if constexpr (add) {
+          destination.noalias() += matrix * m;
+        } else {
+          destination.noalias() -= matrix * m;
+        }
+        return;
+      }
+      default:
+        throw DoubleMatrixError(
+            "Multiplying DoubleMatrix that does not hold a value.");
+    }
+  }
+
+ private:
+  const DoubleMatrix& double_matrix;
+  const Eigen::MatrixBase<Derived>& matrix;
+};
+
 template <typename Derived>
-DoubleMatrix operator*(
-    const DoubleMatrix& double_matrix,
+DoubleMatrixProduct<Derived, true> DoubleMatrix::times(
+    const DoubleMatrix& dm,
+    const Eigen::MatrixBase<Derived>& matrix) {
+  return DoubleMatrixProduct<Derived, true>(dm, matrix);
+}
+
+template <typename Derived>
+DoubleMatrixProduct<Derived, false> DoubleMatrix::times(
+    const Eigen::MatrixBase<Derived>& matrix,
+    const DoubleMatrix& dm) {
+  return DoubleMatrixProduct<Derived, false>(dm, matrix);
+}
+
+template <typename Derived>
+DoubleMatrix& DoubleMatrix::operator+=(
     const Eigen::MatrixBase<Derived>& matrix) {
-  switch (double_matrix.index()) {
+  switch (index()) {
     case 0:
-      return DoubleMatrix{std::get<double>(double_matrix) * matrix};
+      throw DoubleMatrixError(
+          "In-place addition of matrix to 'DoubleMatrix' containing double");
     case 1:
-      return DoubleMatrix{
-          std::get<DoubleMatrix::Matrix>(double_matrix) * matrix};
+      std::get<Matrix>(*this) += matrix;
+      return *this;
     default:
-      throw std::runtime_error(
-          "Multiplying DoubleMatrix that does not hold a value.");
+      throw DoubleMatrixError("In-place addition to empty DoubleMatrix");
   }
 }
 
 template <typename Derived>
-DoubleMatrix operator*(
-    const Eigen::MatrixBase<Derived>& matrix,
-    const DoubleMatrix& double_matrix) {
-  switch (double_matrix.index()) {
+DoubleMatrix& DoubleMatrix::operator-=(
+    const Eigen::MatrixBase<Derived>& matrix) {
+  switch (index()) {
+    case 0:
+      throw DoubleMatrixError(
+          "In-place subtraction of matrix to 'DoubleMatrix' containing double");
+    case 1:
+      std::get<Matrix>(*this) -= matrix;
+      return *this;
+    default:
+      throw DoubleMatrixError("In-place subtraction to empty DoubleMatrix");
+  }
+}
+
+template <typename Derived, bool double_matrix_on_left>
+DoubleMatrix& DoubleMatrix::operator+=(
+    const DoubleMatrixProduct<Derived, double_matrix_on_left>& product) {
+  switch (index()) {
     case 0:
-      return DoubleMatrix{matrix * std::get<double>(double_matrix)};
+      return *this += product.eval();
     case 1:
-      return DoubleMatrix{
-          matrix * std::get<DoubleMatrix::Matrix>(double_matrix)};
+      product.template accumulate_into<true>(std::get<Matrix>(*this));
+      return *this;
     default:
-      throw std::runtime_error(
-          "Multiplying DoubleMatrix that does not hold a value.");
+      throw DoubleMatrixError("In-place addition to empty DoubleMatrix");
   }
 }
 
+template <typename Derived, bool double_matrix_on_left>
+DoubleMatrix& DoubleMatrix::operator-=(
+    const DoubleMatrixProduct<Derived, double_matrix_on_left>& product) {
+  switch (index()) {
+    case 0:
+      return *this -= product.eval();
+    case 1:
+      product.template accumulate_into<false>(std::get<Matrix>(*this));
+      return *this;
+    default:
+      throw DoubleMatrixError("In-place subtraction to empty DoubleMatrix");
+  }
+}
+
+template <typename Derived>
+DoubleMatrixProduct<Derived, true> operator*(
+    const DoubleMatrix& double_matrix,
+    const Eigen::MatrixBase<Derived>& matrix) {
+  return DoubleMatrix::times(double_matrix, matrix);
+}
+
+template <typename Derived>
+DoubleMatrixProduct<Derived, false> operator*(
+    const Eigen::MatrixBase<Derived>& matrix,
+    const DoubleMatrix& double_matrix) {
+  return DoubleMatrix::times(matrix, double_matrix);
+}
+
 DoubleMatrix operator*(const DoubleMatrix& dm1, const DoubleMatrix& dm2);
 
 /// +
@@ -210,10 +353,5 @@ DoubleMatrix::Matrix operator+(
 
 DoubleMatrix operator+(const DoubleMatrix& dm1, const DoubleMatrix& dm2);
 
-struct DoubleMatrixError : public std::runtime_error {
-  explicit DoubleMatrixError(const char* message)
-      : std::runtime_error(message) {}
-};
-
 } // namespace graph
 } // namespace beanmachine
@@ -70,6 +70,26 @@ void ExpProduct::gradient_log_prob(
   grad2 += running_prod_2grad;
 }
 
+void ExpProduct::gradient_log_prob_lanes(
+    Eigen::ArrayXd& grad1,
+    Eigen::ArrayXd& grad2) const {
+  // the running terms of gradient_log_prob, one lane each
+  double running_prod = 1;
+  Eigen::ArrayXd running_prod_1grad = Eigen::ArrayXd::Zero(grad1.size());
+  Eigen::ArrayXd running_prod_2grad = Eigen::ArrayXd::Zero(grad1.size());
+  for (const Node* node : in_nodes) {
+    double x = node->value._double;
+    running_prod_2grad = running_prod_2grad * x +
+        2 * running_prod_1grad * node->grad1_lanes +
+        running_prod * node->grad2_lanes;
+    running_prod_1grad = running_prod_1grad * x +
+        running_prod * node->grad1_lanes;
+    running_prod *= x;
+  }
+  grad1 += running_prod_1grad;
+  grad2 += running_prod_2grad;
+}
+
 // In backward mode, we add the dlog_prob(x1,...,xk)/dxi to each parent xi
 // for ExpProduct, dlog_prob(x1,...,xk)/dxi = prod{xj} for all j!=i.
 void ExpProduct::backward() {
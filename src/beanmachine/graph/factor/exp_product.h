@@ -21,6 +21,8 @@ class ExpProduct : public Factor {
       const graph::Node* target_node,
       double& grad1,
       double& grad2) const override;
+  void gradient_log_prob_lanes(Eigen::ArrayXd& grad1, Eigen::ArrayXd& grad2)
+      const override;
   void backward() override;
 };
 
@@ -56,6 +56,7 @@ void Graph::gibbs(uint num_samples, uint seed, InferConfig infer_config) {
       }
     }
   }
+  reset_tracked_log_prob();
   // markov_blanket of a node is the set of other nodes whose conditional
   // probability changes when the value of this node changes. This is a
   // symmetric relation and we only track it for the subset of nodes that
@@ -87,8 +88,71 @@ void Graph::gibbs(uint num_samples, uint seed, InferConfig infer_config) {
     node_ptrs.push_back(nodes[node_id].get());
   }
   assert(node_ptrs.size() > 0); // keep linter happy
+  // flips the value of the target node of a pool entry, propagates it to its
+  // deterministic children and returns the log odds of keeping the old value
+  auto flip_and_propagate = [&](decltype(pool)::iterator it) -> double {
+    // for the target sampled node grab its deterministic and stochastic
+    // children
+    // the following dance of getting into a tuple is needed because this
+    // version of C++ doesn't have structured bindings
+    std::tuple<const std::vector<uint>&, const std::vector<uint>&> tmp_tuple =
+        it->second;
+    const std::vector<uint>& det_nodes = std::get<0>(tmp_tuple);
+    const std::vector<uint>& sto_nodes = std::get<1>(tmp_tuple);
+    assert(it->first == sto_nodes.front());
+    // now, compute the probability of all the stochastic nodes that are
+    // going to be affected when we change the value of the target node
+    double old_logweight = 0;
+    for (uint node_id : sto_nodes) {
+      const Node* node = node_ptrs[node_id];
+      old_logweight += node->log_prob();
+    }
+    // save the values of the deterministic descendants of the target node
+    // as well the target node itself
+    for (uint node_id : det_nodes) {
+      const Node* node = node_ptrs[node_id];
+      old_values[node_id] = node->value;
+    }
+    Node* tgt_node = node_ptrs[it->first];
+    old_values[it->first] = tgt_node->value;
+    // propose a new value for the target node and update all the
+    // deterministic children note: assuming only boolean values
+    if (tgt_node->value.type != AtomicType::BOOLEAN) {
+      throw std::runtime_error(
+          "all stochastic random variables should be boolean");
+    }
+    tgt_node->value._bool = not tgt_node->value._bool; // flip
+    for (uint node_id : det_nodes) {
+      Node* node = node_ptrs[node_id];
+      node->eval(gen);
+    }
+    // compute the probability of the stochastic nodes with the new value
+    // of the target node
+    double new_logweight = 0;
+    for (uint node_id : sto_nodes) {
+      const Node* node = node_ptrs[node_id];
+      new_logweight += node->log_prob();
+    }
+    return old_logweight - new_logweight;
+  };
+  // undoes flip_and_propagate
+  auto restore = [&](decltype(pool)::iterator it) {
+    for (uint node_id : std::get<0>(it->second)) {
+      Node* node = node_ptrs[node_id];
+      node->value = old_values[node_id];
+    }
+    node_ptrs[it->first]->value = old_values[it->first];
+  };
+  // With Rao-Blackwellization, the mean of a queried node in the pool is
+  // estimated from its conditional probability of being true given the
+  // rest of the current sample, which we get from its log odds of keeping
+  // its current value. These have a lower variance than the sampled values.
+  bool rao_blackwellize =
+      infer_config.rao_blackwellize and agg_type == AggregationType::MEAN;
+  std::vector<double> conditional_means(queries.size(), NAN);
   // sampling outer loop
-  for (uint snum = 0; snum < num_samples + infer_config.num_warmup; snum++) {
+  for (uint snum = 0; snum < infer_config.num_iterations(num_samples);
+       snum++) {
     for (auto it = pool.begin(); it != pool.end(); ++it) {
       bool must_change = false; // must_change => must change current value
       // if we have a cached value of the transition odds then use that instead
@@ -100,60 +164,13 @@ void Graph::gibbs(uint num_samples, uint seed, InferConfig infer_config) {
           must_change = true;
         }
       }
-      // for the target sampled node grab its deterministic and stochastic
-      // children
-      // the following dance of getting into a tuple is needed because this
-      // version of C++ doesn't have structured bindings
-      std::tuple<const std::vector<uint>&, const std::vector<uint>&> tmp_tuple =
-          it->second;
-      const std::vector<uint>& det_nodes = std::get<0>(tmp_tuple);
-      const std::vector<uint>& sto_nodes = std::get<1>(tmp_tuple);
-      assert(it->first == sto_nodes.front());
-      // now, compute the probability of all the stochastic nodes that are
-      // going to be affected when we change the value of the target node
-      double old_logweight = 0;
-      for (uint node_id : sto_nodes) {
-        const Node* node = node_ptrs[node_id];
-        old_logweight += node->log_prob();
-      }
-      // save the values of the deterministic descendants of the target node
-      // as well the target node itself
-      for (uint node_id : det_nodes) {
-        const Node* node = node_ptrs[node_id];
-        old_values[node_id] = node->value;
-      }
-      Node* tgt_node = node_ptrs[it->first];
-      old_values[it->first] = tgt_node->value;
-      // propose a new value for the target node and update all the
-      // deterministic children note: assuming only boolean values
-      if (tgt_node->value.type != AtomicType::BOOLEAN) {
-        throw std::runtime_error(
-            "all stochastic random variables should be boolean");
-      }
-      tgt_node->value._bool = not tgt_node->value._bool; // flip
-      for (uint node_id : det_nodes) {
-        Node* node = node_ptrs[node_id];
-        node->eval(gen);
-      }
-      // compute the probability of the stochastic nodes with the new value
-      // of the target node
-      double new_logweight = 0;
-      for (uint node_id : sto_nodes) {
-        const Node* node = node_ptrs[node_id];
-        new_logweight += node->log_prob();
-      }
-      // compute logodds of keeping the current value
-      double logodds = old_logweight - new_logweight;
+      double logodds = flip_and_propagate(it);
       // Time to make a decision! Do we keep the old value or pick a new value.
       if ((not must_change) and util::sample_logodds(gen, logodds)) {
         // if the move to the new value is rejected then we need to restore
         // all the deterministic decendants and the target node to original
         // values
-        for (uint node_id : det_nodes) {
-          Node* node = node_ptrs[node_id];
-          node->value = old_values[node_id];
-        }
-        tgt_node->value = old_values[it->first];
+        restore(it);
         cache_logodds[it->first] = logodds;
       } else {
         // if we change the value of this node then all the other nodes in the
@@ -162,13 +179,31 @@ void Graph::gibbs(uint num_samples, uint seed, InferConfig infer_config) {
           cache_logodds[node_id] = NAN;
         }
         cache_logodds[it->first] = -logodds;
+        add_to_tracked_log_prob(node_ptrs[it->first], -logodds);
       }
     }
-    if (infer_config.keep_log_prob) {
-      collect_log_prob(full_log_prob());
-    }
-    if (infer_config.keep_warmup or snum >= infer_config.num_warmup) {
-      collect_sample();
+    if (infer_config.is_collected(snum)) {
+      if (infer_config.keep_log_prob) {
+        collect_log_prob(tracked_log_prob());
+      }
+      if (rao_blackwellize) {
+        for (uint pos = 0; pos < queries.size(); pos++) {
+          auto it = pool.find(queries[pos]);
+          if (it == pool.end()) {
+            continue;
+          }
+          if (std::isnan(cache_logodds[it->first])) {
+            cache_logodds[it->first] = flip_and_propagate(it);
+            restore(it);
+          }
+          double prob_keep = util::logistic(cache_logodds[it->first]);
+          conditional_means[pos] =
+              node_ptrs[it->first]->value._bool ? prob_keep : 1 - prob_keep;
+        }
+        collect_sample(conditional_means);
+      } else {
+        collect_sample();
+      }
     }
   }
 }
@@ -0,0 +1,546 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dlfcn.h>
+#include <unistd.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+#include "beanmachine/graph/distribution/distribution.h"
+#include "beanmachine/graph/global/compiled_density.h"
+#include "beanmachine/graph/operator/stochasticop.h"
+
+namespace beanmachine {
+namespace graph {
+
+namespace {
+
+const char* PREAMBLE =
+    "// Generated by beanmachine::graph::generate_log_density_source.\n"
+    "#include <cmath>\n"
+    "\n"
+    "namespace {\n"
+    "\n"
+    "inline double log1pexp(double x) {\n"
+    "  return x > 0 ? x + std::log1p(std::exp(-x)) : std::log1p(std::exp(x));\n"
+    "}\n"
+    "\n"
+    "inline double logistic(double x) {\n"
+    "  return 1.0 / (1.0 + std::exp(-x));\n"
+    "}\n"
+    "\n"
+    "inline double digamma(double x) {\n"
+    "  double result = 0.0;\n"
+    "  for (; x < 6.0; x += 1.0) {\n"
+    "    result -= 1.0 / x;\n"
+    "  }\n"
+    "  double f = 1.0 / (x * x);\n"
+    "  return result + std::log(x) - 0.5 / x -\n"
+    "      f * (1.0 / 12 - f * (1.0 / 120 - f * (1.0 / 252 -\n"
+    "      f * (1.0 / 240 - f / 132))));\n"
+    "}\n"
+    "\n"
+    "} // namespace\n"
+    "\n";
+
+std::string literal(double value) {
+  if (std::isnan(value)) {
+    return "NAN";
+  } else if (std::isinf(value)) {
+    return value > 0 ? "HUGE_VAL" : "(-HUGE_VAL)";
+  }
+  std::ostringstream os;
+  os << std::setprecision(std::numeric_limits<double>::max_digits10) << value;
+  std::string text = os.str();
+  if (text.find_first_of(".e") == std::string::npos) {
+    text += ".0";
+  }
+  return value < 0 ? "(" + text + ")" : text;
+}
+
+// Straight-line code for the log density of a graph (see
+// generate_log_density_source). The value of node n is v<n> and the
+// adjoint of a node that depends on theta is g<n>.
+class DensityCodegen {
+ public:
+  explicit DensityCodegen(Graph& graph) {
+    graph.ensure_evaluation_and_inference_readiness();
+    // the layout of GlobalState
+    for (Node* node : graph.supp) {
+      if (node->is_stochastic() and not node->is_observed) {
+        flat_index[node] = flat_size++;
+      }
+    }
+    for (Node* node : graph.supp) {
+      emit(node);
+    }
+  }
+
+  std::string source() const {
+    std::ostringstream os;
+    os << PREAMBLE;
+    os << "extern \"C\" int bmg_dimension() {\n"
+       << "  return " << flat_size << ";\n"
+       << "}\n\n";
+    os << "extern \"C\" double bmg_log_prob(const double* theta) {\n"
+       << "  double lp = 0.0;\n"
+       << forward.str() << "  return lp;\n"
+       << "}\n\n";
+    os << "extern \"C\" double bmg_log_prob_and_grad(\n"
+       << "    const double* theta,\n"
+       << "    double* grad) {\n"
+       << "  double lp = 0.0;\n"
+       << forward.str();
+    for (Node* node : variable_nodes) {
+      os << "  double " << adjoint(node) << " = 0.0;\n";
+    }
+    os << log_prob_adjoints.str();
+    for (auto it = operator_adjoints.rbegin(); it != operator_adjoints.rend();
+         ++it) {
+      os << *it;
+    }
+    os << gradient.str() << "  return lp;\n"
+       << "}\n";
+    return os.str();
+  }
+
+ private:
+  [[noreturn]] void unsupported(Node* node, const std::string& what) {
+    throw std::invalid_argument(
+        "generate_log_density_source does not support " + what + " (node " +
+        std::to_string(node->index) + ")");
+  }
+
+  std::string value(Node* node) {
+    if (node->node_type == NodeType::CONSTANT or node->is_observed) {
+      const NodeValue& value = node->value;
+      if (value.type.variable_type != VariableType::SCALAR) {
+        unsupported(node, "matrix values");
+      }
+      switch (value.type.atomic_type) {
+        case AtomicType::BOOLEAN:
+          return value._bool ? "1.0" : "0.0";
+        case AtomicType::NATURAL:
+          return literal(static_cast<double>(value._natural));
+        default:
+          return literal(value._double);
+      }
+    }
+    return "v" + std::to_string(node->index);
+  }
+
+  std::string adjoint(Node* node) const {
+    return "g" + std::to_string(node->index);
+  }
+
+  bool is_variable(Node* node) const {
+    return variables.count(node) > 0;
+  }
+
+  void add_variable(Node* node) {
+    variables.insert(node);
+    variable_nodes.push_back(node);
+  }
+
+  // adds expression to the adjoint of node, if node depends on theta
+  void add_adjoint(std::ostream& os, Node* node, const std::string& expression)
+      const {
+    if (is_variable(node)) {
+      os << "  " << adjoint(node) << " += " << expression << ";\n";
+    }
+  }
+
+  void emit(Node* node) {
+    if (not emitted.insert(node).second or
+        node->node_type == NodeType::CONSTANT) {
+      return;
+    }
+    for (Node* in_node : node->in_nodes) {
+      emit(in_node);
+    }
+    if (node->node_type == NodeType::DISTRIBUTION) {
+      return;
+    } else if (node->node_type != NodeType::OPERATOR) {
+      unsupported(node, "factors");
+    }
+    if (node->value.type.variable_type != VariableType::SCALAR) {
+      unsupported(node, "matrix values");
+    }
+    auto op = static_cast<oper::Operator*>(node);
+    if (op->op_type == OperatorType::SAMPLE) {
+      emit_sample(static_cast<oper::StochasticOperator*>(node));
+    } else if (node->is_stochastic()) {
+      unsupported(node, "this stochastic operator");
+    } else {
+      emit_operator(op);
+    }
+  }
+
+  void emit_sample(oper::StochasticOperator* node) {
+    if (not node->is_observed) {
+      std::string i = std::to_string(flat_index.at(node));
+      std::string v = value(node);
+      std::string g = adjoint(node);
+      if (node->transform_type == TransformType::LOG) {
+        std::string u = "u" + std::to_string(node->index);
+        forward << "  const double " << u << " = theta[" << i << "];\n"
+                << "  const double " << v << " = std::exp(" << u << ");\n"
+                << "  lp += " << u << ";\n";
+        gradient << "  grad[" << i << "] = " << g << " * " << v
+                 << " + 1.0;\n";
+      } else if (node->transform_type == TransformType::NONE) {
+        forward << "  const double " << v << " = theta[" << i << "];\n";
+        gradient << "  grad[" << i << "] = " << g << ";\n";
+      } else {
+        unsupported(node, "this transform");
+      }
+      add_variable(node);
+    }
+    emit_log_prob(
+        static_cast<distribution::Distribution*>(node->in_nodes[0]), node);
+  }
+
+  void emit_log_prob(distribution::Distribution* dist, Node* sample) {
+    std::string x = value(sample);
+    auto param = [&](uint k) { return value(dist->in_nodes[k]); };
+    auto param_node = [&](uint k) { return dist->in_nodes[k]; };
+    std::ostringstream& a = log_prob_adjoints;
+    bool discrete = dist->dist_type == DistributionType::BERNOULLI or
+        dist->dist_type == DistributionType::BERNOULLI_LOGIT or
+        dist->dist_type == DistributionType::POISSON;
+    if (discrete and not sample->is_observed) {
+      unsupported(sample, "unobserved discrete samples");
+    }
+    switch (dist->dist_type) {
+      case DistributionType::NORMAL: {
+        std::string m = param(0), s = param(1);
+        std::string d = "(" + x + " - " + m + ")";
+        forward << "  lp += -std::log(" << s << ") - 0.91893853320467267 - "
+                << "0.5 * " << d << " * " << d << " / (" << s << " * " << s
+                << ");\n";
+        std::string z = d + " / (" + s + " * " + s + ")";
+        add_adjoint(a, sample, "-" + z);
+        add_adjoint(a, param_node(0), z);
+        add_adjoint(a, param_node(1), "-1.0 / " + s + " + " + z + " * " + d +
+                        " / " + s);
+        break;
+      }
+      case DistributionType::HALF_NORMAL: {
+        std::string s = param(0);
+        forward << "  lp += -std::log(" << s << ") - 0.22579135264472744 - "
+                << "0.5 * " << x << " * " << x << " / (" << s << " * " << s
+                << ");\n";
+        add_adjoint(a, sample, "-" + x + " / (" + s + " * " + s + ")");
+        add_adjoint(
+            a,
+            param_node(0),
+            "-1.0 / " + s + " + " + x + " * " + x + " / (" + s + " * " + s +
+                " * " + s + ")");
+        break;
+      }
+      case DistributionType::HALF_CAUCHY: {
+        std::string s = param(0);
+        std::string r = "(" + x + " / " + s + ")";
+        std::string q = "(" + s + " * " + s + " + " + x + " * " + x + ")";
+        forward << "  lp += -std::log(1.5707963267948966 * " << s
+                << ") - std::log1p(" << r << " * " << r << ");\n";
+        add_adjoint(a, sample, "-2.0 * " + x + " / " + q);
+        add_adjoint(
+            a,
+            param_node(0),
+            "-1.0 / " + s + " + 2.0 * " + x + " * " + x + " / (" + s + " * " +
+                q + ")");
+        break;
+      }
+      case DistributionType::GAMMA: {
+        std::string shape = param(0), rate = param(1);
+        forward << "  lp += " << shape << " * std::log(" << rate
+                << ") - std::lgamma(" << shape << ") + (" << shape
+                << " - 1.0) * std::log(" << x << ") - " << rate << " * " << x
+                << ";\n";
+        add_adjoint(
+            a, sample, "(" + shape + " - 1.0) / " + x + " - " + rate);
+        add_adjoint(
+            a,
+            param_node(0),
+            "std::log(" + rate + ") - digamma(" + shape + ") + std::log(" + x +
+                ")");
+        add_adjoint(a, param_node(1), shape + " / " + rate + " - " + x);
+        break;
+      }
+      case DistributionType::BETA: {
+        std::string alpha = param(0), beta = param(1);
+        std::string sum = "(" + alpha + " + " + beta + ")";
+        forward << "  lp += (" << alpha << " - 1.0) * std::log(" << x
+                << ") + (" << beta << " - 1.0) * std::log(1.0 - " << x
+                << ") + std::lgamma" << sum << " - std::lgamma(" << alpha
+                << ") - std::lgamma(" << beta << ");\n";
+        add_adjoint(
+            a,
+            sample,
+            "(" + alpha + " - 1.0) / " + x + " - (" + beta +
+                " - 1.0) / (1.0 - " + x + ")");
+        add_adjoint(
+            a,
+            param_node(0),
+            "std::log(" + x + ") + digamma" + sum + " - digamma(" + alpha +
+                ")");
+        add_adjoint(
+            a,
+            param_node(1),
+            "std::log(1.0 - " + x + ") + digamma" + sum + " - digamma(" + beta +
+                ")");
+        break;
+      }
+      case DistributionType::BERNOULLI: {
+        std::string p = param(0);
+        if (sample->value._bool) {
+          forward << "  lp += std::log(" << p << ");\n";
+          add_adjoint(a, param_node(0), "1.0 / " + p);
+        } else {
+          forward << "  lp += std::log(1.0 - " << p << ");\n";
+          add_adjoint(a, param_node(0), "-1.0 / (1.0 - " + p + ")");
+        }
+        break;
+      }
+      case DistributionType::BERNOULLI_LOGIT: {
+        std::string l = param(0);
+        if (sample->value._bool) {
+          forward << "  lp += -log1pexp(-" << l << ");\n";
+          add_adjoint(a, param_node(0), "logistic(-" + l + ")");
+        } else {
+          forward << "  lp += -log1pexp(" << l << ");\n";
+          add_adjoint(a, param_node(0), "-logistic(" + l + ")");
+        }
+        break;
+      }
+      case DistributionType::POISSON: {
+        std::string rate = param(0);
+        double k = static_cast<double>(sample->value._natural);
+        forward << "  lp += " << literal(k) << " * std::log(" << rate
+                << ") - " << rate << " - " << literal(std::lgamma(k + 1))
+                << ";\n";
+        add_adjoint(
+            a, param_node(0), literal(k) + " / " + rate + " - 1.0");
+        break;
+      }
+      default:
+        unsupported(dist, "this distribution");
+    }
+  }
+
+  void emit_operator(oper::Operator* node) {
+    std::string y = value(node);
+    std::string g = adjoint(node);
+    std::vector<std::string> in;
+    for (Node* in_node : node->in_nodes) {
+      in.push_back(value(in_node));
+    }
+    std::string expression;
+    // the adjoint of each input, as a multiple of g
+    std::vector<std::string> partials;
+    switch (node->op_type) {
+      case OperatorType::TO_REAL:
+      case OperatorType::TO_POS_REAL:
+      case OperatorType::TO_PROBABILITY:
+      case OperatorType::TO_NEG_REAL:
+        expression = in[0];
+        partials = {"1.0"};
+        break;
+      case OperatorType::NEGATE:
+        expression = "-" + in[0];
+        partials = {"-1.0"};
+        break;
+      case OperatorType::COMPLEMENT:
+        expression = "1.0 - " + in[0];
+        partials = {"-1.0"};
+        break;
+      case OperatorType::ADD:
+        for (uint k = 0; k < in.size(); k++) {
+          expression += (k == 0 ? "" : " + ") + in[k];
+          partials.push_back("1.0");
+        }
+        break;
+      case OperatorType::MULTIPLY:
+        for (uint k = 0; k < in.size(); k++) {
+          expression += (k == 0 ? "" : " * ") + in[k];
+          std::string others;
+          for (uint j = 0; j < in.size(); j++) {
+            if (j != k) {
+              others += (others.empty() ? "" : " * ") + in[j];
+            }
+          }
+          partials.push_back(others.empty() ? "1.0" : others);
+        }
+        break;
+      case OperatorType::EXP:
+        expression = "std::exp(" + in[0] + ")";
+        partials = {y};
+        break;
+      case OperatorType::EXPM1:
+        expression = "std::expm1(" + in[0] + ")";
+        partials = {"(" + y + " + 1.0)"};
+        break;
+      case OperatorType::LOG:
+        expression = "std::log(" + in[0] + ")";
+        partials = {"(1.0 / " + in[0] + ")"};
+        break;
+      case OperatorType::LOG1PEXP:
+        expression = "log1pexp(" + in[0] + ")";
+        partials = {"logistic(" + in[0] + ")"};
+        break;
+      case OperatorType::LOG1MEXP:
+        expression = "std::log(-std::expm1(" + in[0] + "))";
+        partials = {"(-1.0 / std::expm1(-" + in[0] + "))"};
+        break;
+      case OperatorType::LOGISTIC:
+        expression = "logistic(" + in[0] + ")";
+        partials = {"(" + y + " * (1.0 - " + y + "))"};
+        break;
+      case OperatorType::POW:
+        expression = "std::pow(" + in[0] + ", " + in[1] + ")";
+        partials = {
+            "(" + in[1] + " * std::pow(" + in[0] + ", " + in[1] + " - 1.0))",
+            "(" + y + " * std::log(" + in[0] + "))"};
+        break;
+      default:
+        unsupported(node, "this operator");
+    }
+    forward << "  const double " << y << " = " << expression << ";\n";
+
+    bool variable = false;
+    for (Node* in_node : node->in_nodes) {
+      variable = variable or is_variable(in_node);
+    }
+    if (not variable) {
+      return;
+    }
+    add_variable(node);
+    std::ostringstream os;
+    for (uint k = 0; k < node->in_nodes.size(); k++) {
+      add_adjoint(os, node->in_nodes[k], g + " * " + partials[k]);
+    }
+    operator_adjoints.push_back(os.str());
+  }
+
+  int flat_size = 0;
+  std::map<Node*, int> flat_index;
+  std::set<Node*> emitted;
+  std::set<Node*> variables;
+  // the nodes that depend on theta, in the order of evaluation
+  std::vector<Node*> variable_nodes;
+  std::ostringstream forward;
+  std::ostringstream log_prob_adjoints;
+  // the backward step of each operator, in the order of evaluation
+  std::vector<std::string> operator_adjoints;
+  std::ostringstream gradient;
+};
+
+std::string read_file(const std::string& file) {
+  std::ifstream is(file);
+  std::ostringstream os;
+  os << is.rdbuf();
+  return os.str();
+}
+
+} // namespace
+
+std::string generate_log_density_source(Graph& graph) {
+  return DensityCodegen(graph).source();
+}
+
+CompiledLogDensity::CompiledLogDensity(const std::string& source)
+    : source(source) {
+  const char* tmpdir = std::getenv("TMPDIR");
+  std::string directory_template =
+      std::string(tmpdir != nullptr and *tmpdir ? tmpdir : "/tmp") +
+      "/bmg_density_XXXXXX";
+  std::vector<char> directory_name(
+      directory_template.begin(), directory_template.end());
+  directory_name.push_back('\0');
+  if (mkdtemp(directory_name.data()) == nullptr) {
+    throw std::runtime_error("cannot create a directory to compile in");
+  }
+  std::string directory(directory_name.data());
+  std::string source_file = directory + "/density.cpp";
+  std::string library_file = directory + "/density.so";
+  std::string log_file = directory + "/compiler.log";
+  std::ofstream(source_file) << source;
+
+  const char* compiler = std::getenv("CXX");
+  std::string command =
+      std::string(compiler != nullptr and *compiler ? compiler : "c++") +
+      " -std=c++17 -O2 -fPIC -shared -o '" + library_file + "' '" +
+      source_file + "' > '" + log_file + "' 2>&1";
+  std::string error;
+  if (std::system(command.c_str()) != 0) {
+    error = "compiling the log density failed: " + read_file(log_file);
+  } else {
+    library = dlopen(library_file.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (library == nullptr) {
+      error = std::string("loading the log density failed: ") + dlerror();
+    }
+  }
+  // a loaded library stays mapped after its file is removed
+  std::remove(source_file.c_str());
+  std::remove(library_file.c_str());
+  std::remove(log_file.c_str());
+  rmdir(directory.c_str());
+  if (not error.empty()) {
+    throw std::runtime_error(error);
+  }
+
+  auto dimension_function =
+      reinterpret_cast<int (*)()>(dlsym(library, "bmg_dimension"));
+  log_prob_function = reinterpret_cast<double (*)(const double*)>(
+      dlsym(library, "bmg_log_prob"));
+  log_prob_and_grad_function =
+      reinterpret_cast<double (*)(const double*, double*)>(
+          dlsym(library, "bmg_log_prob_and_grad"));
+  if (dimension_function == nullptr or log_prob_function == nullptr or
+      log_prob_and_grad_function == nullptr) {
+    dlclose(library);
+    throw std::runtime_error(
+        "the compiled log density lacks the functions of "
+        "generate_log_density_source");
+  }
+  flat_size = dimension_function();
+}
+
+CompiledLogDensity::~CompiledLogDensity() {
+  dlclose(library);
+}
+
+double CompiledLogDensity::log_prob(const Eigen::VectorXd& theta) const {
+  if (theta.size() != flat_size) {
+    throw std::invalid_argument(
+        "The size of theta must be the dimension of the density");
+  }
+  return log_prob_function(theta.data());
+}
+
+double CompiledLogDensity::log_prob_and_grad(
+    const Eigen::VectorXd& theta,
+    Eigen::VectorXd& grad) const {
+  if (theta.size() != flat_size) {
+    throw std::invalid_argument(
+        "The size of theta must be the dimension of the density");
+  }
+  grad.resize(flat_size);
+  return log_prob_and_grad_function(theta.data(), grad.data());
+}
+
+} // namespace graph
+} // namespace beanmachine
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+#include <string>
+
+#include "beanmachine/graph/graph.h"
+
+namespace beanmachine {
+namespace graph {
+
+/*
+Generates C++ source for the log density of a graph and its gradient, as
+functions of the flattened unconstrained values of the unobserved
+stochastic nodes in the layout of GlobalState, with the current transforms
+of the graph. Every node of the support becomes a straight-line statement
+with the values of the constants and observations baked in, and the
+gradient is a reverse sweep over the same statements, so the generated code
+has none of the virtual calls of Graph::full_log_prob and
+Graph::update_backgrad.
+
+The generated library exports
+  int bmg_dimension();
+  double bmg_log_prob(const double* theta);
+  double bmg_log_prob_and_grad(const double* theta, double* grad);
+
+Only scalar nodes are supported: the constants, SAMPLE of the NORMAL,
+HALF_NORMAL, HALF_CAUCHY, GAMMA, BETA, BERNOULLI, BERNOULLI_LOGIT and
+POISSON distributions (the discrete ones observed), and the TO_REAL,
+TO_POS_REAL, TO_PROBABILITY, TO_NEG_REAL, NEGATE, COMPLEMENT, ADD,
+MULTIPLY, EXP, EXPM1, LOG, LOG1PEXP, LOG1MEXP, LOGISTIC and POW operators,
+with the LOG transform or none. Other graphs throw std::invalid_argument.
+*/
+std::string generate_log_density_source(Graph& graph);
+
+/*
+A log density generated by generate_log_density_source, compiled into a
+shared library with the local C++ compiler and loaded with dlopen. It
+stands in for the interpreted evaluation of a GlobalState; see
+GlobalMH::set_density_compilation.
+*/
+class CompiledLogDensity {
+ public:
+  /*
+  Compiles the source with the compiler named by the CXX environment
+  variable, or c++, in a temporary directory (TMPDIR or /tmp). Throws
+  std::runtime_error if the compilation or the loading fails.
+
+  :param source: The output of generate_log_density_source.
+  */
+  explicit CompiledLogDensity(const std::string& source);
+  ~CompiledLogDensity();
+  CompiledLogDensity(const CompiledLogDensity&) = delete;
+  CompiledLogDensity& operator=(const CompiledLogDensity&) = delete;
+
+  // The length of a parameter vector.
+  int dimension() const {
+    return flat_size;
+  }
+  const std::string& get_source() const {
+    return source;
+  }
+  double log_prob(const Eigen::VectorXd& theta) const;
+  // :param grad: Output gradient of the log density at theta.
+  double log_prob_and_grad(const Eigen::VectorXd& theta, Eigen::VectorXd& grad)
+      const;
+
+ private:
+  std::string source;
+  void* library = nullptr;
+  double (*log_prob_function)(const double*) = nullptr;
+  double (*log_prob_and_grad_function)(const double*, double*) = nullptr;
+  int flat_size;
+};
+
+} // namespace graph
+} // namespace beanmachine
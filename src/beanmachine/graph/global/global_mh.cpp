@@ -12,6 +12,14 @@ namespace beanmachine {
 namespace graph {
 GlobalMH::GlobalMH(Graph& g) : graph(g), state(GlobalState(g)) {}
 
+void GlobalMH::set_gradient_checkpointing(uint checkpoint_interval) {
+  state.set_gradient_checkpointing(checkpoint_interval);
+}
+
+void GlobalMH::set_density_compilation(bool enabled) {
+  compile_density = enabled;
+}
+
 std::vector<std::vector<NodeValue>>& GlobalMH::infer(
     int num_samples,
     uint seed,
@@ -25,6 +33,17 @@ std::vector<std::vector<NodeValue>>& GlobalMH::infer(
   std::vector<std::vector<NodeValue>> values;
 
   prepare_graph();
+  if (compile_density) {
+    // the generated code bakes in the transforms and the data
+    std::string source = generate_log_density_source(graph);
+    if (compiled_density == nullptr or
+        compiled_density->get_source() != source) {
+      compiled_density = std::make_shared<CompiledLogDensity>(source);
+    }
+    state.set_compiled_density(compiled_density);
+  } else {
+    state.set_compiled_density(nullptr);
+  }
   state.initialize_values(init_type, seed);
   proposer->initialize(state, gen, num_warmup_samples);
 
@@ -50,9 +69,11 @@ std::vector<std::vector<NodeValue>>& GlobalMH::infer(
       double acceptance_prob = std::min(std::exp(acceptance_log_prob), 1.0);
       proposer->warmup(acceptance_prob, i + 1, num_warmup_samples);
       if (save_warmup) {
+        state.update_deterministic_values();
         graph.collect_sample();
       }
     } else {
+      state.update_deterministic_values();
       graph.collect_sample();
     }
   }
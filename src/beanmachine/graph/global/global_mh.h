@@ -6,6 +6,9 @@
  */
 
 #pragma once
+#include <memory>
+
+#include "beanmachine/graph/global/compiled_density.h"
 #include "beanmachine/graph/global/proposer/global_proposer.h"
 #include "beanmachine/graph/graph.h"
 
@@ -26,8 +29,22 @@ class GlobalMH {
       bool save_warmup = false,
       InitType init_type = InitType::RANDOM);
   virtual void prepare_graph() {}
+  // See GlobalState::set_gradient_checkpointing.
+  void set_gradient_checkpointing(uint checkpoint_interval);
+  /*
+  Evaluate the log prob and its gradient with C++ code generated for the
+  prepared graph and compiled at the start of infer (see
+  generate_log_density_source and CompiledLogDensity), rather than by
+  interpreting the graph. The code is regenerated when the transforms or
+  the data of the graph change. Off by default.
+  */
+  void set_density_compilation(bool enabled);
   void single_mh_step(GlobalState& state);
   virtual ~GlobalMH() {}
+
+ private:
+  bool compile_density = false;
+  std::shared_ptr<CompiledLogDensity> compiled_density;
 };
 
 } // namespace graph
@@ -211,11 +211,55 @@ double GlobalState::get_log_prob() {
 }
 
 void GlobalState::update_log_prob() {
-  log_prob = graph.full_log_prob();
+  if (compiled_density != nullptr) {
+    get_flattened_unconstrained_values(compiled_theta);
+    log_prob = compiled_density->log_prob(compiled_theta);
+  } else if (checkpoint_interval > 0) {
+    log_prob = graph.full_log_prob_with_checkpoints();
+  } else {
+    log_prob = graph.full_log_prob();
+  }
 }
 
 void GlobalState::update_backgrad() {
-  graph.update_backgrad(graph.supp);
+  if (compiled_density != nullptr) {
+    get_flattened_unconstrained_values(compiled_theta);
+    compiled_density->log_prob_and_grad(compiled_theta, compiled_grad);
+    // the compiled density only supports scalar nodes
+    for (uint i = 0; i < static_cast<uint>(stochastic_nodes.size()); i++) {
+      stochastic_nodes[i]->back_grad1 = compiled_grad[i];
+    }
+  } else if (checkpoint_interval > 0) {
+    graph.update_backgrad_with_checkpoints();
+  } else {
+    graph.update_backgrad(graph.supp);
+  }
+}
+
+void GlobalState::set_gradient_checkpointing(uint checkpoint_interval) {
+  this->checkpoint_interval = checkpoint_interval;
+  graph.compute_checkpoints(checkpoint_interval);
+}
+
+void GlobalState::set_compiled_density(
+    std::shared_ptr<const CompiledLogDensity> compiled_density) {
+  if (compiled_density != nullptr and
+      compiled_density->dimension() != flat_size) {
+    throw std::invalid_argument(
+        "The dimension of the compiled density is inconsistent with the "
+        "values in the graph");
+  }
+  this->compiled_density = compiled_density;
+}
+
+void GlobalState::update_deterministic_values() {
+  if (compiled_density == nullptr) {
+    return;
+  }
+  std::mt19937 generator(12131); // seed is irrelevant for deterministic ops
+  for (Node* node : deterministic_nodes) {
+    node->eval(generator);
+  }
 }
 
 } // namespace graph
@@ -5,6 +5,10 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#pragma once
+#include <memory>
+
+#include "beanmachine/graph/global/compiled_density.h"
 #include "beanmachine/graph/graph.h"
 
 namespace beanmachine {
@@ -27,6 +31,34 @@ class GlobalState {
   double get_log_prob();
   void update_log_prob();
   void update_backgrad();
+  /*
+  Bounds the memory used by update_log_prob and update_backgrad on models
+  with large intermediate matrices: only every checkpoint_interval-th
+  deterministic matrix node keeps its value, and the others are recomputed
+  when the backward pass needs them (see
+  Graph::update_backgrad_with_checkpoints). 0 turns checkpointing off.
+  */
+  void set_gradient_checkpointing(uint checkpoint_interval);
+  uint get_gradient_checkpointing() const {
+    return checkpoint_interval;
+  }
+  /*
+  Compute the log prob and the gradients with compiled code instead of
+  evaluating the graph, or with the graph again if compiled_density is
+  null. The compiled density must be generated from the graph with its
+  current transforms.
+  */
+  void set_compiled_density(
+      std::shared_ptr<const CompiledLogDensity> compiled_density);
+  std::shared_ptr<const CompiledLogDensity> get_compiled_density() const {
+    return compiled_density;
+  }
+  /*
+  With a compiled density, update_log_prob and update_backgrad do not
+  evaluate the deterministic nodes of the graph; this evaluates them, so
+  that their values are current when a sample is collected.
+  */
+  void update_deterministic_values();
 
  private:
   int flat_size;
@@ -36,6 +68,10 @@ class GlobalState {
   std::vector<NodeValue> stochastic_unconstrained_vals_backup;
   std::vector<DoubleMatrix> stochastic_unconstrained_grads_backup;
   double log_prob;
+  uint checkpoint_interval = 0;
+  std::shared_ptr<const CompiledLogDensity> compiled_density;
+  Eigen::VectorXd compiled_theta;
+  Eigen::VectorXd compiled_grad;
 };
 
 } // namespace graph
@@ -21,5 +21,10 @@ void HMC::prepare_graph() {
   set_default_transforms(graph);
 }
 
+void HMC::set_path_length_adaptation(bool enabled) {
+  auto hmc_proposer = static_cast<HmcProposer*>(proposer.get());
+  hmc_proposer->set_path_length_adaptation(enabled);
+}
+
 } // namespace graph
 } // namespace beanmachine
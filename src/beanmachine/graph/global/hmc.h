@@ -22,6 +22,12 @@ class HMC : public GlobalMH {
   Random variables of type POS_REAL have a LOG transform applied.
   */
   void prepare_graph() override;
+  /*
+  Adapt the path length during warmup with the ChEES criterion and jitter
+  the trajectory lengths; see HmcProposer::set_path_length_adaptation.
+  Off by default.
+  */
+  void set_path_length_adaptation(bool enabled);
 
  private:
   Graph& graph;
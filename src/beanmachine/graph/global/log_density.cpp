@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+#include "beanmachine/graph/global/log_density.h"
+#include "beanmachine/graph/global/util.h"
+
+namespace beanmachine {
+namespace graph {
+
+namespace {
+
+uint default_num_threads(uint num_threads) {
+  if (num_threads == 0) {
+    return std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  return num_threads;
+}
+
+} // namespace
+
+LogDensity::LogDensity(Graph& g, uint num_threads)
+    : budget(default_num_threads(num_threads)) {
+  num_threads = budget.get_max_threads();
+  for (uint i = 0; i < num_threads; i++) {
+    Worker worker;
+    worker.graph = std::make_unique<Graph>(g);
+    set_default_transforms(*worker.graph);
+    worker.state = std::make_unique<GlobalState>(*worker.graph);
+    workers.push_back(std::move(worker));
+  }
+  workers[0].state->get_flattened_unconstrained_values(workers[0].theta);
+  flat_size = static_cast<int>(workers[0].theta.size());
+}
+
+void LogDensity::log_prob(
+    const Eigen::MatrixXd& thetas,
+    Eigen::VectorXd& log_probs) {
+  evaluate(thetas, log_probs, nullptr);
+}
+
+void LogDensity::log_prob_and_grad(
+    const Eigen::MatrixXd& thetas,
+    Eigen::VectorXd& log_probs,
+    Eigen::MatrixXd& grads) {
+  evaluate(thetas, log_probs, &grads);
+}
+
+void LogDensity::evaluate(
+    const Eigen::MatrixXd& thetas,
+    Eigen::VectorXd& log_probs,
+    Eigen::MatrixXd* grads) {
+  if (thetas.cols() != flat_size) {
+    throw std::invalid_argument(
+        "The number of columns of thetas must be the dimension of the density");
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  int batch_size = static_cast<int>(thetas.rows());
+  log_probs.resize(batch_size);
+  if (grads != nullptr) {
+    grads->resize(batch_size, flat_size);
+  }
+  int num_workers =
+      std::min(static_cast<int>(workers.size()), std::max(batch_size, 1));
+  // contiguous blocks of rows, one per worker
+  int block_size = (batch_size + num_workers - 1) / num_workers;
+  std::vector<std::exception_ptr> errors(num_workers, nullptr);
+  auto evaluate_block = [&](std::size_t begin, std::size_t end) {
+    int w = static_cast<int>(begin) / block_size;
+    try {
+      Worker& worker = workers[w];
+      for (int row = static_cast<int>(begin); row < static_cast<int>(end);
+           row++) {
+        worker.theta = thetas.row(row).transpose();
+        worker.state->set_flattened_unconstrained_values(worker.theta);
+        // update_log_prob evaluates the deterministic nodes which the
+        // backward pass then reads
+        worker.state->update_log_prob();
+        log_probs[row] = worker.state->get_log_prob();
+        if (grads != nullptr) {
+          worker.state->update_backgrad();
+          worker.state->get_flattened_unconstrained_grads(worker.grad);
+          grads->row(row) = worker.grad.transpose();
+        }
+      }
+    } catch (...) {
+      errors[w] = std::current_exception();
+    }
+  };
+  // a caller which is a chain of a run shares the budget of the run
+  bool own_budget = util::ThreadBudget::current() == nullptr;
+  util::ChainScope chain_scope(own_budget ? &budget : nullptr);
+  util::parallel_for(batch_size, std::max(block_size, 1), evaluate_block);
+  for (auto& error : errors) {
+    if (error != nullptr) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+} // namespace graph
+} // namespace beanmachine
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "beanmachine/graph/global/global_state.h"
+#include "beanmachine/graph/graph.h"
+#include "beanmachine/graph/thread_pool.h"
+
+namespace beanmachine {
+namespace graph {
+
+/*
+The log density of a graph and its gradient as a function of the flattened
+unconstrained values of its unobserved stochastic nodes (the space in which
+HMC and NUTS move, with the same default transforms), evaluated for batches
+of parameter vectors so that external optimizers and samplers can use the
+graph as a density.
+
+The graph is copied once per worker, and each copy owns its values and
+gradients, so a batch is split into one block of rows per worker and the
+blocks are evaluated in parallel on the shared worker pool of
+util::parallel_for. The calling thread evaluates blocks too. Called from a
+chain running under a util::ThreadBudget, the helpers come from that
+budget; otherwise from a budget of num_threads owned by the LogDensity.
+Later changes to the original graph are not reflected. Calls on the same
+LogDensity from several threads are serialized, since they share the
+workers: a caller waits until the previous call is done.
+*/
+class LogDensity {
+ public:
+  // num_threads = 0 uses one worker per hardware thread
+  explicit LogDensity(Graph& g, uint num_threads = 0);
+
+  // The length of a parameter vector.
+  int dimension() const {
+    return flat_size;
+  }
+  /*
+  :param thetas: One parameter vector per row.
+  :param log_probs: Output log density of each row.
+  */
+  void log_prob(const Eigen::MatrixXd& thetas, Eigen::VectorXd& log_probs);
+  /*
+  :param thetas: One parameter vector per row.
+  :param log_probs: Output log density of each row.
+  :param grads: Output gradient of the log density at each row, one per row.
+  */
+  void log_prob_and_grad(
+      const Eigen::MatrixXd& thetas,
+      Eigen::VectorXd& log_probs,
+      Eigen::MatrixXd& grads);
+
+ private:
+  struct Worker {
+    std::unique_ptr<Graph> graph;
+    std::unique_ptr<GlobalState> state;
+    Eigen::VectorXd theta;
+    Eigen::VectorXd grad;
+  };
+
+  void evaluate(
+      const Eigen::MatrixXd& thetas,
+      Eigen::VectorXd& log_probs,
+      Eigen::MatrixXd* grads);
+
+  int flat_size;
+  std::vector<Worker> workers;
+  util::ThreadBudget budget;
+  std::mutex mutex;
+};
+
+} // namespace graph
+} // namespace beanmachine
@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <thread>
+
+#include "beanmachine/graph/global/multiple_try.h"
+#include "beanmachine/graph/global/proposer/multiple_try_proposer.h"
+
+namespace beanmachine {
+namespace graph {
+
+MultipleTryMH::MultipleTryMH(
+    Graph& g,
+    double step_size,
+    uint num_tries,
+    uint num_threads)
+    : GlobalMH(g), graph(g) {
+  proposer = std::make_unique<MultipleTryProposer>(
+      MultipleTryProposer(step_size, num_tries));
+  if (num_threads == 0) {
+    num_threads =
+        std::min(num_tries, std::max(1u, std::thread::hardware_concurrency()));
+  }
+  this->num_threads = num_threads;
+}
+
+void MultipleTryMH::prepare_graph() {
+  auto multiple_try_proposer =
+      static_cast<MultipleTryProposer*>(proposer.get());
+  multiple_try_proposer->create_replicas(graph, num_threads);
+}
+
+} // namespace graph
+} // namespace beanmachine
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include "beanmachine/graph/global/global_mh.h"
+#include "beanmachine/graph/graph.h"
+
+namespace beanmachine {
+namespace graph {
+
+/*
+Multiple-try Metropolis (see MultipleTryProposer), which spends the
+threads of a single chain on better moves rather than on more chains.
+Each iteration computes 2 * num_tries log probs, spread over num_threads
+replicas of the graph.
+*/
+class MultipleTryMH : public GlobalMH {
+ public:
+  /*
+  :param g: The graph.
+  :param step_size: The scale of the random walk of each try.
+  :param num_tries: The number of candidates of each iteration.
+  :param num_threads: The number of threads computing the log probs of the
+                      candidates; 0 uses one per try, up to the number of
+                      hardware threads.
+  */
+  MultipleTryMH(
+      Graph& g,
+      double step_size,
+      uint num_tries,
+      uint num_threads = 0);
+  void prepare_graph() override;
+
+ private:
+  Graph& graph;
+  uint num_threads;
+};
+
+} // namespace graph
+} // namespace beanmachine
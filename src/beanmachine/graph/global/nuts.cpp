@@ -18,6 +18,16 @@ NUTS::NUTS(Graph& g) : GlobalMH(g), graph(g) {
 
 void NUTS::prepare_graph() {
   set_default_transforms(graph);
+  auto nuts_proposer = static_cast<NutsProposer*>(proposer.get());
+  if (speculative_tree_building) {
+    nuts_proposer->enable_speculation(graph);
+  } else {
+    nuts_proposer->disable_speculation();
+  }
+}
+
+void NUTS::set_speculative_tree_building(bool enabled) {
+  speculative_tree_building = enabled;
 }
 
 } // namespace graph
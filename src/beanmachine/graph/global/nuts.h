@@ -30,9 +30,16 @@ class NUTS : public GlobalMH {
   Random variables of type POS_REAL have a LOG transform applied.
   */
   void prepare_graph() override;
+  /*
+  Build the subtrees of each NUTS iteration speculatively in both
+  directions, on a replica of the graph and a second thread; see
+  NutsProposer::enable_speculation. Off by default.
+  */
+  void set_speculative_tree_building(bool enabled);
 
  private:
   Graph& graph;
+  bool speculative_tree_building = false;
 };
 
 } // namespace graph
@@ -5,11 +5,18 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <algorithm>
+
 #include "beanmachine/graph/global/proposer/hmc_proposer.h"
 
 namespace beanmachine {
 namespace graph {
 
+namespace {
+// the most leapfrog steps of an adapted trajectory
+const double MAX_STEPS = 1000;
+} // namespace
+
 HmcProposer::HmcProposer(
     double path_length,
     double step_size,
@@ -26,7 +33,15 @@ void HmcProposer::initialize(
     int num_warmup_samples) {
   if (num_warmup_samples > 0) {
     step_size_adapter.initialize(step_size);
+    if (adapt_path_length) {
+      path_length_adapter.initialize(path_length);
+    }
   }
+  num_proposals = 0;
+}
+
+void HmcProposer::set_path_length_adaptation(bool enabled) {
+  adapt_path_length = enabled;
 }
 
 double HmcProposer::compute_kinetic_energy(Eigen::VectorXd momentum) {
@@ -49,6 +64,21 @@ void HmcProposer::warmup(
   } else {
     step_size = step_size_adapter.finalize_step_size();
   }
+  if (adapt_path_length) {
+    if (iteration < num_warmup_samples) {
+      path_length = path_length_adapter.update_path_length(
+          acceptance_prob,
+          jitter,
+          trajectory_start,
+          trajectory_end,
+          trajectory_end_momentum);
+    } else {
+      path_length = path_length_adapter.finalize_path_length();
+    }
+    // a trajectory takes between one and MAX_STEPS steps
+    path_length = std::max(
+        step_size, std::min(path_length, MAX_STEPS * step_size));
+  }
 }
 
 Eigen::VectorXd HmcProposer::initialize_momentum(
@@ -77,6 +107,11 @@ double HmcProposer::propose(GlobalState& state, std::mt19937& gen) {
   double initial_K = compute_kinetic_energy(momentum);
 
   int num_steps = static_cast<int>(ceil(path_length / step_size));
+  if (adapt_path_length) {
+    jitter = van_der_corput(++num_proposals);
+    num_steps = std::max(1, static_cast<int>(ceil(jitter * num_steps)));
+    trajectory_start = position;
+  }
 
   // momentum half-step
   Eigen::VectorXd grad_U = compute_potential_gradient(state);
@@ -97,6 +132,10 @@ double HmcProposer::propose(GlobalState& state, std::mt19937& gen) {
     }
   }
 
+  if (adapt_path_length) {
+    trajectory_end = position;
+    trajectory_end_momentum = momentum;
+  }
   double final_K = compute_kinetic_energy(momentum);
   state.update_log_prob();
   double final_U = -state.get_log_prob();
@@ -22,11 +22,29 @@ class HmcProposer : public GlobalProposer {
   void warmup(double acceptance_log_prob, int iteration, int num_warmup_samples)
       override;
   double propose(GlobalState& state, std::mt19937& gen) override;
+  /*
+  Adapt the path length during warmup (see PathLengthAdapter) and jitter
+  the length of each trajectory, instead of using the fixed path length
+  given to the constructor, which becomes the initial value.
+  */
+  void set_path_length_adaptation(bool enabled);
+  double get_path_length() const {
+    return path_length;
+  }
 
  protected:
   StepSizeAdapter step_size_adapter;
   double path_length;
   double step_size;
+  bool adapt_path_length = false;
+  PathLengthAdapter path_length_adapter;
+  // the number of proposals so far, which selects the next jitter
+  uint num_proposals = 0;
+  // the last trajectory, for the path length adaptation
+  double jitter = 1.0;
+  Eigen::VectorXd trajectory_start;
+  Eigen::VectorXd trajectory_end;
+  Eigen::VectorXd trajectory_end_momentum;
   double compute_kinetic_energy(Eigen::VectorXd momentum);
   Eigen::VectorXd compute_potential_gradient(GlobalState& state);
   Eigen::VectorXd initialize_momentum(Eigen::VectorXd theta, std::mt19937& gen);
@@ -45,5 +45,76 @@ double StepSizeAdapter::finalize_step_size() {
   return std::exp(log_best_step_size);
 }
 
+void PathLengthAdapter::initialize(double path_length) {
+  learning_rate = 0.025;
+  beta1 = 0.9;
+  beta2 = 0.95;
+  log_path_length = std::log(path_length);
+  log_averaged_path_length = log_path_length;
+  first_moment = 0.0;
+  second_moment = 0.0;
+  mean_position.resize(0);
+  iteration = 0;
+}
+
+double PathLengthAdapter::update_path_length(
+    double acceptance_prob,
+    double jitter,
+    const Eigen::VectorXd& position,
+    const Eigen::VectorXd& proposed_position,
+    const Eigen::VectorXd& proposed_momentum) {
+  if (std::isnan(acceptance_prob) or not proposed_position.allFinite() or
+      not proposed_momentum.allFinite()) {
+    return std::exp(log_path_length);
+  }
+  iteration++;
+  double iter = (double)iteration;
+  if (mean_position.size() == 0) {
+    mean_position = position;
+  }
+  Eigen::VectorXd centered = position - mean_position;
+  Eigen::VectorXd proposed_centered = proposed_position - mean_position;
+  double squared_distance_change =
+      proposed_centered.squaredNorm() - centered.squaredNorm();
+  // the gradient of ChEES with respect to the (jittered) trajectory length,
+  // weighted by the acceptance probability, and scaled to log_path_length
+  double gradient = acceptance_prob * jitter * std::exp(log_path_length) *
+      squared_distance_change * proposed_centered.dot(proposed_momentum);
+
+  // Adam update of log_path_length
+  first_moment = beta1 * first_moment + (1 - beta1) * gradient;
+  second_moment = beta2 * second_moment + (1 - beta2) * gradient * gradient;
+  double first_corrected = first_moment / (1 - std::pow(beta1, iter));
+  double second_corrected = second_moment / (1 - std::pow(beta2, iter));
+  log_path_length +=
+      learning_rate * first_corrected / (std::sqrt(second_corrected) + 1e-8);
+
+  // the expected next state updates the running mean of the states
+  mean_position += ((acceptance_prob * proposed_position +
+                     (1 - acceptance_prob) * position) -
+                    mean_position) /
+      (iter + 1);
+
+  double average_frac = std::pow(iter, -0.75);
+  log_averaged_path_length = average_frac * log_path_length +
+      (1 - average_frac) * log_averaged_path_length;
+  return std::exp(log_path_length);
+}
+
+double PathLengthAdapter::finalize_path_length() {
+  return std::exp(log_averaged_path_length);
+}
+
+double van_der_corput(uint i) {
+  double value = 0.0;
+  double base = 0.5;
+  for (; i > 0; i >>= 1, base /= 2) {
+    if (i & 1) {
+      value += base;
+    }
+  }
+  return value;
+}
+
 } // namespace graph
 } // namespace beanmachine
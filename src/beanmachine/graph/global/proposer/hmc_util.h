@@ -28,5 +28,61 @@ class StepSizeAdapter {
   int iteration;
 };
 
+/*
+Adapts the trajectory length of HMC during warmup by stochastic gradient
+ascent on the ChEES criterion of [1], the expected squared change of the
+squared distance of the state from the mean of the target:
+
+  ChEES(T) = E[(|theta' - E[theta]|^2 - |theta - E[theta]|^2)^2] / 4
+
+The trajectories are jittered, i.e. the length of each one is T times a
+number in (0, 1), which the gradient estimate accounts for. Since each
+chain adapts on its own, the mean of the target is estimated by the
+running mean of the chain's warmup states rather than across chains.
+
+Reference:
+[1] Matthew Hoffman, Alexey Radul and Pavel Sountsov. "An Adaptive MCMC
+    Scheme for Setting Trajectory Lengths in Hamiltonian Monte Carlo" (2021).
+    http://proceedings.mlr.press/v130/hoffman21a.html
+*/
+class PathLengthAdapter {
+ public:
+  void initialize(double path_length);
+  /*
+  :param acceptance_prob: The acceptance probability of the proposal.
+  :param jitter: The fraction of the path length used by the proposal.
+  :param position: The position at the start of the trajectory.
+  :param proposed_position: The position at the end of the trajectory.
+  :param proposed_momentum: The momentum at the end of the trajectory.
+  :returns: The path length of the next iteration.
+  */
+  double update_path_length(
+      double acceptance_prob,
+      double jitter,
+      const Eigen::VectorXd& position,
+      const Eigen::VectorXd& proposed_position,
+      const Eigen::VectorXd& proposed_momentum);
+  double finalize_path_length();
+
+ private:
+  double learning_rate;
+  double beta1;
+  double beta2;
+  double log_path_length;
+  double log_averaged_path_length;
+  // Adam moments of the gradient of log_path_length
+  double first_moment;
+  double second_moment;
+  Eigen::VectorXd mean_position;
+  int iteration;
+};
+
+/*
+The i-th element (i > 0) of the base 2 van der Corput sequence, which
+covers (0, 1) evenly and is used to jitter trajectory lengths without
+drawing from the chain's random number generator.
+*/
+double van_der_corput(uint i);
+
 } // namespace graph
 } // namespace beanmachine
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <limits>
+#include <stdexcept>
+
+#include "beanmachine/graph/global/proposer/multiple_try_proposer.h"
+#include "beanmachine/graph/global/util.h"
+#include "beanmachine/graph/thread_pool.h"
+#include "beanmachine/graph/util.h"
+
+namespace beanmachine {
+namespace graph {
+
+namespace {
+
+// log_sum_exp of log probs that may all be -inf
+double log_sum_exp_of_log_probs(const std::vector<double>& log_probs) {
+  for (double log_prob : log_probs) {
+    if (log_prob > -std::numeric_limits<double>::infinity()) {
+      return util::log_sum_exp(log_probs);
+    }
+  }
+  return -std::numeric_limits<double>::infinity();
+}
+
+} // namespace
+
+MultipleTryProposer::MultipleTryProposer(double step_size, uint num_tries)
+    : GlobalProposer(), step_size(step_size), num_tries(num_tries) {
+  if (num_tries < 1) {
+    throw std::invalid_argument("multiple-try Metropolis needs a try");
+  }
+}
+
+void MultipleTryProposer::create_replicas(Graph& graph, uint num_threads) {
+  replica_states.clear();
+  replicas.clear();
+  num_threads = std::max(1u, std::min(num_threads, num_tries));
+  budget = std::make_unique<util::ThreadBudget>(num_threads);
+  for (uint i = 0; i < num_threads; i++) {
+    replicas.push_back(copy_with_transforms(graph));
+    replica_states.push_back(std::make_unique<GlobalState>(*replicas.back()));
+  }
+}
+
+void MultipleTryProposer::initialize(
+    GlobalState& state,
+    std::mt19937& /* gen */,
+    int /* num_warmup_samples */) {
+  if (replicas.empty()) {
+    throw std::logic_error(
+        "MultipleTryProposer::create_replicas must be called first");
+  }
+  for (auto& replica_state : replica_states) {
+    replica_state->set_gradient_checkpointing(
+        state.get_gradient_checkpointing());
+    replica_state->set_compiled_density(state.get_compiled_density());
+  }
+}
+
+void MultipleTryProposer::compute_log_probs(
+    const Eigen::MatrixXd& points,
+    std::vector<double>& log_probs) {
+  uint num_points = static_cast<uint>(points.cols());
+  log_probs.resize(num_points);
+  uint num_threads = static_cast<uint>(replica_states.size());
+  std::vector<std::exception_ptr> errors(num_threads);
+  // replica t computes the points t, t + num_threads, ...
+  auto compute = [&](uint t) {
+    try {
+      GlobalState& replica_state = *replica_states[t];
+      for (uint i = t; i < num_points; i += num_threads) {
+        Eigen::VectorXd point = points.col(i);
+        replica_state.set_flattened_unconstrained_values(point);
+        replica_state.update_log_prob();
+        double log_prob = replica_state.get_log_prob();
+        log_probs[i] = std::isnan(log_prob)
+            ? -std::numeric_limits<double>::infinity()
+            : log_prob;
+      }
+    } catch (...) {
+      errors[t] = std::current_exception();
+    }
+  };
+  // the replicas run on the shared worker pool, within the budget of the
+  // calling chain if it has one, and otherwise within their own
+  util::ChainScope chain_scope(
+      util::ThreadBudget::current() == nullptr ? budget.get() : nullptr);
+  util::parallel_for(
+      std::min(num_threads, num_points),
+      1,
+      [&](std::size_t begin, std::size_t end) {
+        for (std::size_t t = begin; t < end; t++) {
+          compute(static_cast<uint>(t));
+        }
+      });
+  for (auto& error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+double MultipleTryProposer::propose(GlobalState& state, std::mt19937& gen) {
+  Eigen::VectorXd position;
+  state.get_flattened_unconstrained_values(position);
+  std::normal_distribution<double> dist(0.0, 1.0);
+  auto draw_around = [&](const Eigen::VectorXd& center, uint num_points) {
+    Eigen::MatrixXd points(center.size(), num_points);
+    for (uint j = 0; j < num_points; j++) {
+      for (int i = 0; i < center.size(); i++) {
+        points(i, j) = center[i] + step_size * dist(gen);
+      }
+    }
+    return points;
+  };
+
+  Eigen::MatrixXd candidates = draw_around(position, num_tries);
+  std::vector<double> candidate_log_probs;
+  compute_log_probs(candidates, candidate_log_probs);
+  double candidate_log_sum = log_sum_exp_of_log_probs(candidate_log_probs);
+  if (candidate_log_sum == -std::numeric_limits<double>::infinity()) {
+    return candidate_log_sum;
+  }
+
+  std::vector<double> weights;
+  for (double log_prob : candidate_log_probs) {
+    weights.push_back(std::exp(log_prob - candidate_log_sum));
+  }
+  std::discrete_distribution<uint> select(weights.begin(), weights.end());
+  Eigen::VectorXd selected = candidates.col(select(gen));
+
+  // the reference points are drawn around the selected candidate, and the
+  // last one is the current state, whose log prob is already known
+  Eigen::MatrixXd references = draw_around(selected, num_tries - 1);
+  std::vector<double> reference_log_probs;
+  compute_log_probs(references, reference_log_probs);
+  reference_log_probs.push_back(state.get_log_prob());
+  double reference_log_sum = log_sum_exp_of_log_probs(reference_log_probs);
+
+  state.set_flattened_unconstrained_values(selected);
+  state.update_log_prob();
+  return candidate_log_sum - reference_log_sum;
+}
+
+} // namespace graph
+} // namespace beanmachine
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include "beanmachine/graph/global/proposer/global_proposer.h"
+#include "beanmachine/graph/thread_pool.h"
+
+namespace beanmachine {
+namespace graph {
+
+/*
+Multiple-try Metropolis with a Gaussian random walk, as in [1] with the
+weights w(y|x) = pi(y) of a symmetric proposal. Each iteration draws
+num_tries candidates around the current state, selects one of them with
+probability proportional to its density, draws num_tries - 1 reference
+points around the selected candidate, and accepts it with probability
+min(1, sum of candidate densities / sum of reference densities, which
+include the current state).
+
+The log probs of the candidates and of the reference points are computed
+concurrently, on replicas of the graph, by the shared worker pool of
+util::parallel_for. A chain running under a util::ThreadBudget shares it
+with the replicas, and otherwise the replicas have a budget of their own.
+The draws do not depend on the number of threads.
+
+Reference:
+[1] Jun S. Liu, Faming Liang and Wing Hung Wong. "The Multiple-Try Method
+    and Local Optimization in Metropolis Sampling" (2000).
+    https://doi.org/10.1080/01621459.2000.10473908
+*/
+class MultipleTryProposer : public GlobalProposer {
+ public:
+  MultipleTryProposer(double step_size, uint num_tries);
+  void initialize(GlobalState& state, std::mt19937& gen, int num_warmup_samples)
+      override;
+  double propose(GlobalState& state, std::mt19937& gen) override;
+  /*
+  Create the replicas that compute the log probs of the proposals.
+
+  :param graph: The graph of the states passed to propose, with its
+                transformations already set.
+  :param num_threads: The number of threads and replicas, at most
+                      num_tries.
+  */
+  void create_replicas(Graph& graph, uint num_threads);
+
+ private:
+  double step_size;
+  uint num_tries;
+  std::vector<std::unique_ptr<Graph>> replicas;
+  std::vector<std::unique_ptr<GlobalState>> replica_states;
+  std::unique_ptr<util::ThreadBudget> budget;
+  // Sets log_probs[i] to the log prob of the i-th column of points.
+  void compute_log_probs(
+      const Eigen::MatrixXd& points,
+      std::vector<double>& log_probs);
+};
+
+} // namespace graph
+} // namespace beanmachine
@@ -5,7 +5,12 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <cmath>
+#include <limits>
+
 #include "beanmachine/graph/global/proposer/nuts_proposer.h"
+#include "beanmachine/graph/global/util.h"
+#include "beanmachine/graph/thread_pool.h"
 
 namespace beanmachine {
 namespace graph {
@@ -25,6 +30,23 @@ void NutsProposer::initialize(
   state.get_flattened_unconstrained_values(position);
   find_reasonable_step_size(state, gen, position);
   step_size_adapter.initialize(step_size);
+  if (replica_state != nullptr) {
+    replica_state->set_gradient_checkpointing(
+        state.get_gradient_checkpointing());
+    replica_state->set_compiled_density(state.get_compiled_density());
+  }
+}
+
+void NutsProposer::enable_speculation(Graph& graph) {
+  replica = copy_with_transforms(graph);
+  replica_state = std::make_unique<GlobalState>(*replica);
+  speculation_budget = std::make_unique<util::ThreadBudget>(2);
+}
+
+void NutsProposer::disable_speculation() {
+  speculation_budget.reset();
+  replica_state.reset();
+  replica.reset();
 }
 
 void NutsProposer::warmup(
@@ -193,62 +215,125 @@ NutsProposer::Tree NutsProposer::build_tree(
         direction,
         tree_depth - 1,
         hamiltonian_init);
-    if (!subtree1.no_turn) {
-      return subtree1;
-    } else {
-      Tree tree = Tree();
-      tree.position_new = subtree1.position_new;
-
-      Tree subtree2;
-      if (direction < 0) {
-        subtree2 = build_tree(
-            state,
-            gen,
-            subtree1.position_left,
-            subtree1.momentum_left,
-            slice,
-            direction,
-            tree_depth - 1,
-            hamiltonian_init);
-        tree.position_left = subtree2.position_left;
-        tree.momentum_left = subtree2.momentum_left;
-        tree.position_right = subtree1.position_right;
-        tree.momentum_right = subtree1.momentum_right;
-      } else {
-        subtree2 = build_tree(
-            state,
-            gen,
-            subtree1.position_right,
-            subtree1.momentum_right,
-            slice,
-            direction,
-            tree_depth - 1,
-            hamiltonian_init);
-        tree.position_left = subtree1.position_left;
-        tree.momentum_left = subtree1.momentum_left;
-        tree.position_right = subtree2.position_right;
-        tree.momentum_right = subtree2.momentum_right;
-      }
+    return extend_tree(
+        state,
+        gen,
+        subtree1,
+        slice,
+        direction,
+        tree_depth - 1,
+        hamiltonian_init);
+  }
+}
 
-      double update_prob = subtree2.valid_nodes /
-          std::max(1.0, subtree1.valid_nodes + subtree2.valid_nodes);
-      std::bernoulli_distribution update_dist(update_prob);
-      if (update_dist(gen)) {
-        tree.position_new = subtree2.position_new;
-      }
+// Doubles a tree by building a second subtree of the same depth from its
+// end, i.e. the second half of build_tree.
+NutsProposer::Tree NutsProposer::extend_tree(
+    GlobalState& state,
+    std::mt19937& gen,
+    Tree subtree1,
+    double slice,
+    double direction,
+    int subtree_depth,
+    double hamiltonian_init) {
+  if (!subtree1.no_turn) {
+    return subtree1;
+  }
+  Tree tree = Tree();
+  tree.position_new = subtree1.position_new;
 
-      tree.acceptance_sum = subtree1.acceptance_sum + subtree2.acceptance_sum;
-      tree.total_nodes = subtree1.total_nodes + subtree2.total_nodes;
-      tree.no_turn = subtree2.no_turn and
-          compute_no_turn(
-                         tree.position_left,
-                         tree.momentum_left,
-                         tree.position_right,
-                         tree.momentum_right);
-      tree.valid_nodes = subtree1.valid_nodes + subtree2.valid_nodes;
-
-      return tree;
+  Tree subtree2;
+  if (direction < 0) {
+    subtree2 = build_tree(
+        state,
+        gen,
+        subtree1.position_left,
+        subtree1.momentum_left,
+        slice,
+        direction,
+        subtree_depth,
+        hamiltonian_init);
+    tree.position_left = subtree2.position_left;
+    tree.momentum_left = subtree2.momentum_left;
+    tree.position_right = subtree1.position_right;
+    tree.momentum_right = subtree1.momentum_right;
+  } else {
+    subtree2 = build_tree(
+        state,
+        gen,
+        subtree1.position_right,
+        subtree1.momentum_right,
+        slice,
+        direction,
+        subtree_depth,
+        hamiltonian_init);
+    tree.position_left = subtree1.position_left;
+    tree.momentum_left = subtree1.momentum_left;
+    tree.position_right = subtree2.position_right;
+    tree.momentum_right = subtree2.momentum_right;
+  }
+
+  double update_prob = subtree2.valid_nodes /
+      std::max(1.0, subtree1.valid_nodes + subtree2.valid_nodes);
+  std::bernoulli_distribution update_dist(update_prob);
+  if (update_dist(gen)) {
+    tree.position_new = subtree2.position_new;
+  }
+
+  tree.acceptance_sum = subtree1.acceptance_sum + subtree2.acceptance_sum;
+  tree.total_nodes = subtree1.total_nodes + subtree2.total_nodes;
+  tree.no_turn = subtree2.no_turn and
+      compute_no_turn(
+                     tree.position_left,
+                     tree.momentum_left,
+                     tree.position_right,
+                     tree.momentum_right);
+  tree.valid_nodes = subtree1.valid_nodes + subtree2.valid_nodes;
+
+  return tree;
+}
+
+// Grows a partial tree built from the given end of the trajectory, one
+// doubling at a time, until it has the given depth, it turns, or the next
+// doubling would exceed the given number of leapfrog steps. Since the first
+// subtree of a tree is built first, the result is the same as build_tree.
+void NutsProposer::grow_tree(
+    GlobalState& state,
+    std::mt19937& gen,
+    PartialTree& partial,
+    const Eigen::VectorXd& position,
+    const Eigen::VectorXd& momentum,
+    double slice,
+    double direction,
+    int tree_depth,
+    double hamiltonian_init,
+    double max_leapfrog_steps) {
+  double leapfrog_steps = 0;
+  if (partial.depth < 0) {
+    if (max_leapfrog_steps < 1) {
+      return;
     }
+    partial.tree = build_tree_base_case(
+        state, position, momentum, slice, direction, hamiltonian_init);
+    partial.depth = 0;
+    leapfrog_steps = 1;
+  }
+  while (partial.depth < tree_depth and partial.tree.no_turn) {
+    // doubling a tree of depth d takes 2^d leapfrog steps
+    double doubling_steps = std::ldexp(1.0, partial.depth);
+    if (leapfrog_steps + doubling_steps > max_leapfrog_steps) {
+      return;
+    }
+    partial.tree = extend_tree(
+        state,
+        gen,
+        partial.tree,
+        slice,
+        direction,
+        partial.depth,
+        hamiltonian_init);
+    partial.depth++;
+    leapfrog_steps += doubling_steps;
   }
 }
 
@@ -274,6 +359,9 @@ double NutsProposer::propose(GlobalState& state, std::mt19937& gen) {
   double total_nodes = 0.0;
 
   std::bernoulli_distribution coin_flip(0.5);
+  // trees built speculatively from each end of the trajectory
+  PartialTree partial_left;
+  PartialTree partial_right;
 
   for (int tree_depth = 0; tree_depth < max_tree_depth; tree_depth++) {
     // sample direction
@@ -283,28 +371,80 @@ double NutsProposer::propose(GlobalState& state, std::mt19937& gen) {
     }
 
     Tree tree;
-    if (direction < 0) {
+    if (replica == nullptr) {
       tree = build_tree(
           state,
           gen,
-          position_left,
-          momentum_left,
+          direction < 0 ? position_left : position_right,
+          direction < 0 ? momentum_left : momentum_right,
           slice,
           direction,
           tree_depth,
           hamiltonian_init);
+    } else {
+      PartialTree& partial = direction < 0 ? partial_left : partial_right;
+      PartialTree& other = direction < 0 ? partial_right : partial_left;
+      // the leapfrog steps left to build this doubling's tree
+      double leapfrog_steps = 0;
+      if (partial.depth < 0) {
+        leapfrog_steps = std::ldexp(1.0, tree_depth);
+      } else if (partial.tree.no_turn) {
+        leapfrog_steps =
+            std::ldexp(1.0, tree_depth) - std::ldexp(1.0, partial.depth);
+      }
+      // meanwhile, the replica grows the tree of the opposite direction,
+      // whose end does not move in this doubling
+      std::mt19937 replica_gen(gen());
+      auto grow = [&](bool speculative) {
+        if (speculative) {
+          grow_tree(
+              *replica_state,
+              replica_gen,
+              other,
+              direction < 0 ? position_right : position_left,
+              direction < 0 ? momentum_right : momentum_left,
+              slice,
+              -direction,
+              tree_depth,
+              hamiltonian_init,
+              leapfrog_steps);
+        } else {
+          grow_tree(
+              state,
+              gen,
+              partial,
+              direction < 0 ? position_left : position_right,
+              direction < 0 ? momentum_left : momentum_right,
+              slice,
+              direction,
+              tree_depth,
+              hamiltonian_init,
+              std::numeric_limits<double>::infinity());
+        }
+      };
+      if (leapfrog_steps >= 1 and other.depth < tree_depth and
+          (other.depth < 0 or other.tree.no_turn)) {
+        // the replica grows its tree on a helper of the budget of the
+        // calling chain if it has one, and otherwise of the two threads of
+        // the speculation; without a spare helper there is no speculation,
+        // which would only delay this doubling
+        util::ChainScope chain_scope(
+            util::ThreadBudget::current() == nullptr ? speculation_budget.get()
+                                                     : nullptr);
+        if (not util::try_parallel_invoke(
+                [&]() { grow(false); }, [&]() { grow(true); })) {
+          grow(false);
+        }
+      } else {
+        grow(false);
+      }
+      tree = partial.tree;
+      partial = PartialTree();
+    }
+    if (direction < 0) {
       position_left = tree.position_left;
       momentum_left = tree.momentum_left;
     } else {
-      tree = build_tree(
-          state,
-          gen,
-          position_right,
-          momentum_right,
-          slice,
-          direction,
-          tree_depth,
-          hamiltonian_init);
       position_right = tree.position_right;
       momentum_right = tree.momentum_right;
     }
@@ -5,7 +5,10 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <memory>
+
 #include "beanmachine/graph/global/proposer/hmc_proposer.h"
+#include "beanmachine/graph/thread_pool.h"
 
 namespace beanmachine {
 namespace graph {
@@ -22,6 +25,25 @@ class NutsProposer : public HmcProposer {
       int iteration,
       int num_warmup_samples) override;
   double propose(GlobalState& state, std::mt19937& gen) override;
+  /*
+  Build the trajectory speculatively on a replica of the graph: while a
+  doubling extends one end of the trajectory, the replica extends the other
+  end on a helper thread of the shared worker pool, for at most as many
+  leapfrog steps. A chain running under a util::ThreadBudget borrows that
+  helper from it, and otherwise from a budget of two threads; a doubling
+  with no spare helper does not speculate. If a later doubling goes in that
+  direction, it starts from the tree built by the replica instead of from
+  scratch; otherwise that tree is discarded. This reduces the latency of an
+  iteration when gradients are expensive, at the cost of a second core. The
+  chain is a different (but equally valid) realization of NUTS than the one
+  without speculation, and under a shared budget it also depends on which
+  doublings found a spare helper.
+
+  :param graph: The graph of the states passed to propose, with its
+                transformations already set.
+  */
+  void enable_speculation(Graph& graph);
+  void disable_speculation();
 
  private:
   struct Tree {
@@ -35,10 +57,19 @@ class NutsProposer : public HmcProposer {
     double acceptance_sum;
     double total_nodes;
   };
+  // A tree built from one end of the trajectory before it was needed.
+  struct PartialTree {
+    Tree tree;
+    // -1 if no tree was built
+    int depth = -1;
+  };
   double step_size;
   double warmup_acceptance_prob;
   double delta_max;
   double max_tree_depth;
+  std::unique_ptr<Graph> replica;
+  std::unique_ptr<GlobalState> replica_state;
+  std::unique_ptr<util::ThreadBudget> speculation_budget;
   void find_reasonable_step_size(
       GlobalState& state,
       std::mt19937& gen,
@@ -68,6 +99,25 @@ class NutsProposer : public HmcProposer {
       double direction,
       int tree_depth,
       double hamiltonian_init);
+  Tree extend_tree(
+      GlobalState& state,
+      std::mt19937& gen,
+      Tree subtree,
+      double slice,
+      double direction,
+      int subtree_depth,
+      double hamiltonian_init);
+  void grow_tree(
+      GlobalState& state,
+      std::mt19937& gen,
+      PartialTree& partial,
+      const Eigen::VectorXd& position,
+      const Eigen::VectorXd& momentum,
+      double slice,
+      double direction,
+      int tree_depth,
+      double hamiltonian_init,
+      double max_leapfrog_steps);
   double compute_hamiltonian(
       GlobalState& state,
       Eigen::VectorXd theta,
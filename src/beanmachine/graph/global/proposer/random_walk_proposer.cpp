@@ -5,15 +5,99 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <cmath>
+#include <limits>
+
 #include "beanmachine/graph/global/proposer/random_walk_proposer.h"
 
 namespace beanmachine {
 namespace graph {
 
+namespace {
+
+const double OPTIMAL_ACCEPTANCE_PROB = 0.234;
+// the decay of the adaptation rate of the global scale
+const double SCALE_ADAPTATION_DECAY = 0.6;
+// keeps the proposal of a coordinate that has not moved from collapsing
+const double MIN_VARIANCE = 1e-10;
+// shorter warmups adapt the global scale only
+const int MIN_COVARIANCE_WARMUP = 100;
+
+} // namespace
+
 RandomWalkProposer::RandomWalkProposer(double step_size) : GlobalProposer() {
   this->step_size = step_size;
 }
 
+void RandomWalkProposer::set_covariance_adaptation(bool enabled) {
+  adapt_covariance = enabled;
+}
+
+Eigen::VectorXd RandomWalkProposer::get_proposal_scales() const {
+  if (scales.size() == 0) {
+    return scales;
+  }
+  if (not adapt_covariance) {
+    return step_size * scales;
+  }
+  return std::exp(log_scale) * scales;
+}
+
+void RandomWalkProposer::initialize(
+    GlobalState& state,
+    std::mt19937& /* gen */,
+    int num_warmup_samples) {
+  Eigen::VectorXd position;
+  state.get_flattened_unconstrained_values(position);
+  log_scale = std::log(step_size);
+  scales = Eigen::VectorXd::Ones(position.size());
+  if (adapt_covariance) {
+    covariance_delay = num_warmup_samples >= MIN_COVARIANCE_WARMUP
+        ? num_warmup_samples / 4
+        : std::numeric_limits<int>::max();
+    mean = position;
+    variance = Eigen::VectorXd::Zero(position.size());
+  }
+}
+
+void RandomWalkProposer::warmup(
+    double acceptance_prob,
+    int iteration,
+    int /* num_warmup_samples */) {
+  if (not adapt_covariance) {
+    return;
+  }
+  // the moments are estimated from the second half of the delay onwards,
+  // once the chain has moved away from its initial values, with the
+  // expected next state: the proposal with the acceptance probability and
+  // the start otherwise
+  int moments_start = covariance_delay / 2;
+  if (iteration > moments_start) {
+    double weight = 1.0 / (iteration - moments_start);
+    Eigen::VectorXd start_deviation = proposal_start - mean;
+    Eigen::VectorXd end_deviation = proposal_end - mean;
+    mean += weight *
+        (acceptance_prob * end_deviation +
+         (1 - acceptance_prob) * start_deviation);
+    variance = (1 - weight) *
+        (variance +
+         weight *
+             (acceptance_prob * end_deviation.cwiseAbs2() +
+              (1 - acceptance_prob) * start_deviation.cwiseAbs2()));
+  }
+
+  log_scale += std::pow(iteration, -SCALE_ADAPTATION_DECAY) *
+      (acceptance_prob - OPTIMAL_ACCEPTANCE_PROB);
+  if (iteration == covariance_delay) {
+    // the optimal global scale of a Gaussian target with a proposal of
+    // its covariance (Roberts, Gelman and Gilks 1997)
+    log_scale = std::log(2.38 / std::sqrt(mean.size()));
+  }
+  if (iteration >= covariance_delay) {
+    scales = (variance.array() + MIN_VARIANCE).sqrt();
+  }
+}
+
 double RandomWalkProposer::propose(GlobalState& state, std::mt19937& gen) {
   double initial_log_prob = state.get_log_prob();
 
@@ -21,8 +105,18 @@ double RandomWalkProposer::propose(GlobalState& state, std::mt19937& gen) {
   state.get_flattened_unconstrained_values(flattened_values);
 
   std::normal_distribution<double> dist(0.0, 1.0);
-  for (int i = 0; i < flattened_values.size(); i++) {
-    flattened_values[i] += step_size * dist(gen);
+  if (adapt_covariance) {
+    proposal_start = flattened_values;
+    double scale = std::exp(log_scale);
+    for (int i = 0; i < flattened_values.size(); i++) {
+      flattened_values[i] += scale * scales[i] * dist(gen);
+    }
+    proposal_end = flattened_values;
+  } else {
+    // the step size itself, since exp(log(step_size)) may differ from it
+    for (int i = 0; i < flattened_values.size(); i++) {
+      flattened_values[i] += step_size * dist(gen);
+    }
   }
   state.set_flattened_unconstrained_values(flattened_values);
   state.update_log_prob();
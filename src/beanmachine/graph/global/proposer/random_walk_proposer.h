@@ -13,10 +13,39 @@ namespace graph {
 class RandomWalkProposer : public GlobalProposer {
  public:
   explicit RandomWalkProposer(double step_size);
+  void initialize(GlobalState& state, std::mt19937& gen, int num_warmup_samples)
+      override;
+  void warmup(double acceptance_prob, int iteration, int num_warmup_samples)
+      override;
   double propose(GlobalState& state, std::mt19937& gen) override;
+  /*
+  Adapt the proposal during warmup, as the adaptive Metropolis algorithm
+  with a global scale in Algorithm 4 of
+    Andrieu and Thoms, "A tutorial on adaptive MCMC" (2008).
+  The proposal of each coordinate is scaled by the standard deviation of
+  the warmup draws, which is used from the end of the first quarter of
+  warmups of at least 100 iterations, and a global scale is adapted by
+  stochastic approximation towards an acceptance probability of 0.234.
+  The step size given to the constructor is the initial scale. The
+  proposal is fixed after warmup.
+  */
+  void set_covariance_adaptation(bool enabled);
+  // The standard deviation of the proposal of each coordinate.
+  Eigen::VectorXd get_proposal_scales() const;
 
  private:
   double step_size;
+  bool adapt_covariance = false;
+  double log_scale;
+  // the warmup iteration from which the variances are used
+  int covariance_delay;
+  Eigen::VectorXd mean;
+  Eigen::VectorXd variance;
+  // the standard deviations of the proposal, before the global scale
+  Eigen::VectorXd scales;
+  // the last proposal, for the adaptation
+  Eigen::VectorXd proposal_start;
+  Eigen::VectorXd proposal_end;
 };
 
 } // namespace graph
@@ -16,5 +16,10 @@ RandomWalkMH::RandomWalkMH(Graph& g, double step_size) : GlobalMH(g) {
       std::make_unique<RandomWalkProposer>(RandomWalkProposer(step_size));
 }
 
+void RandomWalkMH::set_covariance_adaptation(bool enabled) {
+  auto random_walk_proposer = static_cast<RandomWalkProposer*>(proposer.get());
+  random_walk_proposer->set_covariance_adaptation(enabled);
+}
+
 } // namespace graph
 } // namespace beanmachine
@@ -14,6 +14,12 @@ namespace graph {
 class RandomWalkMH : public GlobalMH {
  public:
   RandomWalkMH(Graph& g, double step_size);
+  /*
+  Adapt the proposal scale of each coordinate and a global scale during
+  warmup; see RandomWalkProposer::set_covariance_adaptation. Off by
+  default.
+  */
+  void set_covariance_adaptation(bool enabled);
 };
 
 } // namespace graph
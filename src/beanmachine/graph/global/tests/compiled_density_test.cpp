@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <cmath>
+
+#include <gtest/gtest.h>
+
+#include "beanmachine/graph/global/compiled_density.h"
+#include "beanmachine/graph/global/hmc.h"
+#include "beanmachine/graph/global/log_density.h"
+#include "beanmachine/graph/global/util.h"
+#include "beanmachine/graph/graph.h"
+
+using namespace beanmachine;
+using namespace graph;
+
+TEST(testglobal, compiled_density_matches_graph) {
+  /*
+  mu ~ Normal(0, 5), sigma ~ HalfCauchy(2), a ~ Gamma(2, 3)
+  observations of Normal(mu + a, sigma), HalfNormal(sigma),
+  Beta(a, exp(mu)), Gamma(a, sigma ^ 2), Poisson(a), Bernoulli(logistic(mu)),
+  BernoulliLogit(-(mu * a)) and Normal(log1pexp(mu), complement(p))
+  */
+  Graph g;
+  uint zero = g.add_constant(0.0);
+  uint five = g.add_constant_pos_real(5.0);
+  uint two = g.add_constant_pos_real(2.0);
+  uint three = g.add_constant_pos_real(3.0);
+  uint mu = g.add_operator(
+      OperatorType::SAMPLE,
+      {g.add_distribution(
+          DistributionType::NORMAL,
+          AtomicType::REAL,
+          std::vector<uint>{zero, five})});
+  uint sigma = g.add_operator(
+      OperatorType::SAMPLE,
+      {g.add_distribution(
+          DistributionType::HALF_CAUCHY,
+          AtomicType::POS_REAL,
+          std::vector<uint>{two})});
+  uint a = g.add_operator(
+      OperatorType::SAMPLE,
+      {g.add_distribution(
+          DistributionType::GAMMA,
+          AtomicType::POS_REAL,
+          std::vector<uint>{two, three})});
+
+  auto observe = [&](DistributionType type,
+                     AtomicType sample_type,
+                     std::vector<uint> params,
+                     NodeValue value) {
+    uint dist = g.add_distribution(type, sample_type, params);
+    uint y = g.add_operator(OperatorType::SAMPLE, {dist});
+    g.observe(y, value);
+    return y;
+  };
+  uint mean = g.add_operator(
+      OperatorType::ADD, {mu, g.add_operator(OperatorType::TO_REAL, {a})});
+  uint y = observe(
+      DistributionType::NORMAL,
+      AtomicType::REAL,
+      {mean, sigma},
+      NodeValue(1.3));
+  observe(
+      DistributionType::HALF_NORMAL,
+      AtomicType::POS_REAL,
+      {sigma},
+      NodeValue(AtomicType::POS_REAL, 0.7));
+  uint exp_mu = g.add_operator(OperatorType::EXP, {mu});
+  observe(
+      DistributionType::BETA,
+      AtomicType::PROBABILITY,
+      {a, exp_mu},
+      NodeValue(AtomicType::PROBABILITY, 0.3));
+  observe(
+      DistributionType::GAMMA,
+      AtomicType::POS_REAL,
+      {a, g.add_operator(OperatorType::POW, {sigma, two})},
+      NodeValue(AtomicType::POS_REAL, 1.1));
+  observe(
+      DistributionType::POISSON,
+      AtomicType::NATURAL,
+      {a},
+      NodeValue((natural_t)3));
+  uint p = g.add_operator(OperatorType::LOGISTIC, {mu});
+  observe(
+      DistributionType::BERNOULLI, AtomicType::BOOLEAN, {p}, NodeValue(true));
+  uint logit = g.add_operator(
+      OperatorType::NEGATE,
+      {g.add_operator(
+          OperatorType::MULTIPLY,
+          {mu, g.add_operator(OperatorType::TO_REAL, {a})})});
+  observe(
+      DistributionType::BERNOULLI_LOGIT,
+      AtomicType::BOOLEAN,
+      {logit},
+      NodeValue(false));
+  observe(
+      DistributionType::NORMAL,
+      AtomicType::REAL,
+      {g.add_operator(
+           OperatorType::TO_REAL,
+           {g.add_operator(OperatorType::LOG1PEXP, {mu})}),
+       g.add_operator(
+           OperatorType::TO_POS_REAL,
+           {g.add_operator(OperatorType::COMPLEMENT, {p})})},
+      NodeValue(-0.4));
+  g.query(mu);
+  g.query(exp_mu);
+
+  LogDensity expected(g, 1);
+  set_default_transforms(g);
+  CompiledLogDensity density(generate_log_density_source(g));
+  ASSERT_EQ(density.dimension(), expected.dimension());
+  ASSERT_EQ(density.dimension(), 3);
+
+  Eigen::MatrixXd thetas(4, 3);
+  thetas << 0.1, 0.2, -0.3, -1.2, -0.5, 0.4, 0.7, 1.1, 0.9, 2.0, -1.0, -1.5;
+  Eigen::VectorXd expected_log_probs;
+  Eigen::MatrixXd expected_grads;
+  expected.log_prob_and_grad(thetas, expected_log_probs, expected_grads);
+  for (int i = 0; i < thetas.rows(); i++) {
+    Eigen::VectorXd theta = thetas.row(i).transpose();
+    Eigen::VectorXd grad;
+    EXPECT_NEAR(density.log_prob(theta), expected_log_probs[i], 1e-9);
+    EXPECT_NEAR(
+        density.log_prob_and_grad(theta, grad), expected_log_probs[i], 1e-9);
+    for (int j = 0; j < theta.size(); j++) {
+      EXPECT_NEAR(grad[j], expected_grads(i, j), 1e-8);
+    }
+  }
+
+  // the observations are part of the code
+  std::string source = density.get_source();
+  g.add_data_slot("y", y);
+  g.bind_data_slot("y", NodeValue(2.0));
+  EXPECT_NE(generate_log_density_source(g), source);
+}
+
+TEST(testglobal, compiled_density_hmc) {
+  /*
+  p1 ~ Normal(0, 1)
+  p2 ~ Normal(p1, 1)
+  p2 observed as 0.5
+  posterior is Normal(0.25, 0.5)
+  */
+  Graph g;
+  uint zero = g.add_constant(0.0);
+  uint one = g.add_constant_pos_real(1.0);
+  uint norm_dist = g.add_distribution(
+      DistributionType::NORMAL, AtomicType::REAL, {zero, one});
+  uint sample = g.add_operator(OperatorType::SAMPLE, {norm_dist});
+  uint norm_norm_dist = g.add_distribution(
+      DistributionType::NORMAL, AtomicType::REAL, {sample, one});
+  uint obs = g.add_operator(OperatorType::SAMPLE, {norm_norm_dist});
+  g.observe(obs, 0.5);
+  g.query(sample);
+  g.query(g.add_operator(OperatorType::EXP, {sample}));
+
+  HMC mh = HMC(g, 1.0, 0.5);
+  mh.set_density_compilation(true);
+  std::vector<std::vector<NodeValue>> samples = mh.infer(5000, 17, 200);
+  double mean = 0;
+  for (int i = 0; i < samples.size(); i++) {
+    mean += samples[i][0]._double;
+    // the deterministic nodes are evaluated for the samples
+    EXPECT_DOUBLE_EQ(samples[i][1]._double, std::exp(samples[i][0]._double));
+  }
+  mean /= samples.size();
+  EXPECT_NEAR(mean, 0.25, 0.03);
+}
+
+TEST(testglobal, compiled_density_unsupported) {
+  Graph g;
+  uint zero = g.add_constant(0.0);
+  uint one = g.add_constant_pos_real(1.0);
+  uint cauchy = g.add_distribution(
+      DistributionType::CAUCHY, AtomicType::REAL, {zero, one});
+  g.query(g.add_operator(OperatorType::SAMPLE, {cauchy}));
+  EXPECT_THROW(generate_log_density_source(g), std::invalid_argument);
+  EXPECT_THROW(CompiledLogDensity("not C++"), std::runtime_error);
+}
@@ -372,3 +372,69 @@ TEST(testglobal, global_state_transform_initialization) {
   state.get_flattened_unconstrained_values(flattened_values);
   EXPECT_NEAR(flattened_values.mean(), std::log(2.0), 0.1);
 }
+
+// x ~ iid Normal(0, 1) of size 3, m = A (A x + 2 A x), y_i ~ Normal(m_i, 1)
+static Graph build_matrix_chain_model(uint& transient_node) {
+  Graph g;
+  uint zero = g.add_constant(0.0);
+  uint one = g.add_constant_pos_real(1.0);
+  uint two = g.add_constant(2.0);
+  uint three = g.add_constant((natural_t)3);
+  Eigen::MatrixXd a(3, 3);
+  a << 1.0, 0.5, -0.2, 0.3, -1.0, 0.4, 0.1, 0.2, 0.8;
+  uint a_node = g.add_constant_real_matrix(a);
+  uint prior = g.add_distribution(
+      DistributionType::NORMAL, AtomicType::REAL, {zero, one});
+  uint x = g.add_operator(OperatorType::IID_SAMPLE, {prior, three});
+  uint ax = g.add_operator(OperatorType::MATRIX_MULTIPLY, {a_node, x});
+  uint two_ax = g.add_operator(OperatorType::MATRIX_SCALE, {two, ax});
+  uint sum = g.add_operator(OperatorType::MATRIX_ADD, {ax, two_ax});
+  uint m = g.add_operator(OperatorType::MATRIX_MULTIPLY, {a_node, sum});
+  std::vector<double> y_values = {1.5, -0.7, 2.2};
+  for (uint i = 0; i < 3; i++) {
+    uint index = g.add_constant((natural_t)i);
+    uint m_i = g.add_operator(OperatorType::INDEX, {m, index});
+    uint likelihood = g.add_distribution(
+        DistributionType::NORMAL, AtomicType::REAL, {m_i, one});
+    uint y = g.add_operator(OperatorType::SAMPLE, {likelihood});
+    g.observe(y, y_values[i]);
+  }
+  g.query(x);
+  transient_node = ax;
+  return g;
+}
+
+TEST(testglobal, global_state_gradient_checkpointing) {
+  uint transient_node;
+  Graph g = build_matrix_chain_model(transient_node);
+  Graph g_checkpointed = build_matrix_chain_model(transient_node);
+  GlobalState state = GlobalState(g);
+  GlobalState checkpointed_state = GlobalState(g_checkpointed);
+  // ax, 2 ax, ax + 2 ax and m are candidates, so only ax + 2 ax is kept
+  checkpointed_state.set_gradient_checkpointing(3);
+
+  for (double shift : {0.0, 0.7, -1.3}) {
+    Eigen::VectorXd values(3);
+    values << 0.2 + shift, -0.4, 1.1 - shift;
+    state.set_flattened_unconstrained_values(values);
+    checkpointed_state.set_flattened_unconstrained_values(values);
+    // update_backgrad reads the current values of deterministic nodes
+    state.update_log_prob();
+    state.update_backgrad();
+    checkpointed_state.update_backgrad();
+    Eigen::VectorXd grads, checkpointed_grads;
+    state.get_flattened_unconstrained_grads(grads);
+    checkpointed_state.get_flattened_unconstrained_grads(checkpointed_grads);
+    for (uint i = 0; i < 3; i++) {
+      EXPECT_NEAR(checkpointed_grads[i], grads[i], 1e-10);
+    }
+    // transient values and gradients are released after the pass
+    Node* node = g_checkpointed.check_node(transient_node, NodeType::OPERATOR);
+    EXPECT_EQ(node->value._matrix.size(), 0);
+    EXPECT_EQ(node->back_grad1.as_matrix().size(), 0);
+
+    checkpointed_state.update_log_prob();
+    EXPECT_NEAR(checkpointed_state.get_log_prob(), state.get_log_prob(), 1e-10);
+    EXPECT_EQ(node->value._matrix.size(), 0);
+  }
+}
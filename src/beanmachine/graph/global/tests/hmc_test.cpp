@@ -8,6 +8,7 @@
 #include <gtest/gtest.h>
 
 #include "beanmachine/graph/global/hmc.h"
+#include "beanmachine/graph/global/proposer/hmc_proposer.h"
 #include "beanmachine/graph/global/tests/conjugate_util_test.h"
 #include "beanmachine/graph/graph.h"
 
@@ -165,3 +166,36 @@ TEST(testglobal, global_hmc_warmup) {
   mean /= samples.size();
   EXPECT_NEAR(mean, 0.875, 0.03);
 }
+
+TEST(testglobal, global_hmc_path_length_adaptation) {
+  /*
+  x[i] ~ Normal(0, i + 1) for i = 0..9
+  a trajectory of about half a period of the widest component,
+  pi / 2 * 10, maximizes ChEES
+  */
+  Graph g;
+  uint zero = g.add_constant(0.0);
+  for (int i = 0; i < 10; i++) {
+    uint scale = g.add_constant_pos_real(1.0 + i);
+    uint dist = g.add_distribution(
+        DistributionType::NORMAL, AtomicType::REAL, {zero, scale});
+    g.query(g.add_operator(OperatorType::SAMPLE, {dist}));
+  }
+
+  uint seed = 7;
+  // a path length that is far too short to start with
+  HMC mh = HMC(g, 0.05, 0.5);
+  mh.set_path_length_adaptation(true);
+  std::vector<std::vector<NodeValue>> samples = mh.infer(2000, seed, 1000);
+  double path_length =
+      static_cast<HmcProposer*>(mh.proposer.get())->get_path_length();
+  EXPECT_GT(path_length, 5.0);
+  EXPECT_LT(path_length, 50.0);
+
+  double variance = 0;
+  for (int i = 0; i < samples.size(); i++) {
+    variance += samples[i][9]._double * samples[i][9]._double;
+  }
+  variance /= samples.size();
+  EXPECT_NEAR(variance, 100.0, 15.0);
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <cmath>
+
+#include <gtest/gtest.h>
+
+#include "beanmachine/graph/global/log_density.h"
+#include "beanmachine/graph/graph.h"
+
+using namespace beanmachine;
+using namespace graph;
+
+TEST(testglobal, log_density_batch) {
+  // mu ~ Normal(0, 10), s ~ Gamma(2, 2), y_i ~ Normal(mu, s)
+  Graph g;
+  uint zero = g.add_constant(0.0);
+  uint ten = g.add_constant_pos_real(10.0);
+  uint two = g.add_constant_pos_real(2.0);
+  uint mu_dist = g.add_distribution(
+      DistributionType::NORMAL, AtomicType::REAL, std::vector<uint>{zero, ten});
+  uint mu = g.add_operator(OperatorType::SAMPLE, std::vector<uint>{mu_dist});
+  uint s_dist = g.add_distribution(
+      DistributionType::GAMMA,
+      AtomicType::POS_REAL,
+      std::vector<uint>{two, two});
+  uint s = g.add_operator(OperatorType::SAMPLE, std::vector<uint>{s_dist});
+  uint y_dist = g.add_distribution(
+      DistributionType::NORMAL, AtomicType::REAL, std::vector<uint>{mu, s});
+  std::vector<double> ys{0.5, -1.2, 2.0};
+  for (double y : ys) {
+    uint y_node =
+        g.add_operator(OperatorType::SAMPLE, std::vector<uint>{y_dist});
+    g.observe(y_node, y);
+  }
+
+  LogDensity density(g, 3);
+  EXPECT_EQ(density.dimension(), 2);
+
+  // s is evaluated in the unconstrained space z = log(s)
+  const int batch_size = 7;
+  Eigen::MatrixXd thetas(batch_size, 2);
+  for (int i = 0; i < batch_size; i++) {
+    thetas(i, 0) = -1.5 + 0.5 * i;
+    thetas(i, 1) = 0.8 - 0.3 * i;
+  }
+  Eigen::VectorXd log_probs;
+  Eigen::MatrixXd grads;
+  density.log_prob_and_grad(thetas, log_probs, grads);
+  ASSERT_EQ(log_probs.size(), batch_size);
+  ASSERT_EQ(grads.rows(), batch_size);
+  ASSERT_EQ(grads.cols(), 2);
+  const double log_sqrt_2pi = 0.5 * std::log(2 * M_PI);
+  for (int i = 0; i < batch_size; i++) {
+    double m = thetas(i, 0);
+    double z = thetas(i, 1);
+    double sigma = std::exp(z);
+    // prior on mu, prior on s with the log |ds/dz| = z jacobian term
+    double expected = -log_sqrt_2pi - std::log(10.0) - m * m / 200 +
+        2 * std::log(2.0) + z - 2 * sigma + z;
+    double expected_grad_m = -m / 100;
+    double expected_grad_z = 2 - 2 * sigma;
+    for (double y : ys) {
+      double r = (y - m) / sigma;
+      expected += -log_sqrt_2pi - z - 0.5 * r * r;
+      expected_grad_m += r / sigma;
+      expected_grad_z += r * r - 1;
+    }
+    EXPECT_NEAR(log_probs[i], expected, 1e-8);
+    EXPECT_NEAR(grads(i, 0), expected_grad_m, 1e-8);
+    EXPECT_NEAR(grads(i, 1), expected_grad_z, 1e-8);
+  }
+
+  // the log density alone agrees, whatever the number of workers
+  LogDensity single(g, 1);
+  Eigen::VectorXd single_log_probs;
+  single.log_prob(thetas, single_log_probs);
+  EXPECT_TRUE(single_log_probs.isApprox(log_probs));
+
+  Eigen::MatrixXd bad_thetas(2, 3);
+  EXPECT_THROW(density.log_prob(bad_thetas, log_probs), std::invalid_argument);
+}
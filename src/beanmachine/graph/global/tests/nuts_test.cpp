@@ -236,3 +236,67 @@ TEST(testglobal, global_nuts_halfnormal) {
   mean /= samples.size();
   EXPECT_NEAR(mean, 1.69, 0.04);
 }
+
+TEST(testglobal, global_nuts_speculative) {
+  /*
+  The model of global_nuts_mixed, with the trees built speculatively
+  p1 ~ Gamma(2, 2) with a customized LOG transform
+  p2 ~ Gamma(1.5, p1) observed as 2
+  posterior is Gamma(3.5, 4), expected mean is 0.875
+
+  p3 ~ Normal(0, 1)
+  p4, p5 ~ Normal(p3, 1) observed as 0.5 and 1.5
+  posterior is Normal(0.66.., 0.5)
+  */
+  Graph g;
+  uint onepointfive = g.add_constant_pos_real(1.5);
+  uint two = g.add_constant_pos_real(2.0);
+  uint gamma_dist = g.add_distribution(
+      DistributionType::GAMMA, AtomicType::POS_REAL, {two, two});
+  uint gamma_sample = g.add_operator(OperatorType::SAMPLE, {gamma_dist});
+  uint gamma_gamma_dist = g.add_distribution(
+      DistributionType::GAMMA,
+      AtomicType::POS_REAL,
+      {onepointfive, gamma_sample});
+  uint gamma_obs = g.add_operator(OperatorType::SAMPLE, {gamma_gamma_dist});
+  g.customize_transformation(TransformType::LOG, {gamma_sample});
+  g.observe(gamma_obs, 2.0);
+  g.query(gamma_sample);
+
+  uint zero = g.add_constant(0.0);
+  uint one = g.add_constant_pos_real(1.0);
+  uint norm_dist = g.add_distribution(
+      DistributionType::NORMAL, AtomicType::REAL, {zero, one});
+  uint sample = g.add_operator(OperatorType::SAMPLE, {norm_dist});
+  uint norm_norm_dist = g.add_distribution(
+      DistributionType::NORMAL, AtomicType::REAL, {sample, one});
+  uint obs1 = g.add_operator(OperatorType::SAMPLE, {norm_norm_dist});
+  uint obs2 = g.add_operator(OperatorType::SAMPLE, {norm_norm_dist});
+  g.observe(obs1, 0.5);
+  g.observe(obs2, 1.5);
+  g.query(sample);
+
+  uint seed = 17;
+  NUTS mh = NUTS(g);
+  mh.set_speculative_tree_building(true);
+  std::vector<std::vector<NodeValue>> samples =
+      mh.infer(2000, seed, 2000, false);
+  EXPECT_EQ(samples.size(), 2000);
+
+  double gamma_mean = 0;
+  double normal_mean = 0;
+  for (int i = 0; i < samples.size(); i++) {
+    gamma_mean += samples[i][0]._double;
+    normal_mean += samples[i][1]._double;
+  }
+  EXPECT_NEAR(gamma_mean / samples.size(), 0.875, 0.03);
+  EXPECT_NEAR(normal_mean / samples.size(), 2.0 / 3, 0.02);
+
+  // the same seed gives the same chain
+  std::vector<std::vector<NodeValue>> again =
+      mh.infer(2000, seed, 2000, false);
+  for (int i = 0; i < samples.size(); i++) {
+    EXPECT_EQ(again[i][0]._double, samples[i][0]._double);
+    EXPECT_EQ(again[i][1]._double, samples[i][1]._double);
+  }
+}
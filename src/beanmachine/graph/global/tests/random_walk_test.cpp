@@ -8,6 +8,7 @@
 #include <gtest/gtest.h>
 #include <random>
 
+#include "beanmachine/graph/global/proposer/random_walk_proposer.h"
 #include "beanmachine/graph/global/random_walk.h"
 #include "beanmachine/graph/graph.h"
 
@@ -119,3 +120,42 @@ TEST(testglobal, rw_gamma_gamm) {
   mean /= samples.size();
   EXPECT_NEAR(mean, 0.75, 0.01);
 }
+
+TEST(testglobal, rw_covariance_adaptation) {
+  /*
+  x[i] ~ Normal(0, 10^(i - 2)) for i = 0..3
+  an isotropic proposal is either rejected or barely moves x[3]
+  */
+  Graph g;
+  uint zero = g.add_constant(0.0);
+  for (int i = 0; i < 4; i++) {
+    uint scale = g.add_constant_pos_real(std::pow(10.0, i - 2));
+    uint dist = g.add_distribution(
+        DistributionType::NORMAL, AtomicType::REAL, {zero, scale});
+    g.query(g.add_operator(OperatorType::SAMPLE, {dist}));
+  }
+
+  uint seed = 17;
+  RandomWalkMH mh = RandomWalkMH(g, 1.0);
+  mh.set_covariance_adaptation(true);
+  std::vector<std::vector<NodeValue>> samples = mh.infer(10000, seed, 2000);
+  EXPECT_EQ(samples.size(), 10000);
+  Eigen::VectorXd scales =
+      static_cast<RandomWalkProposer*>(mh.proposer.get())
+          ->get_proposal_scales();
+  EXPECT_NEAR(std::log10(scales[3] / scales[0]), 3.0, 0.5);
+
+  int num_accepted = 0;
+  double variance = 0;
+  for (int i = 0; i < samples.size(); i++) {
+    if (i > 0 and samples[i][3]._double != samples[i - 1][3]._double) {
+      num_accepted++;
+    }
+    variance += samples[i][3]._double * samples[i][3]._double;
+  }
+  variance /= samples.size();
+  double acceptance_rate = num_accepted / (samples.size() - 1.0);
+  EXPECT_GT(acceptance_rate, 0.15);
+  EXPECT_LT(acceptance_rate, 0.35);
+  EXPECT_NEAR(variance, 100.0, 30.0);
+}
@@ -38,5 +38,19 @@ void set_default_transforms(Graph& g) {
   }
 }
 
+std::unique_ptr<Graph> copy_with_transforms(Graph& g) {
+  auto copy = std::make_unique<Graph>(g);
+  for (uint node_id = 0; node_id < g.nodes.size(); node_id++) {
+    Node* node = g.nodes[node_id].get();
+    if (node->is_stochastic() and node->node_type == NodeType::OPERATOR) {
+      auto sto_node = static_cast<oper::StochasticOperator*>(node);
+      if (sto_node->transform_type != TransformType::NONE) {
+        copy->customize_transformation(sto_node->transform_type, {node_id});
+      }
+    }
+  }
+  return copy;
+}
+
 } // namespace graph
 } // namespace beanmachine
@@ -12,5 +12,12 @@ namespace graph {
 
 void set_default_transforms(Graph& g);
 
+/*
+A copy of a graph with the transformations of its stochastic nodes, which
+the copy constructor of Graph does not copy. Its unconstrained values
+are laid out like the graph's in a GlobalState.
+*/
+std::unique_ptr<Graph> copy_with_transforms(Graph& g);
+
 } // namespace graph
 } // namespace beanmachine
@@ -6,16 +6,26 @@
  */
 
 #include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
 #include <random>
 #include <sstream>
 #include <thread>
 #include <variant>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 #include "beanmachine/graph/distribution/distribution.h"
 #include "beanmachine/graph/factor/factor.h"
 #include "beanmachine/graph/graph.h"
+#include "beanmachine/graph/operator/controlop.h"
 #include "beanmachine/graph/operator/operator.h"
 #include "beanmachine/graph/operator/stochasticop.h"
+#include "beanmachine/graph/sample_store.h"
+#include "beanmachine/graph/thread_pool.h"
 #include "beanmachine/graph/transform/transform.h"
 #include "beanmachine/graph/util.h"
 
@@ -252,6 +262,54 @@ Node::forward_gradient_scalarops<Eigen::Matrix<double, 1, 2>, Eigen::Matrix2d>(
     double& d_grad1,
     double& d_grad2) const;
 
+template <class T1, class T2>
+void Node::forward_gradient_scalarops_lanes(
+    T1& jacobian,
+    T2& hessian,
+    Eigen::ArrayXd& d_grad1,
+    Eigen::ArrayXd& d_grad2) const {
+  uint in_degree = static_cast<uint>(in_nodes.size());
+  assert(jacobian.cols() == in_degree);
+  assert(hessian.cols() == in_degree and hessian.rows() == in_degree);
+
+  // one column per lane
+  auto num_lanes = d_grad1.size();
+  Eigen::MatrixXd Grad1_old(in_degree, num_lanes);
+  Eigen::MatrixXd Grad2_old(in_degree, num_lanes);
+  for (uint i = 0; i < in_degree; i++) {
+    Grad1_old.row(i) = in_nodes[i]->grad1_lanes.matrix().transpose();
+    Grad2_old.row(i) = in_nodes[i]->grad2_lanes.matrix().transpose();
+  }
+  d_grad1 += (jacobian * Grad1_old).transpose().array();
+  d_grad2 += ((hessian * Grad1_old).array() * Grad1_old.array())
+                 .colwise()
+                 .sum()
+                 .transpose();
+  d_grad2 += (jacobian * Grad2_old).transpose().array();
+}
+
+template void Node::forward_gradient_scalarops_lanes<
+    Eigen::Matrix<double, 1, 2>,
+    Eigen::Matrix2d>(
+    Eigen::Matrix<double, 1, 2>& jacobian,
+    Eigen::Matrix2d& hessian,
+    Eigen::ArrayXd& d_grad1,
+    Eigen::ArrayXd& d_grad2) const;
+
+void Node::gradient_log_prob_lanes(
+    Eigen::ArrayXd& /* grad1 */,
+    Eigen::ArrayXd& /* grad2 */) const {
+  throw std::runtime_error(
+      "vector-mode gradients are not supported for node " +
+      std::to_string(index));
+}
+
+void Node::compute_gradient_lanes() {
+  throw std::runtime_error(
+      "vector-mode gradients are not supported for node " +
+      std::to_string(index));
+}
+
 void Node::reset_backgrad() {
   assert(value.type.variable_type != graph::VariableType::UNKNOWN);
   if (value.type.variable_type == graph::VariableType::SCALAR) {
@@ -326,6 +384,136 @@ void Graph::update_backgrad(std::vector<Node*>& ordered_supp) {
   }
 }
 
+// Calls f on each node whose value `node` reads when it is evaluated or
+// differentiated. Distributions have no value of their own, so we look
+// through them (and through the components of a mixture) to their inputs.
+template <typename F>
+static void for_each_value_input(Node* node, F&& f) {
+  for (Node* in_node : node->in_nodes) {
+    if (in_node->node_type == NodeType::DISTRIBUTION) {
+      for_each_value_input(in_node, f);
+    } else {
+      f(in_node);
+    }
+  }
+}
+
+void Graph::compute_checkpoints(uint checkpoint_interval) {
+  ensure_evaluation_and_inference_readiness();
+  if (not fixed_log_prob_is_current) {
+    compute_fixed_log_prob();
+  }
+  uint num_nodes = static_cast<uint>(nodes.size());
+  transient_by_node_id = std::vector<bool>(num_nodes, false);
+  released_by_node_id = std::vector<bool>(num_nodes, false);
+  last_use_by_node_id = std::vector<uint>(num_nodes, 0);
+  backgrad_pass_by_node_id = std::vector<uint>(num_nodes, 0);
+  backgrad_pass = 0;
+  if (checkpoint_interval == 0) {
+    return;
+  }
+  std::vector<bool> keep(num_nodes, false);
+  for (uint node_id : queries) {
+    keep[node_id] = true;
+  }
+  for (Node* node : query_only_nodes) {
+    for_each_value_input(node, [&](Node* in_node) {
+      keep[in_node->index] = true;
+    });
+  }
+  uint num_candidates = 0;
+  for (Node* node : non_fixed_supp) {
+    // the support is in topological order, so the last assignment wins
+    for_each_value_input(node, [&](Node* in_node) {
+      last_use_by_node_id[in_node->index] = node->index;
+    });
+    const ValueType& type = node->value.type;
+    bool is_candidate = not node->is_stochastic() and
+        node->node_type == NodeType::OPERATOR and not keep[node->index] and
+        type.variable_type != VariableType::SCALAR and
+        type.atomic_type != AtomicType::BOOLEAN and
+        type.atomic_type != AtomicType::NATURAL;
+    if (is_candidate) {
+      num_candidates++;
+      transient_by_node_id[node->index] =
+          num_candidates % checkpoint_interval != 0;
+    }
+  }
+}
+
+void Graph::release_dead_inputs(Node* node) {
+  for_each_value_input(node, [&](Node* in_node) {
+    if (transient_by_node_id[in_node->index] and
+        last_use_by_node_id[in_node->index] == node->index) {
+      in_node->value._matrix.setZero(0, 0);
+      released_by_node_id[in_node->index] = true;
+    }
+  });
+}
+
+void Graph::materialize(Node* node, std::mt19937& gen) {
+  if (not released_by_node_id[node->index]) {
+    return;
+  }
+  for_each_value_input(
+      node, [&](Node* in_node) { materialize(in_node, gen); });
+  node->eval(gen);
+  released_by_node_id[node->index] = false;
+}
+
+void Graph::update_backgrad_with_checkpoints() {
+  std::mt19937 generator(12131); // seed is irrelevant for deterministic ops
+  // forward pass: bring the support up to date, leaving only the values of
+  // checkpoints and other kept nodes alive
+  for (Node* node : non_fixed_supp) {
+    if (not node->is_stochastic()) {
+      node->eval(generator);
+      released_by_node_id[node->index] = false;
+    }
+    release_dead_inputs(node);
+  }
+  // backward pass: a node's back_grad1 is reset right before the first
+  // node reading it (which comes after it in topological order) propagates
+  // to it, and a transient value lives from the first time a node reading
+  // it needs it to its own backward step, after which nothing reads it.
+  backgrad_pass++;
+  auto ensure_backgrad = [&](Node* node) {
+    if (node->node_type != NodeType::CONSTANT and
+        backgrad_pass_by_node_id[node->index] != backgrad_pass) {
+      node->reset_backgrad();
+      backgrad_pass_by_node_id[node->index] = backgrad_pass;
+    }
+  };
+  for (auto it = supp.rbegin(); it != supp.rend(); ++it) {
+    Node* node = *it;
+    materialize(node, generator);
+    ensure_backgrad(node);
+    for_each_value_input(node, [&](Node* in_node) {
+      materialize(in_node, generator);
+      ensure_backgrad(in_node);
+    });
+    if (node->is_stochastic() and node->node_type == NodeType::OPERATOR) {
+      auto sto_node = static_cast<oper::StochasticOperator*>(node);
+      // see update_backgrad
+      sto_node->_backward(false);
+      if (sto_node->transform_type != TransformType::NONE) {
+        sto_node->get_original_value(true);
+        sto_node->get_unconstrained_gradient();
+      }
+    } else {
+      node->backward();
+      if (not node->is_stochastic() and
+          node->value.type.variable_type != VariableType::SCALAR) {
+        node->back_grad1.setZero(0, 0);
+      }
+      if (transient_by_node_id[node->index]) {
+        node->value._matrix.setZero(0, 0);
+        released_by_node_id[node->index] = true;
+      }
+    }
+  }
+}
+
 void Graph::eval_and_grad(
     uint tgt_idx,
     uint src_idx,
@@ -464,6 +652,88 @@ void Graph::gradient_log_prob(uint src_idx, double& grad1, double& grad2) {
   }
 }
 
+template <std::size_t N>
+void Graph::gradient_log_prob(
+    const std::array<uint, N>& src_idx,
+    std::array<double, N>& grad1,
+    std::array<double, N>& grad2) {
+  static_assert(N > 0, "gradient_log_prob needs at least one source");
+  auto ordered_support_node_ids = compute_ordered_support_node_ids();
+  // the union of the nodes affected by each source, in topological order
+  std::set<uint> det_node_ids;
+  std::set<uint> sto_node_ids;
+  for (uint src : src_idx) {
+    Node* src_node = check_node(src, NodeType::OPERATOR);
+    if (not src_node->is_stochastic() or
+        src_node->value.type.variable_type != VariableType::SCALAR) {
+      throw std::runtime_error(
+          "gradient_log_prob with several sources only supports scalar "
+          "stochastic nodes");
+    }
+    std::vector<uint> det_nodes;
+    std::vector<uint> sto_nodes;
+    std::tie(det_nodes, sto_nodes) =
+        compute_affected_nodes(src, ordered_support_node_ids);
+    det_node_ids.insert(det_nodes.begin(), det_nodes.end());
+    sto_node_ids.insert(sto_nodes.begin(), sto_nodes.end());
+  }
+  // The lanes of the inputs that no source reaches are zero; those of the
+  // affected deterministic nodes are computed below.
+  auto zero_inputs = [](Node* node) {
+    for_each_value_input(node, [](Node* in_node) {
+      in_node->grad1_lanes.setZero(N);
+      in_node->grad2_lanes.setZero(N);
+    });
+  };
+  for (uint node_id : det_node_ids) {
+    zero_inputs(nodes[node_id].get());
+  }
+  for (uint node_id : sto_node_ids) {
+    Node* node = nodes[node_id].get();
+    zero_inputs(node);
+    node->grad1_lanes.setZero(N);
+    node->grad2_lanes.setZero(N);
+  }
+  for (std::size_t lane = 0; lane < N; lane++) {
+    nodes[src_idx[lane]]->grad1_lanes(lane) = 1;
+  }
+
+  // passing generator for signature,
+  // but it is irrelevant for deterministic nodes.
+  std::mt19937 generator(12131);
+  for (uint node_id : det_node_ids) {
+    Node* node = nodes[node_id].get();
+    node->eval(generator);
+    node->compute_gradient_lanes();
+  }
+  Eigen::ArrayXd log_prob_grad1 = Eigen::ArrayXd::Zero(N);
+  Eigen::ArrayXd log_prob_grad2 = Eigen::ArrayXd::Zero(N);
+  for (uint node_id : sto_node_ids) {
+    nodes[node_id]->gradient_log_prob_lanes(log_prob_grad1, log_prob_grad2);
+  }
+  for (std::size_t lane = 0; lane < N; lane++) {
+    grad1[lane] = log_prob_grad1(lane);
+    grad2[lane] = log_prob_grad2(lane);
+  }
+}
+
+template void Graph::gradient_log_prob<1>(
+    const std::array<uint, 1>&,
+    std::array<double, 1>&,
+    std::array<double, 1>&);
+template void Graph::gradient_log_prob<2>(
+    const std::array<uint, 2>&,
+    std::array<double, 2>&,
+    std::array<double, 2>&);
+template void Graph::gradient_log_prob<4>(
+    const std::array<uint, 4>&,
+    std::array<double, 4>&,
+    std::array<double, 4>&);
+template void Graph::gradient_log_prob<8>(
+    const std::array<uint, 8>&,
+    std::array<double, 8>&,
+    std::array<double, 8>&);
+
 double Graph::log_prob(uint src_idx) {
   // TODO: also used in tests only
   Node* src_node = check_node(src_idx, NodeType::OPERATOR);
@@ -489,10 +759,53 @@ double Graph::log_prob(uint src_idx) {
 }
 
 double Graph::full_log_prob() {
+  return _full_log_prob(false);
+}
+
+double Graph::full_log_prob_with_checkpoints() {
+  return _full_log_prob(true);
+}
+
+double Graph::log_prob_of_evaluated_supp() {
+  return _full_log_prob(false, false);
+}
+
+double Graph::tracked_log_prob() {
+  if (not tracked_log_prob_is_current or
+      ++tracked_log_prob_uses >= TRACKED_LOG_PROB_SYNC_INTERVAL) {
+    tracked_log_prob_value = full_log_prob();
+    tracked_log_prob_is_current = true;
+    tracked_log_prob_uses = 0;
+  }
+  return tracked_log_prob_value;
+}
+
+void Graph::add_to_tracked_log_prob(
+    Node* tgt_node,
+    double sto_affected_log_prob_change) {
+  // the change of the log abs Jacobian determinant of a transformed node is
+  // not part of the change of its stochastic affected nodes
+  if (tgt_node->node_type == NodeType::OPERATOR and
+      static_cast<oper::StochasticOperator*>(tgt_node)->transform_type !=
+          TransformType::NONE) {
+    reset_tracked_log_prob();
+  } else {
+    tracked_log_prob_value += sto_affected_log_prob_change;
+  }
+}
+
+void Graph::reset_tracked_log_prob() {
+  tracked_log_prob_is_current = false;
+}
+
+double Graph::_full_log_prob(bool with_checkpoints, bool evaluate) {
   ensure_evaluation_and_inference_readiness();
-  double sum_log_prob = 0.0;
+  if (not fixed_log_prob_is_current) {
+    compute_fixed_log_prob();
+  }
+  double sum_log_prob = fixed_log_prob;
   std::mt19937 generator(12131); // seed is irrelevant for deterministic ops
-  for (auto node : supp) {
+  for (auto node : non_fixed_supp) {
     if (node->is_stochastic()) {
       sum_log_prob += node->log_prob();
       if (node->node_type == NodeType::OPERATOR) {
@@ -515,9 +828,13 @@ double Graph::full_log_prob() {
           sum_log_prob += sto_node->log_abs_jacobian_determinant();
         }
       }
-    } else {
+    } else if (evaluate) {
       node->eval(generator);
     }
+    if (with_checkpoints) {
+      released_by_node_id[node->index] = false;
+      release_dead_inputs(node);
+    }
   }
   return sum_log_prob;
 }
@@ -857,6 +1174,69 @@ void Graph::add_observe(Node* node, NodeValue value) {
   node->value = value;
   node->is_observed = true;
   observed.insert(node->index);
+  fixed_log_prob_is_current = false;
+}
+
+void Graph::add_data_slot(const std::string& name, uint node_id) {
+  Node* node = get_node(node_id);
+  if (node->node_type != NodeType::CONSTANT and not
+      (node->node_type == NodeType::OPERATOR and node->is_observed)) {
+    throw std::invalid_argument(
+        "data slot " + name + " must be a constant or an observed node");
+  }
+  if (not data_slots.emplace(name, node_id).second) {
+    throw std::invalid_argument("data slot " + name + " already exists");
+  }
+}
+
+void Graph::bind_data_slot(const std::string& name, NodeValue value) {
+  auto slot = data_slots.find(name);
+  if (slot == data_slots.end()) {
+    throw std::invalid_argument("unknown data slot " + name);
+  }
+  Node* node = nodes[slot->second].get();
+  if (node->value.type != value.type) {
+    throw std::invalid_argument(
+        "data slot " + name + " expected " + node->value.type.to_string() +
+        " but got " + value.type.to_string());
+  }
+  node->value = value;
+  // the deterministic nodes computed only from fixed values, and the fixed
+  // log prob, are recomputed on their next use
+  fixed_log_prob_is_current = false;
+}
+
+void Graph::bind_data_slot(
+    const std::string& name,
+    const double* buffer,
+    std::size_t size) {
+  auto slot = data_slots.find(name);
+  if (slot == data_slots.end()) {
+    throw std::invalid_argument("unknown data slot " + name);
+  }
+  NodeValue& value = nodes[slot->second]->value;
+  AtomicType atomic_type = value.type.atomic_type;
+  if (atomic_type != AtomicType::REAL and
+      atomic_type != AtomicType::POS_REAL and
+      atomic_type != AtomicType::NEG_REAL and
+      atomic_type != AtomicType::PROBABILITY) {
+    throw std::invalid_argument(
+        "data slot " + name + " of type " + value.type.to_string() +
+        " cannot be bound to doubles");
+  }
+  bool scalar = value.type.variable_type == VariableType::SCALAR;
+  std::size_t expected = scalar ? 1 : value._matrix.size();
+  if (size != expected) {
+    throw std::invalid_argument(
+        "data slot " + name + " expected " + std::to_string(expected) +
+        " values but got " + std::to_string(size));
+  }
+  if (scalar) {
+    value._double = buffer[0];
+  } else {
+    std::copy(buffer, buffer + size, value._matrix.data());
+  }
+  fixed_log_prob_is_current = false;
 }
 
 void Graph::customize_transformation(
@@ -906,6 +1286,16 @@ void Graph::remove_observations() {
       itr++;
     }
   }
+  // the slots of removed observations no longer name any data
+  for (auto itr = data_slots.begin(); itr != data_slots.end();) {
+    Node* node = nodes[itr->second].get();
+    if (node->node_type == NodeType::OPERATOR and not node->is_observed) {
+      itr = data_slots.erase(itr);
+    } else {
+      itr++;
+    }
+  }
+  fixed_log_prob_is_current = false;
 }
 
 uint Graph::query(uint node_id) {
@@ -933,6 +1323,15 @@ uint Graph::query(uint node_id) {
 }
 
 void Graph::collect_log_prob(double log_prob) {
+  if (SampleStoreWriter* store = active_sample_store()) {
+    uint chain = master_graph == nullptr ? 0 : thread_index;
+    store->append_log_prob(chain, log_prob);
+    return;
+  }
+  if (sample_stream != nullptr) {
+    stream_log_prob(log_prob);
+    return;
+  }
   auto& logprob_collector = (master_graph == nullptr)
       ? this->log_prob_vals
       : master_graph->log_prob_allchains[thread_index];
@@ -950,7 +1349,10 @@ std::vector<std::vector<double>>& Graph::get_log_prob() {
   return log_prob_allchains;
 }
 
-void Graph::collect_sample() {
+void Graph::collect_sample(const std::vector<double>& conditional_means) {
+  if (ready_for_evaluation_and_inference) {
+    eval_query_only_nodes();
+  }
   if (agg_type == AggregationType::NONE) {
     // construct a sample of the queried nodes
     auto& sample_collector = (master_graph == nullptr)
@@ -960,7 +1362,13 @@ void Graph::collect_sample() {
     for (uint node_id : queries) {
       sample.push_back(nodes[node_id]->value);
     }
-    sample_collector.push_back(sample);
+    if (SampleStoreWriter* store = active_sample_store()) {
+      store->append(master_graph == nullptr ? 0 : thread_index, sample);
+    } else if (sample_stream != nullptr) {
+      stream_sample(sample);
+    } else {
+      sample_collector.push_back(sample);
+    }
   }
   // note: we divide each new value by agg_samples rather than directly add
   // them to the total to avoid overflow
@@ -969,31 +1377,96 @@ void Graph::collect_sample() {
         ? this->means
         : master_graph->means_allchains[thread_index];
     assert(mean_collector.size() == queries.size());
+    std::vector<double> query_values;
     uint pos = 0;
     for (uint node_id : queries) {
       NodeValue value = nodes[node_id]->value;
-      if (value.type == AtomicType::BOOLEAN) {
-        mean_collector[pos] += double(value._bool) / agg_samples;
+      double query_value;
+      if (not conditional_means.empty() and
+          not std::isnan(conditional_means[pos])) {
+        query_value = conditional_means[pos];
+      } else if (value.type == AtomicType::BOOLEAN) {
+        query_value = double(value._bool);
       } else if (
           value.type == AtomicType::REAL or
           value.type == AtomicType::POS_REAL or
           value.type == AtomicType::NEG_REAL or
           value.type == AtomicType::PROBABILITY) {
-        mean_collector[pos] += value._double / agg_samples;
+        query_value = value._double;
       } else if (value.type == AtomicType::NATURAL) {
-        mean_collector[pos] += double(value._natural) / agg_samples;
+        query_value = double(value._natural);
       } else {
         throw std::runtime_error(
             "Mean aggregation only supported for "
             "boolean/real/probability/natural-valued nodes");
       }
+      mean_collector[pos] += query_value / agg_samples;
+      if (collect_control_variates) {
+        query_values.push_back(query_value);
+      }
       pos++;
     }
+    if (collect_control_variates) {
+      control_variate_query_values.push_back(std::move(query_values));
+      control_variate_scores.push_back(compute_control_variate_scores());
+    }
   } else {
     assert(false);
   }
 }
 
+std::vector<double> Graph::compute_control_variate_scores() {
+  update_backgrad(supp);
+  std::vector<double> scores;
+  for (Node* node : control_variate_nodes) {
+    double grad = node->back_grad1;
+    if (node->value.type.atomic_type == AtomicType::REAL) {
+      scores.push_back(grad);
+    } else {
+      // score of y = log(x), whose density has the extra factor x
+      scores.push_back(node->value._double * grad + 1);
+    }
+  }
+  return scores;
+}
+
+void Graph::apply_control_variates() {
+  auto& mean_collector = (master_graph == nullptr)
+      ? this->means
+      : master_graph->means_allchains[thread_index];
+  uint n = static_cast<uint>(control_variate_scores.size());
+  uint d = n == 0 ? 0 : static_cast<uint>(control_variate_scores[0].size());
+  // we need more samples than coefficients to fit them
+  if (d == 0 or n <= d + 1) {
+    return;
+  }
+  uint num_queries = static_cast<uint>(queries.size());
+  Eigen::MatrixXd scores(n, d);
+  Eigen::MatrixXd values(n, num_queries);
+  for (uint i = 0; i < n; i++) {
+    scores.row(i) = Eigen::Map<Eigen::RowVectorXd>(
+        control_variate_scores[i].data(), d);
+    values.row(i) = Eigen::Map<Eigen::RowVectorXd>(
+        control_variate_query_values[i].data(), num_queries);
+  }
+  Eigen::RowVectorXd mean_scores = scores.colwise().mean();
+  Eigen::MatrixXd centered_scores = scores.rowwise() - mean_scores;
+  Eigen::MatrixXd centered_values =
+      values.rowwise() - values.colwise().mean();
+  // least squares fit of the query values on the scores
+  Eigen::MatrixXd coefficients =
+      (centered_scores.transpose() * centered_scores)
+          .ldlt()
+          .solve(centered_scores.transpose() * centered_values);
+  if (not coefficients.allFinite()) {
+    return;
+  }
+  Eigen::RowVectorXd corrections = mean_scores * coefficients;
+  for (uint pos = 0; pos < num_queries; pos++) {
+    mean_collector[pos] -= corrections(pos);
+  }
+}
+
 void Graph::_infer(
     uint num_samples,
     InferenceType algorithm,
@@ -1005,6 +1478,36 @@ void Graph::_infer(
   if (num_samples < 1) {
     throw std::runtime_error("num_samples can't be zero");
   }
+  if (infer_config.thinning < 1) {
+    throw std::runtime_error("thinning can't be zero");
+  }
+  collect_control_variates =
+      infer_config.control_variates and agg_type == AggregationType::MEAN;
+  control_variate_query_values.clear();
+  control_variate_scores.clear();
+  control_variate_nodes.clear();
+  if (collect_control_variates) {
+    ensure_evaluation_and_inference_readiness();
+    // only untransformed scalar REAL and POS_REAL latents have scores, and
+    // without any the backward passes of each sample would be wasted
+    for (Node* node : unobserved_sto_supp) {
+      auto sto_node = static_cast<oper::StochasticOperator*>(node);
+      if (sto_node->transform_type == TransformType::NONE and
+          (node->value.type == AtomicType::REAL or
+           node->value.type == AtomicType::POS_REAL)) {
+        control_variate_nodes.push_back(node);
+      }
+    }
+    collect_control_variates = not control_variate_nodes.empty();
+  }
+  // a single chain has the whole budget, while the chains of
+  // _infer_parallel already run under a shared one
+  std::unique_ptr<util::ThreadBudget> budget;
+  if (infer_config.max_threads > 0 and
+      util::ThreadBudget::current() == nullptr) {
+    budget = std::make_unique<util::ThreadBudget>(infer_config.max_threads);
+  }
+  util::ChainScope chain_scope(budget.get());
   if (algorithm == InferenceType::REJECTION) {
     rejection(num_samples, seed, infer_config);
   } else if (algorithm == InferenceType::GIBBS) {
@@ -1012,6 +1515,12 @@ void Graph::_infer(
   } else if (algorithm == InferenceType::NMC) {
     nmc(num_samples, seed, infer_config);
   }
+  if (collect_control_variates) {
+    apply_control_variates();
+    control_variate_query_values.clear();
+    control_variate_scores.clear();
+    control_variate_nodes.clear();
+  }
 }
 
 std::vector<std::vector<NodeValue>>&
@@ -1043,11 +1552,63 @@ std::vector<std::vector<std::vector<NodeValue>>>& Graph::infer(
   log_prob_vals.clear();
   log_prob_allchains.clear();
   log_prob_allchains.resize(n_chains, std::vector<double>());
-  _infer_parallel(num_samples, algorithm, seed, n_chains, infer_config);
+  if (infer_config.sample_store_path.empty()) {
+    _infer_parallel(num_samples, algorithm, seed, n_chains, infer_config);
+  } else {
+    std::vector<ValueType> query_types;
+    for (uint node_id : queries) {
+      query_types.push_back(nodes[node_id]->value.type);
+    }
+    uint num_draws = infer_config.keep_warmup
+        ? infer_config.num_warmup + num_samples
+        : num_samples;
+    SampleStoreWriter store(
+        infer_config.sample_store_path,
+        queries,
+        query_types,
+        n_chains,
+        num_draws,
+        infer_config.keep_log_prob);
+    sample_store = &store;
+    try {
+      _infer_parallel(num_samples, algorithm, seed, n_chains, infer_config);
+    } catch (...) {
+      sample_store = nullptr;
+      throw;
+    }
+    sample_store = nullptr;
+  }
   _produce_performance_report(num_samples, algorithm, seed);
   return samples_allchains;
 }
 
+// Pins the calling thread to the chain-th CPU (modulo their number) among
+// those the process may run on. A no-op on platforms other than Linux.
+static void pin_current_thread(uint chain) {
+#ifdef __linux__
+  cpu_set_t allowed;
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    return;
+  }
+  int num_allowed = CPU_COUNT(&allowed);
+  if (num_allowed == 0) {
+    return;
+  }
+  int target = static_cast<int>(chain % num_allowed);
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &allowed) and target-- == 0) {
+      cpu_set_t pinned;
+      CPU_ZERO(&pinned);
+      CPU_SET(cpu, &pinned);
+      pthread_setaffinity_np(pthread_self(), sizeof(pinned), &pinned);
+      return;
+    }
+  }
+#else
+  (void)chain;
+#endif
+}
+
 void Graph::_infer_parallel(
     uint num_samples,
     InferenceType algorithm,
@@ -1057,35 +1618,83 @@ void Graph::_infer_parallel(
   if (n_chains < 1) {
     throw std::runtime_error("n_chains can't be zero");
   }
+  if (infer_config.use_processes) {
+    // a forked chain would neither share the budget with the other chains
+    // nor safely inherit the worker pool of this process
+    if (infer_config.max_threads > 0) {
+      throw std::runtime_error("max_threads can't be used with use_processes");
+    }
+    _infer_multiprocess(num_samples, algorithm, seed, n_chains, infer_config);
+    return;
+  }
   master_graph = this;
   thread_index = 0;
+  std::unique_ptr<util::ThreadBudget> budget;
+  if (infer_config.max_threads > 0) {
+    budget = std::make_unique<util::ThreadBudget>(infer_config.max_threads);
+  }
   // clone graphs
-  std::vector<Graph*> graph_copies;
+  std::vector<Graph*> graph_copies(n_chains, nullptr);
   std::vector<uint> seedvec;
+  auto copy_graph = [this, &graph_copies](uint i) {
+    Graph* g_ptr = new Graph(*this);
+    g_ptr->thread_index = i;
+    graph_copies[i] = g_ptr;
+  };
+  graph_copies[0] = this;
   for (uint i = 0; i < n_chains; i++) {
-    if (i > 0) {
-      Graph* g_ptr = new Graph(*this);
-      g_ptr->thread_index = i;
-      graph_copies.push_back(g_ptr);
-    } else {
-      graph_copies.push_back(this);
+    if (i > 0 and not infer_config.pin_threads) {
+      copy_graph(i);
     }
     seedvec.push_back(seed + 13 * static_cast<uint>(i));
   }
   assert(graph_copies.size() == n_chains);
   assert(seedvec.size() == n_chains);
+  // With pinned threads each chain copies the graph from its own thread,
+  // and chain 0, which runs on this graph, waits until all copies are made.
+  std::mutex copy_mutex;
+  std::condition_variable copy_cv;
+  uint num_copies = 0;
+  auto copy_in_thread = [&](uint i) {
+    if (i == 0) {
+      std::unique_lock<std::mutex> lock(copy_mutex);
+      copy_cv.wait(lock, [&]() { return num_copies == n_chains - 1; });
+      return;
+    }
+    std::exception_ptr copy_error = nullptr;
+    try {
+      copy_graph(i);
+    } catch (...) {
+      copy_error = std::current_exception();
+    }
+    {
+      std::lock_guard<std::mutex> lock(copy_mutex);
+      num_copies++;
+    }
+    copy_cv.notify_all();
+    if (copy_error != nullptr) {
+      std::rethrow_exception(copy_error);
+    }
+  };
   // start threads
   std::vector<std::thread> threads;
   std::exception_ptr e = nullptr;
   for (uint i = 0; i < n_chains; i++) {
     std::thread infer_thread([&e,
                               &graph_copies,
+                              &copy_in_thread,
                               i,
                               num_samples,
                               algorithm,
                               &seedvec,
+                              &budget,
                               infer_config]() {
       try {
+        util::ChainScope chain_scope(budget.get());
+        if (infer_config.pin_threads) {
+          pin_current_thread(i);
+          copy_in_thread(i);
+        }
         graph_copies[i]->_infer(
             num_samples, algorithm, seedvec[i], infer_config);
       } catch (...) {
@@ -1220,6 +1829,7 @@ Graph::Graph(const Graph& other) {
   for (uint node_id : other.queries) {
     query(node_id);
   }
+  data_slots = other.data_slots;
   master_graph = other.master_graph;
   agg_type = other.agg_type;
   agg_samples = other.agg_samples;
@@ -1230,7 +1840,10 @@ void Graph::ensure_evaluation_and_inference_readiness() {
     pd_begin(ProfilerEvent::NMC_INFER_INITIALIZE);
     collect_node_ptrs();
     compute_support();
+    compute_query_only_nodes();
     compute_affected_nodes();
+    compute_branch_only_nodes();
+    compute_fixed_log_prob();
     old_values = std::vector<NodeValue>(nodes.size());
     pd_finish(ProfilerEvent::NMC_INFER_INITIALIZE);
     ready_for_evaluation_and_inference = true;
@@ -1287,7 +1900,9 @@ void Graph::compute_affected_nodes() {
     std::tie(det_node_ids, sto_node_ids) =
         compute_affected_nodes(node->index, supp_ids);
     for (uint id : det_node_ids) {
-      det_nodes.push_back(node_ptrs[id]);
+      if (not query_only_by_node_id[id]) {
+        det_nodes.push_back(node_ptrs[id]);
+      }
     }
     for (uint id : sto_node_ids) {
       sto_nodes.push_back(node_ptrs[id]);
@@ -1301,6 +1916,149 @@ void Graph::compute_affected_nodes() {
   }
 }
 
+// A deterministic node is query-only if all its children are query-only
+// deterministic nodes, so a single pass in reverse topological order
+// suffices. Children outside the support are irrelevant, except for
+// distributions which are never in the support but lead to stochastic nodes.
+void Graph::compute_query_only_nodes() {
+  query_only_by_node_id = std::vector<bool>(nodes.size(), false);
+  query_only_nodes.clear();
+  for (auto it = supp.rbegin(); it != supp.rend(); ++it) {
+    Node* node = *it;
+    if (node->is_stochastic() or node->node_type != NodeType::OPERATOR) {
+      continue;
+    }
+    query_only_by_node_id[node->index] = std::all_of(
+        node->out_nodes.begin(), node->out_nodes.end(), [&](Node* child) {
+          if (child->node_type == NodeType::DISTRIBUTION or
+              child->is_stochastic()) {
+            return false;
+          }
+          return supp_ids.find(child->index) == supp_ids.end() or
+              query_only_by_node_id[child->index];
+        });
+  }
+  for (Node* node : supp) {
+    if (query_only_by_node_id[node->index]) {
+      query_only_nodes.push_back(node);
+    }
+  }
+}
+
+void Graph::eval_query_only_nodes() {
+  std::mt19937 generator(12131); // seed is irrelevant for deterministic ops
+  for (Node* node : query_only_nodes) {
+    // inputs that are not query-only may have been skipped as branch-only
+    for (Node* in_node : node->in_nodes) {
+      refresh_if_stale(in_node, generator);
+    }
+    node->eval(generator);
+  }
+}
+
+bool is_selection_operator(const Node* node) {
+  if (node->node_type != NodeType::OPERATOR) {
+    return false;
+  }
+  auto op_type = static_cast<const oper::Operator*>(node)->op_type;
+  return op_type == OperatorType::IF_THEN_ELSE or
+      op_type == OperatorType::CHOICE;
+}
+
+// Classifies the deterministic operator nodes in the support as branch-only
+// or not (see Graph::branch_only_by_node_id). Since a node is branch-only
+// exactly when all its children in the support either select among it or
+// are branch-only themselves, a single pass in reverse topological order
+// suffices.
+void Graph::compute_branch_only_nodes() {
+  branch_only_by_node_id = std::vector<bool>(nodes.size(), false);
+  stale_by_node_id = std::vector<bool>(nodes.size(), false);
+  old_stale_by_node_id = std::vector<bool>(nodes.size(), false);
+  eval_pass_by_node_id = std::vector<uint>(nodes.size(), 0);
+  eval_pass = 0;
+  std::set<uint> queried(queries.begin(), queries.end());
+  for (auto it = supp.rbegin(); it != supp.rend(); ++it) {
+    Node* node = *it;
+    if (node->is_stochastic() or node->node_type != NodeType::OPERATOR or
+        queried.find(node->index) != queried.end()) {
+      continue;
+    }
+    bool has_supported_child = false;
+    bool branch_only = true;
+    for (Node* child : node->out_nodes) {
+      if (supp_ids.find(child->index) == supp_ids.end()) {
+        continue;
+      }
+      has_supported_child = true;
+      bool selected_among = is_selection_operator(child) and
+          child->in_nodes[0] != node;
+      if (not selected_among and not branch_only_by_node_id[child->index]) {
+        branch_only = false;
+        break;
+      }
+    }
+    branch_only_by_node_id[node->index] = has_supported_child and branch_only;
+  }
+}
+
+// Classifies nodes as fixed or not (see
+// Graph::fixed_by_node_id) in topological order, evaluating fixed
+// deterministic nodes once so that they are consistent with the
+// observations, and sums the log prob of the stochastic nodes with
+// fixed inputs.
+void Graph::compute_fixed_log_prob() {
+  fixed_by_node_id = std::vector<bool>(nodes.size(), false);
+  non_fixed_supp.clear();
+  fixed_log_prob = 0.0;
+  std::mt19937 generator(12131); // seed is irrelevant for deterministic ops
+  auto all_inputs_fixed = [&](const Node* node) {
+    return std::all_of(
+        node->in_nodes.begin(), node->in_nodes.end(), [&](const Node* in) {
+          return fixed_by_node_id[in->index];
+        });
+  };
+  // Nodes are in topological order. The support only contains operators and
+  // factors, so constants and distributions are classified here as well.
+  for (const auto& node_ptr : nodes) {
+    Node* node = node_ptr.get();
+    bool fixed;
+    if (node->node_type == NodeType::CONSTANT) {
+      fixed_by_node_id[node->index] = true;
+      continue;
+    } else if (node->node_type == NodeType::DISTRIBUTION) {
+      fixed_by_node_id[node->index] = all_inputs_fixed(node);
+      continue;
+    } else if (supp_ids.find(node->index) == supp_ids.end()) {
+      continue;
+    } else if (node->is_stochastic()) {
+      fixed = node->is_observed;
+      if (fixed and all_inputs_fixed(node)) {
+        fixed_log_prob += node->log_prob();
+        if (node->node_type == NodeType::OPERATOR) {
+          auto sto_node = static_cast<oper::StochasticOperator*>(node);
+          if (sto_node->transform_type != TransformType::NONE) {
+            // see full_log_prob
+            fixed_log_prob += sto_node->log_abs_jacobian_determinant();
+          }
+        }
+        fixed_by_node_id[node->index] = true;
+        continue;
+      }
+    } else {
+      fixed = all_inputs_fixed(node);
+      if (fixed) {
+        node->eval(generator);
+      }
+    }
+    fixed_by_node_id[node->index] = fixed;
+    if ((not fixed or node->is_stochastic()) and
+        not query_only_by_node_id[node->index]) {
+      non_fixed_supp.push_back(node);
+    }
+  }
+  fixed_log_prob_is_current = true;
+}
+
 const std::vector<Node*>& Graph::get_det_affected_nodes(Node* node) {
   return det_affected_nodes
       [unobserved_sto_support_index_by_node_id[node->index]];
@@ -1333,6 +2091,7 @@ void Graph::save_old_values(const std::vector<Node*>& nodes) {
   pd_begin(ProfilerEvent::NMC_SAVE_OLD);
   for (Node* node : nodes) {
     old_values[node->index] = node->value;
+    old_stale_by_node_id[node->index] = stale_by_node_id[node->index];
   }
   pd_finish(ProfilerEvent::NMC_SAVE_OLD);
 }
@@ -1349,6 +2108,7 @@ void Graph::restore_old_values(const std::vector<Node*>& det_nodes) {
   pd_begin(ProfilerEvent::NMC_RESTORE_OLD);
   for (Node* node : det_nodes) {
     node->value = old_values[node->index];
+    stale_by_node_id[node->index] = old_stale_by_node_id[node->index];
   }
   pd_finish(ProfilerEvent::NMC_RESTORE_OLD);
 }
@@ -1356,7 +2116,10 @@ void Graph::restore_old_values(const std::vector<Node*>& det_nodes) {
 void Graph::compute_gradients(const std::vector<Node*>& det_nodes) {
   pd_begin(ProfilerEvent::NMC_COMPUTE_GRADS);
   for (Node* node : det_nodes) {
-    node->compute_gradients();
+    // stale nodes are not selected by anyone, so their gradients are unused
+    if (not stale_by_node_id[node->index]) {
+      node->compute_gradients();
+    }
   }
   pd_finish(ProfilerEvent::NMC_COMPUTE_GRADS);
 }
@@ -1365,12 +2128,54 @@ void Graph::eval(const std::vector<Node*>& det_nodes) {
   pd_begin(ProfilerEvent::NMC_EVAL);
   std::mt19937 gen(12131); // seed doesn't matter
   // because operators are deterministic - TODO: clean it
+  eval_pass++;
   for (Node* node : det_nodes) {
+    if (branch_only_by_node_id[node->index]) {
+      stale_by_node_id[node->index] = true;
+      continue;
+    }
+    if (is_selection_operator(node)) {
+      auto selection = static_cast<oper::SelectionOperator*>(node);
+      // Non-branch-only nodes never have a stale condition,
+      // but their selected input may be stale.
+      Node* selected = selection->selected_input();
+      refresh_if_stale(selected, gen);
+      // If neither the condition nor the selected input changed in this
+      // pass, the current value is still the selected input's value.
+      // Stochastic nodes are conservatively assumed to have changed
+      // since the node being proposed is one of them.
+      auto changed = [&](const Node* in_node) {
+        return in_node->is_stochastic() or
+            eval_pass_by_node_id[in_node->index] == eval_pass;
+      };
+      if (not changed(node->in_nodes[0]) and not changed(selected)) {
+        continue;
+      }
+    }
     node->eval(gen);
+    eval_pass_by_node_id[node->index] = eval_pass;
   }
   pd_finish(ProfilerEvent::NMC_EVAL);
 }
 
+void Graph::refresh_if_stale(Node* node, std::mt19937& gen) {
+  if (not stale_by_node_id[node->index]) {
+    return;
+  }
+  stale_by_node_id[node->index] = false;
+  if (is_selection_operator(node)) {
+    refresh_if_stale(node->in_nodes[0], gen);
+    refresh_if_stale(
+        static_cast<oper::SelectionOperator*>(node)->selected_input(), gen);
+  } else {
+    for (Node* in_node : node->in_nodes) {
+      refresh_if_stale(in_node, gen);
+    }
+  }
+  node->eval(gen);
+  eval_pass_by_node_id[node->index] = eval_pass;
+}
+
 void Graph::clear_gradients(Node* node) {
   // TODO: eventually we want to have different classes of Node
   // and have this be a virtual method
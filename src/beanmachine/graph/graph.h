@@ -8,6 +8,7 @@
 #pragma once
 #include <Eigen/Dense>
 #include <algorithm>
+#include <array>
 #include <list>
 #include <map>
 #include <memory>
@@ -363,6 +364,7 @@ enum class DistributionType {
   GEOMETRIC,
   CAUCHY,
   DUMMY,
+  MIXTURE,
 };
 
 enum class FactorType {
@@ -383,12 +385,56 @@ enum class InferenceType { UNKNOWN = 0, REJECTION = 1, GIBBS, NMC };
 
 enum class AggregationType { UNKNOWN = 0, NONE = 1, MEAN };
 
+class SampleStoreWriter;
+class SharedRingBuffer;
+
 struct InferConfig {
   bool keep_log_prob;
   double path_length;
   double step_size;
   uint num_warmup;
   bool keep_warmup;
+  // Only every `thinning`-th sample after warmup is collected, so that
+  // inference runs num_warmup + num_samples * thinning iterations.
+  uint thinning;
+  // If positive, single-site MH steps first screen each proposal with a
+  // surrogate log prob computed on a random subset of this many of the
+  // target's stochastic affected nodes (delayed acceptance). Only proposals
+  // passing the screen pay for the full evaluation, and the second stage
+  // corrects for the surrogate so the chain remains exact. Steps on nodes
+  // with no more affected nodes than this are not screened.
+  uint delayed_acceptance_subset_size;
+  // If true, infer_mean with Gibbs sampling estimates the mean of each
+  // queried latent boolean node from its conditional probability of being
+  // true given the other nodes, rather than from its sampled values.
+  bool rao_blackwellize;
+  // If true, infer_mean corrects the mean of each query with zero-variance
+  // control variates, i.e. the score d/dx log p(x, observations) of the
+  // scalar real and positive real latents, which has zero posterior mean
+  // (Mira, Solgi and Imparato, 2013). Positive reals use the score of
+  // log(x). The coefficients are fit per chain by least squares.
+  bool control_variates;
+  // If true, each chain of a multi-chain run pins its thread to its own CPU
+  // (Linux only) and allocates its graph replica from that thread, so that
+  // first-touch places the chain's memory on the CPU's local NUMA node.
+  bool pin_threads;
+  // If true, each chain runs in its own forked worker process (POSIX only),
+  // which streams its samples back through shared memory. This isolates
+  // chains from each other's crashes and global state, at the cost of a
+  // fork per chain.
+  bool use_processes;
+  // If not empty, infer writes the samples (and log probs, if kept) of all
+  // chains to a columnar sample store at this path as they are collected,
+  // instead of returning them, so that memory use does not grow with the
+  // number of samples. See sample_store.h for the format.
+  std::string sample_store_path;
+  // If positive, the number of threads shared by the chains of a run and
+  // its large MATRIX_MULTIPLY, CHOLESKY and mixture log_prob_iid kernels:
+  // each chain takes one thread, and the kernels of a chain split their
+  // work over the threads that are left (see thread_pool.h). If 0, each
+  // chain runs its kernels in its own thread. Not supported with
+  // use_processes.
+  uint max_threads;
 
   ~InferConfig() {}
   InferConfig(
@@ -396,12 +442,34 @@ struct InferConfig {
       double path_length = 1.0,
       double step_size = 1.0,
       uint num_warmup = 0,
-      bool keep_warmup = false)
+      bool keep_warmup = false,
+      uint thinning = 1)
       : keep_log_prob(keep_log_prob),
         path_length(path_length),
         step_size(step_size),
         num_warmup(num_warmup),
-        keep_warmup(keep_warmup) {}
+        keep_warmup(keep_warmup),
+        thinning(thinning),
+        delayed_acceptance_subset_size(0),
+        rao_blackwellize(false),
+        control_variates(false),
+        pin_threads(false),
+        use_processes(false),
+        sample_store_path(),
+        max_threads(0) {}
+
+  uint num_iterations(uint num_samples) const {
+    return num_warmup + num_samples * thinning;
+  }
+
+  // Whether the sample generated in the given iteration (counting from 0,
+  // warmup included) is collected.
+  bool is_collected(uint iteration) const {
+    if (iteration < num_warmup) {
+      return keep_warmup;
+    }
+    return (iteration - num_warmup + 1) % thinning == 0;
+  }
 };
 
 enum class TransformType { NONE = 0, LOG = 1 };
@@ -472,6 +540,10 @@ class Node {
   double grad2;
   Eigen::MatrixXd Grad1;
   Eigen::MatrixXd Grad2;
+  // The grad1 and grad2 of a scalar node w.r.t. each source of a vector-mode
+  // pass, one lane per source (see Graph::gradient_log_prob<N>).
+  Eigen::ArrayXd grad1_lanes;
+  Eigen::ArrayXd grad2_lanes;
   DoubleMatrix back_grad1;
 
   virtual bool is_stochastic() const {
@@ -495,6 +567,13 @@ class Node {
   virtual void gradient_log_prob(
       Eigen::MatrixXd& /* grad1 */,
       Eigen::MatrixXd& /* grad2_diag */) const {}
+  // Vector-mode counterpart of gradient_log_prob(target_node, ...): adds to
+  // each lane of grad1 and grad2 the gradients w.r.t. the source of that lane,
+  // using the lanes of the inputs. Only scalar stochastic nodes implement it;
+  // the others throw.
+  virtual void gradient_log_prob_lanes(
+      Eigen::ArrayXd& grad1,
+      Eigen::ArrayXd& grad2) const;
   Node() {}
   explicit Node(NodeType node_type)
       : node_type(node_type), grad1(0), grad2(0) {}
@@ -523,6 +602,11 @@ class Node {
   // which should then be used as needed in
   // applications of the chain rule.
   virtual void compute_gradients() {}
+  // Vector-mode counterpart of compute_gradients: computes grad1_lanes and
+  // grad2_lanes from the lanes of the inputs, each lane with respect to its
+  // own variable, in a single pass over the node. Only scalar operators
+  // implement it; the others throw.
+  virtual void compute_gradient_lanes();
 
   /*
   Gradient backward propagation: computes the 1st-order gradient update and
@@ -548,6 +632,14 @@ class Node {
       T2& hessian,
       double& d_grad1,
       double& d_grad2) const;
+  // The counterpart of forward_gradient_scalarops for the lanes of a
+  // vector-mode pass.
+  template <class T1, class T2>
+  void forward_gradient_scalarops_lanes(
+      T1& jacobian,
+      T2& hessian,
+      Eigen::ArrayXd& d_grad1,
+      Eigen::ArrayXd& d_grad2) const;
   // Converts the 1x1 matrix value to a scalar value.
   void to_scalar();
 };
@@ -612,6 +704,34 @@ struct Graph {
   void observe(uint var, Eigen::MatrixXn& val);
   void observe(uint var, NodeValue val);
   /*
+  Name a constant or an observed node as a data slot, so that graphs which
+  only differ in such values can be built and prepared once, and then reused
+  by rebinding the slots with bind_data_slot. Rebinding does not change the
+  topology, the support or the affected node tables of the graph.
+
+  :param name: The name of the slot.
+  :param node_id: A constant or an observed node.
+  */
+  void add_data_slot(const std::string& name, uint node_id);
+  /*
+  Set the value of a data slot. The value must have the type of the node.
+  */
+  void bind_data_slot(const std::string& name, NodeValue value);
+  /*
+  Set the value of a data slot of real, positive real, negative real or
+  probability values from a buffer, in column-major order for matrices.
+
+  :param size: The number of values in the buffer, which must be the number
+               of elements of the slot.
+  */
+  void bind_data_slot(
+      const std::string& name,
+      const double* buffer,
+      std::size_t size);
+  const std::map<std::string, uint>& get_data_slots() const {
+    return data_slots;
+  }
+  /*
   Customize the type of transformation applied to a (set of)
   stochasitc node(s)
   :param transform_type: the type of transformation applied
@@ -808,6 +928,16 @@ struct Graph {
 
   void update_backgrad(std::vector<Node*>& ordered_supp);
   /*
+  Memory-bounded counterparts of full_log_prob and update_backgrad(supp),
+  used by the global samplers once compute_checkpoints has been called.
+  Both evaluate the support in topological order and release the value of
+  each transient node after its last use. The backward pass then recomputes
+  transient values from the nearest checkpoints as it needs them, and
+  releases the back_grad1 of deterministic nodes once propagated.
+  */
+  double full_log_prob_with_checkpoints();
+  void update_backgrad_with_checkpoints();
+  /*
   Evaluate the target node and compute its gradient w.r.t. source_node
   (used for unit tests)
 
@@ -852,6 +982,23 @@ struct Graph {
   */
   void gradient_log_prob(uint src_idx, double& grad1, double& grad2);
   /*
+  Vector-mode counterpart of gradient_log_prob above: computes the first and
+  second gradients of the log prob w.r.t. each of N scalar source nodes in a
+  single forward pass. Each affected deterministic node is evaluated once and
+  propagates the gradients w.r.t. all the sources at once, one lane per
+  source (see Node::compute_gradient_lanes), so sources sharing descendants
+  do not traverse them once each. Instantiated for N = 1, 2, 4 and 8.
+
+  :param src_idx: The indices of the scalar stochastic source nodes.
+  :param grad1: Output first gradient of the log prob w.r.t. each source.
+  :param grad2: Output second gradient of the log prob w.r.t. each source.
+  */
+  template <std::size_t N>
+  void gradient_log_prob(
+      const std::array<uint, N>& src_idx,
+      std::array<double, N>& grad1,
+      std::array<double, N>& grad2);
+  /*
   Evaluate the deterministic descendants of the source node and compute
   the sum of logprob of all stochastic descendants in the support
   including the source node.
@@ -911,8 +1058,30 @@ struct Graph {
       uint seed,
       uint n_chains,
       InferConfig infer_config);
+  // _infer_parallel with InferConfig::use_processes, see infer_multiprocess.cpp
+  void _infer_multiprocess(
+      uint num_samples,
+      InferenceType algorithm,
+      uint seed,
+      uint n_chains,
+      InferConfig infer_config);
+  // If set (in the worker process of a chain), collected samples and log
+  // probs are written to this stream instead of the chain's collectors.
+  SharedRingBuffer* sample_stream = nullptr;
+  void stream_sample(const std::vector<NodeValue>& sample);
+  void stream_log_prob(double log_prob);
+  // If set (on the graph running the first chain), collected samples and log
+  // probs of all chains are written to this store instead of the collectors.
+  SampleStoreWriter* sample_store = nullptr;
+  SampleStoreWriter* active_sample_store() const {
+    return master_graph == nullptr ? sample_store : master_graph->sample_store;
+  }
 
+  // named constants and observations, see add_data_slot
+  std::map<std::string, uint> data_slots;
   uint thread_index;
+  // Whether the first chain displays a progress bar (NMC only).
+  bool show_progress = true;
   std::vector<std::unique_ptr<Node>> nodes; // all nodes in topological order
   std::set<uint> observed; // set of observed nodes
   // we store redundant information in queries and queried. The latter is a
@@ -928,7 +1097,19 @@ struct Graph {
   uint agg_samples;
   std::vector<std::vector<double>> variational_params;
   std::vector<double> elbo_vals;
-  void collect_sample();
+  // conditional_means, if given, has one entry per query and replaces the
+  // value of the queried node in mean aggregation unless it is NaN
+  void collect_sample(
+      const std::vector<double>& conditional_means = std::vector<double>());
+  // query values and control variate scores of each sample collected with
+  // InferConfig::control_variates
+  bool collect_control_variates = false;
+  // the latents with a score: untransformed scalar REAL and POS_REAL ones
+  std::vector<Node*> control_variate_nodes;
+  std::vector<std::vector<double>> control_variate_query_values;
+  std::vector<std::vector<double>> control_variate_scores;
+  std::vector<double> compute_control_variate_scores();
+  void apply_control_variates();
   void rejection(uint num_samples, uint seed, InferConfig infer_config);
   void gibbs(uint num_samples, uint seed, InferConfig infer_config);
   void nmc(uint num_samples, uint seed, InferConfig infer_config);
@@ -948,6 +1129,36 @@ struct Graph {
   // TODO: Review what members of this class can be made static.
 
   void collect_log_prob(double log_prob);
+  /*
+  The log prob of the current values, for InferConfig::keep_log_prob.
+  Inference algorithms that change one node at a time report the change of
+  the log prob of its stochastic affected nodes with
+  add_to_tracked_log_prob, so that the joint is a running sum rather than a
+  full_log_prob per sample. It is recomputed exactly when it was reset, and
+  every TRACKED_LOG_PROB_SYNC_INTERVAL uses, which bounds the rounding
+  drift.
+  */
+  double tracked_log_prob();
+  /*
+  :param tgt_node: The node whose value was changed.
+  :param sto_affected_log_prob_change: The change of the log prob of the
+                                       stochastic affected nodes of tgt_node.
+  */
+  void add_to_tracked_log_prob(
+      Node* tgt_node,
+      double sto_affected_log_prob_change);
+  // Called when values change in a way that is not reported to
+  // add_to_tracked_log_prob.
+  void reset_tracked_log_prob();
+  static constexpr uint TRACKED_LOG_PROB_SYNC_INTERVAL = 1000;
+  double tracked_log_prob_value = 0;
+  bool tracked_log_prob_is_current = false;
+  uint tracked_log_prob_uses = 0;
+  /*
+  The log prob of the support when all its nodes have just been evaluated,
+  i.e. full_log_prob without evaluating the deterministic nodes.
+  */
+  double log_prob_of_evaluated_supp();
   std::vector<double> log_prob_vals;
   std::vector<std::vector<double>> log_prob_allchains;
   std::map<TransformType, std::unique_ptr<Transformation>>
@@ -1025,6 +1236,66 @@ struct Graph {
   std::vector<std::vector<Node*>> sto_affected_nodes;
   std::vector<std::vector<Node*>> det_affected_nodes;
 
+  // Deterministic nodes in the support that no stochastic node depends on,
+  // i.e. that are only needed to compute queries. They are left out of
+  // `det_affected_nodes` and of `full_log_prob`'s evaluation and are
+  // evaluated, in topological order, only when a sample is collected.
+  std::vector<Node*> query_only_nodes;
+  std::vector<bool> query_only_by_node_id;
+
+  // A deterministic node is branch-only if it is not queried and every path
+  // from it to a stochastic node or a query goes through a non-condition
+  // input of a selection operator (IF_THEN_ELSE or CHOICE).
+  // The value of such a node is only needed when a selection operator
+  // actually selects it, so `eval` skips it and marks it as stale instead.
+  // A selection operator brings its selected input up to date on demand
+  // (see `refresh_if_stale`).
+  // Stale flags are saved and restored along with node values so that
+  // reverting a proposal also reverts them.
+  // All vectors are indexed by node id.
+  std::vector<bool> branch_only_by_node_id;
+  std::vector<bool> stale_by_node_id;
+  std::vector<bool> old_stale_by_node_id;
+
+  // The number of the `eval` pass in which each node was last evaluated.
+  // A selection operator whose condition and selected input have not been
+  // re-evaluated in the current pass keeps its value instead of copying it
+  // again from the selected input.
+  std::vector<uint> eval_pass_by_node_id;
+  uint eval_pass = 0;
+
+  // A node is fixed if its value cannot change during inference: constants,
+  // observations, and the deterministic nodes and distributions computed
+  // only from other fixed nodes. An observation whose inputs are all fixed
+  // has a constant log prob; these are summed once into `fixed_log_prob` and
+  // `full_log_prob` only visits `non_fixed_supp`, the remaining nodes of the
+  // support in topological order. Factors are always in `non_fixed_supp`,
+  // even if their inputs are fixed.
+  // Such nodes never appear in `sto_affected_nodes` since they do not depend
+  // on any unobserved node.
+  // Changing observations invalidates these (see `fixed_log_prob_is_current`).
+  std::vector<bool> fixed_by_node_id;
+  std::vector<Node*> non_fixed_supp;
+  double fixed_log_prob = 0;
+  bool fixed_log_prob_is_current = false;
+
+  // Gradient checkpointing (see `update_backgrad_with_checkpoints`).
+  // Candidates are the non-fixed deterministic nodes of the support with
+  // double matrix values, except queried nodes and inputs of query-only
+  // nodes, which must keep their values for `collect_sample`. Every
+  // `checkpoint_interval`-th candidate is a checkpoint and the others are
+  // transient: their values are released after their last use and
+  // recomputed on demand.
+  // All vectors are indexed by node id.
+  std::vector<bool> transient_by_node_id;
+  std::vector<bool> released_by_node_id;
+  // index of the last node of the support reading the value of each node
+  std::vector<uint> last_use_by_node_id;
+  // The number of the backward pass in which the back_grad1 of each node
+  // was last reset, so that it is only allocated when first needed.
+  std::vector<uint> backgrad_pass_by_node_id;
+  uint backgrad_pass = 0;
+
   bool ready_for_evaluation_and_inference = false;
 
   // Methods
@@ -1046,8 +1317,28 @@ struct Graph {
 
   void compute_initial_values();
 
+  void compute_query_only_nodes();
+
   void compute_affected_nodes();
 
+  void compute_branch_only_nodes();
+
+  void compute_fixed_log_prob();
+
+  // Selects checkpoints and transient nodes for the memory-bounded passes.
+  // A checkpoint_interval of 0 makes no node transient.
+  void compute_checkpoints(uint checkpoint_interval);
+
+  // Without evaluate, the deterministic nodes keep their current values.
+  double _full_log_prob(bool with_checkpoints, bool evaluate = true);
+
+  // Releases the transient values that `node` was the last to read.
+  void release_dead_inputs(Node* node);
+
+  // Recomputes the value of a released node, and first of its released
+  // inputs.
+  void materialize(Node* node, std::mt19937& gen);
+
   void generate_sample();
 
   void collect_samples(uint num_samples, InferConfig infer_config);
@@ -1085,8 +1376,18 @@ struct Graph {
 
   void compute_gradients(const std::vector<Node*>& det_nodes);
 
+  // Evaluates the given deterministic nodes in order, skipping
+  // branch-only nodes (see branch_only_by_node_id).
   void eval(const std::vector<Node*>& det_nodes);
 
+  // Evaluates a node that has been skipped by `eval`,
+  // first bringing its own (needed) inputs up to date.
+  void refresh_if_stale(Node* node, std::mt19937& gen);
+
+  // Brings `query_only_nodes` up to date with the current values of the
+  // nodes they depend on.
+  void eval_query_only_nodes();
+
   void clear_gradients(Node* node);
 
   void clear_gradients(const std::vector<Node*>& nodes);
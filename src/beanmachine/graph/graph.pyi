@@ -3,7 +3,7 @@
 # This source code is licensed under the MIT license found in the
 # LICENSE file in the root directory of this source tree.
 
-from typing import ClassVar, List, overload
+from typing import ClassVar, Dict, List, Tuple, overload
 
 import numpy
 
@@ -45,6 +45,7 @@ class DistributionType:
     GAMMA: ClassVar[DistributionType] = ...
     HALF_CAUCHY: ClassVar[DistributionType] = ...
     HALF_NORMAL: ClassVar[DistributionType] = ...
+    MIXTURE: ClassVar[DistributionType] = ...
     NORMAL: ClassVar[DistributionType] = ...
     STUDENT_T: ClassVar[DistributionType] = ...
     TABULAR: ClassVar[DistributionType] = ...
@@ -115,6 +116,7 @@ class Graph:
     def add_constant_real_matrix(
         self, value: numpy.ndarray[numpy.float64[m, n]]
     ) -> int: ...
+    def add_data_slot(self, name: str, node_id: int) -> None: ...
     @overload
     def add_distribution(
         self, dist_type: DistributionType, sample_type: AtomicType, parents: List[int]
@@ -125,10 +127,17 @@ class Graph:
     ) -> int: ...
     def add_factor(self, fac_type: FactorType, parents: List[int]) -> int: ...
     def add_operator(self, op: OperatorType, parents: List[int]) -> int: ...
+    @overload
+    def bind_data_slot(self, name: str, values: numpy.ndarray) -> None: ...
+    @overload
+    def bind_data_slot(self, name: str, value: NodeValue) -> None: ...
     def collect_performance_data(self, b: bool) -> None: ...
     def customize_transformation(
         self, transform_type: TransformType, node_ids: List[int]
     ) -> None: ...
+    @staticmethod
+    def deserialize(text: str) -> Graph: ...
+    def get_data_slots(self) -> Dict[str, int]: ...
     def get_elbo(self) -> List[float]: ...
     def get_log_prob(self) -> List[List[float]]: ...
     @overload
@@ -144,6 +153,16 @@ class Graph:
         n_chains: int = ...,
         infer_config: InferConfig = ...,
     ) -> List[List[List[NodeValue]]]: ...
+    @staticmethod
+    def infer_batch(
+        graphs: List[Graph],
+        num_samples: int,
+        algorithm: InferenceType = ...,
+        seed: int = ...,
+        n_chains: int = ...,
+        infer_config: InferConfig = ...,
+        num_threads: int = ...,
+    ) -> List[List[List[List[NodeValue]]]]: ...
     @overload
     def infer_mean(
         self, num_samples: int, algorithm: InferenceType = ..., seed: int = ...
@@ -176,6 +195,7 @@ class Graph:
     def performance_report(self) -> str: ...
     def query(self, node_id: int) -> int: ...
     def remove_observations(self) -> None: ...
+    def serialize(self) -> str: ...
     def to_dot(self) -> str: ...
     def to_string(self) -> str: ...
     def variational(
@@ -196,19 +216,40 @@ class HMC:
         save_warmup: bool = ...,
         init_type: InitType = ...,
     ) -> List[List[NodeValue]]: ...
+    def set_gradient_checkpointing(self, checkpoint_interval: int) -> None: ...
+    def set_density_compilation(self, enabled: bool) -> None: ...
+    def set_path_length_adaptation(self, enabled: bool) -> None: ...
 
 class InferConfig:
+    control_variates: bool
+    delayed_acceptance_subset_size: int
     keep_log_prob: bool
     keep_warmup: bool
+    max_threads: int
     num_warmup: int
     path_length: float
+    pin_threads: bool
+    rao_blackwellize: bool
+    sample_store_path: str
     step_size: float
+    thinning: int
+    use_processes: bool
     @overload
     def __init__(self) -> None: ...
     @overload
     def __init__(
         self, arg0: bool, arg1: float, arg2: float, arg3: int, arg4: bool
     ) -> None: ...
+    @overload
+    def __init__(
+        self,
+        arg0: bool,
+        arg1: float,
+        arg2: float,
+        arg3: int,
+        arg4: bool,
+        arg5: int,
+    ) -> None: ...
 
 class InferenceType:
     __doc__: ClassVar[str] = ...  # read-only
@@ -250,6 +291,18 @@ class InitType:
     @property
     def value(self) -> int: ...
 
+class LogDensity:
+    def __init__(self, graph: Graph, num_threads: int = ...) -> None: ...
+    def dimension(self) -> int: ...
+    def log_prob(
+        self, thetas: numpy.ndarray[numpy.float64[m, n]]
+    ) -> numpy.ndarray[numpy.float64[m, 1]]: ...
+    def log_prob_and_grad(
+        self, thetas: numpy.ndarray[numpy.float64[m, n]]
+    ) -> Tuple[
+        numpy.ndarray[numpy.float64[m, 1]], numpy.ndarray[numpy.float64[m, n]]
+    ]: ...
+
 class NUTS:
     def __init__(self, arg0: Graph) -> None: ...
     def infer(
@@ -260,6 +313,9 @@ class NUTS:
         save_warmup: bool = ...,
         init_type: InitType = ...,
     ) -> List[List[NodeValue]]: ...
+    def set_gradient_checkpointing(self, checkpoint_interval: int) -> None: ...
+    def set_density_compilation(self, enabled: bool) -> None: ...
+    def set_speculative_tree_building(self, enabled: bool) -> None: ...
 
 class Node:
     def __init__(self, *args, **kwargs) -> None: ...
@@ -0,0 +1,324 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "beanmachine/graph/graph.h"
+#include "beanmachine/graph/shared_ring_buffer.h"
+
+namespace beanmachine {
+namespace graph {
+
+// Each chain streams records made of a one byte tag, the size of the
+// payload as a uint64 and the payload. Samples hold the values of the
+// queried nodes in order, scalars as their raw bytes and matrices as their
+// uint32 row and column counts followed by their raw data; the parent knows
+// the type of each query from its own graph.
+namespace {
+
+const char RECORD_SAMPLE = 'S';
+const char RECORD_LOG_PROB = 'L';
+const char RECORD_MEANS = 'M';
+const char RECORD_ERROR = 'E';
+const char RECORD_DONE = 'D';
+const std::size_t RECORD_HEADER_SIZE = 1 + sizeof(std::uint64_t);
+const std::size_t STREAM_CAPACITY = 1 << 20;
+
+void append_bytes(
+    std::vector<char>& buffer,
+    const void* bytes,
+    std::size_t size) {
+  const char* begin = static_cast<const char*>(bytes);
+  buffer.insert(buffer.end(), begin, begin + size);
+}
+
+template <typename T>
+void append(std::vector<char>& buffer, const T& value) {
+  append_bytes(buffer, &value, sizeof(T));
+}
+
+template <typename T>
+T consume(const char*& cursor) {
+  T value;
+  std::memcpy(&value, cursor, sizeof(T));
+  cursor += sizeof(T);
+  return value;
+}
+
+void write_record(
+    SharedRingBuffer& stream,
+    char tag,
+    const std::vector<char>& payload) {
+  std::vector<char> record;
+  record.reserve(RECORD_HEADER_SIZE + payload.size());
+  record.push_back(tag);
+  append(record, static_cast<std::uint64_t>(payload.size()));
+  record.insert(record.end(), payload.begin(), payload.end());
+  stream.write(record.data(), record.size());
+}
+
+void write_error(SharedRingBuffer& stream, const std::string& message) {
+  write_record(
+      stream, RECORD_ERROR, std::vector<char>(message.begin(), message.end()));
+}
+
+template <typename Matrix>
+void append_matrix(std::vector<char>& buffer, const Matrix& matrix) {
+  append(buffer, static_cast<std::uint32_t>(matrix.rows()));
+  append(buffer, static_cast<std::uint32_t>(matrix.cols()));
+  append_bytes(
+      buffer, matrix.data(), matrix.size() * sizeof(typename Matrix::Scalar));
+}
+
+template <typename Matrix>
+void consume_matrix(const char*& cursor, Matrix& matrix) {
+  auto rows = consume<std::uint32_t>(cursor);
+  auto cols = consume<std::uint32_t>(cursor);
+  matrix.resize(rows, cols);
+  std::size_t size = matrix.size() * sizeof(typename Matrix::Scalar);
+  std::memcpy(matrix.data(), cursor, size);
+  cursor += size;
+}
+
+void append_value(std::vector<char>& buffer, const NodeValue& value) {
+  bool is_scalar = value.type.variable_type == VariableType::SCALAR;
+  switch (value.type.atomic_type) {
+    case AtomicType::BOOLEAN:
+      if (is_scalar) {
+        append(buffer, value._bool);
+      } else {
+        append_matrix(buffer, value._bmatrix);
+      }
+      break;
+    case AtomicType::NATURAL:
+      if (is_scalar) {
+        append(buffer, value._natural);
+      } else {
+        append_matrix(buffer, value._nmatrix);
+      }
+      break;
+    default:
+      if (is_scalar) {
+        append(buffer, value._double);
+      } else {
+        append_matrix(buffer, value._matrix);
+      }
+      break;
+  }
+}
+
+NodeValue consume_value(const char*& cursor, const ValueType& type) {
+  NodeValue value;
+  value.type = type;
+  bool is_scalar = type.variable_type == VariableType::SCALAR;
+  switch (type.atomic_type) {
+    case AtomicType::BOOLEAN:
+      if (is_scalar) {
+        value._bool = consume<bool>(cursor);
+      } else {
+        consume_matrix(cursor, value._bmatrix);
+      }
+      break;
+    case AtomicType::NATURAL:
+      if (is_scalar) {
+        value._natural = consume<natural_t>(cursor);
+      } else {
+        consume_matrix(cursor, value._nmatrix);
+      }
+      break;
+    default:
+      if (is_scalar) {
+        value._double = consume<double>(cursor);
+      } else {
+        consume_matrix(cursor, value._matrix);
+      }
+      break;
+  }
+  return value;
+}
+
+} // namespace
+
+void Graph::stream_sample(const std::vector<NodeValue>& sample) {
+  std::vector<char> payload;
+  for (const NodeValue& value : sample) {
+    append_value(payload, value);
+  }
+  write_record(*sample_stream, RECORD_SAMPLE, payload);
+}
+
+void Graph::stream_log_prob(double log_prob) {
+  std::vector<char> payload;
+  append(payload, log_prob);
+  write_record(*sample_stream, RECORD_LOG_PROB, payload);
+}
+
+void Graph::_infer_multiprocess(
+    uint num_samples,
+    InferenceType algorithm,
+    uint seed,
+    uint n_chains,
+    InferConfig infer_config) {
+#ifdef _WIN32
+  throw std::runtime_error(
+      "multi-process inference is not supported on this platform");
+#else
+  master_graph = this;
+  thread_index = 0;
+  std::vector<std::unique_ptr<SharedRingBuffer>> streams;
+  for (uint i = 0; i < n_chains; i++) {
+    streams.push_back(std::make_unique<SharedRingBuffer>(STREAM_CAPACITY));
+  }
+  std::string error;
+  std::vector<pid_t> pids(n_chains, -1);
+  for (uint i = 0; i < n_chains; i++) {
+    pid_t pid = fork();
+    if (pid < 0) {
+      error = "failed to fork a worker process for chain " + std::to_string(i);
+      break;
+    }
+    if (pid > 0) {
+      pids[i] = pid;
+      continue;
+    }
+    // worker process: like _infer_parallel, chain 0 runs on (the worker's
+    // copy of) this graph and the other chains on copies of it. The process
+    // exits without unwinding, so the copies are not freed.
+    int status = 0;
+    SharedRingBuffer& stream = *streams[i];
+    try {
+      Graph* chain_graph = this;
+      if (i > 0) {
+        chain_graph = new Graph(*this);
+        chain_graph->thread_index = i;
+      }
+      chain_graph->sample_stream = &stream;
+      chain_graph->_infer(
+          num_samples, algorithm, seed + 13 * i, infer_config);
+      if (agg_type == AggregationType::MEAN) {
+        std::vector<char> payload;
+        for (double mean : means_allchains[i]) {
+          append(payload, mean);
+        }
+        write_record(stream, RECORD_MEANS, payload);
+      }
+      write_record(stream, RECORD_DONE, std::vector<char>());
+    } catch (const std::exception& ex) {
+      write_error(stream, ex.what());
+      status = 1;
+    } catch (...) {
+      write_error(stream, "unknown error in chain " + std::to_string(i));
+      status = 1;
+    }
+    _exit(status);
+  }
+
+  // Decodes the complete records received from chain i.
+  // :returns: true if the chain has finished, successfully or not.
+  auto consume_records = [&](uint i, std::vector<char>& pending) {
+    bool finished = false;
+    std::size_t offset = 0;
+    while (pending.size() - offset >= RECORD_HEADER_SIZE) {
+      const char* cursor = pending.data() + offset;
+      char tag = consume<char>(cursor);
+      auto size = static_cast<std::size_t>(consume<std::uint64_t>(cursor));
+      if (pending.size() - offset < RECORD_HEADER_SIZE + size) {
+        break;
+      }
+      offset += RECORD_HEADER_SIZE + size;
+      if (tag == RECORD_SAMPLE) {
+        std::vector<NodeValue> sample;
+        for (uint node_id : queries) {
+          sample.push_back(consume_value(cursor, nodes[node_id]->value.type));
+        }
+        samples_allchains[i].push_back(std::move(sample));
+      } else if (tag == RECORD_LOG_PROB) {
+        log_prob_allchains[i].push_back(consume<double>(cursor));
+      } else if (tag == RECORD_MEANS) {
+        for (double& mean : means_allchains[i]) {
+          mean = consume<double>(cursor);
+        }
+      } else if (tag == RECORD_ERROR) {
+        if (error.empty()) {
+          error = std::string(cursor, size);
+        }
+        finished = true;
+      } else if (tag == RECORD_DONE) {
+        finished = true;
+      }
+    }
+    pending.erase(pending.begin(), pending.begin() + offset);
+    return finished;
+  };
+
+  std::vector<std::vector<char>> pending(n_chains);
+  std::vector<bool> finished(n_chains, false);
+  std::vector<bool> reaped(n_chains, false);
+  uint num_finished = 0;
+  for (uint i = 0; i < n_chains; i++) {
+    if (pids[i] < 0) {
+      finished[i] = true;
+      num_finished++;
+    }
+  }
+  while (num_finished < n_chains) {
+    bool progressed = false;
+    for (uint i = 0; i < n_chains; i++) {
+      if (finished[i]) {
+        continue;
+      }
+      bool exited = false;
+      if (streams[i]->read(pending[i]) > 0) {
+        progressed = true;
+      } else {
+        // the worker may have exited after its last write
+        int status;
+        if (waitpid(pids[i], &status, WNOHANG) == pids[i]) {
+          reaped[i] = true;
+          exited = true;
+          streams[i]->read(pending[i]);
+        }
+      }
+      bool done = consume_records(i, pending[i]);
+      if (done or exited) {
+        if (not done and error.empty()) {
+          error = "the worker process of chain " + std::to_string(i) +
+              " exited before finishing";
+        }
+        finished[i] = true;
+        num_finished++;
+      }
+    }
+    if (not progressed) {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  }
+  for (uint i = 0; i < n_chains; i++) {
+    if (pids[i] > 0 and not reaped[i]) {
+      int status;
+      waitpid(pids[i], &status, 0);
+    }
+  }
+  master_graph = nullptr;
+  if (not error.empty()) {
+    throw std::runtime_error(error);
+  }
+#endif
+}
+
+} // namespace graph
+} // namespace beanmachine
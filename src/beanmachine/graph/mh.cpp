@@ -28,6 +28,7 @@ MH::MH(Graph* graph, uint seed, Stepper* stepper)
 
 void MH::infer(uint num_samples, InferConfig infer_config) {
   graph->pd_begin(ProfilerEvent::NMC_INFER);
+  this->infer_config = infer_config;
   initialize();
   collect_samples(num_samples, infer_config);
   graph->pd_finish(ProfilerEvent::NMC_INFER);
@@ -40,6 +41,7 @@ void MH::initialize() {
   graph->ensure_evaluation_and_inference_readiness();
   ensure_all_nodes_are_supported();
   compute_initial_values();
+  graph->reset_tracked_log_prob();
 }
 
 void MH::ensure_all_nodes_are_supported() {
@@ -76,11 +78,13 @@ void MH::collect_samples(uint num_samples, InferConfig infer_config) {
   graph->pd_begin(ProfilerEvent::NMC_INFER_COLLECT_SAMPLES);
   boost::iostreams::stream<boost::iostreams::null_sink> nullOstream(
       (boost::iostreams::null_sink()));
+  bool displayed = graph->thread_index == 0 and graph->show_progress;
   boost::progress_display show_progress(
-      num_samples, graph->thread_index == 0 ? std::cout : nullOstream);
-  for (uint snum = 0; snum < num_samples + infer_config.num_warmup; snum++) {
+      num_samples, displayed ? std::cout : nullOstream);
+  for (uint snum = 0; snum < infer_config.num_iterations(num_samples);
+       snum++) {
     generate_sample();
-    if (infer_config.keep_warmup or snum >= infer_config.num_warmup) {
+    if (infer_config.is_collected(snum)) {
       collect_sample(infer_config);
       if (graph->thread_index == 0) {
         ++show_progress;
@@ -93,7 +97,7 @@ void MH::collect_samples(uint num_samples, InferConfig infer_config) {
 void MH::collect_sample(InferConfig infer_config) {
   graph->pd_begin(ProfilerEvent::NMC_INFER_COLLECT_SAMPLE);
   if (infer_config.keep_log_prob) {
-    graph->collect_log_prob(graph->full_log_prob());
+    graph->collect_log_prob(graph->tracked_log_prob());
   }
   graph->collect_sample();
   graph->pd_finish(ProfilerEvent::NMC_INFER_COLLECT_SAMPLE);
@@ -50,6 +50,9 @@ class MH {
 
   std::mt19937 gen;
 
+  // The configuration of the current call to `infer`.
+  InferConfig infer_config;
+
   // Constructs MH algorithm based on stepper.
   // Takes ownership of stepper instance.
   MH(Graph* graph, unsigned int seed, Stepper* stepper);
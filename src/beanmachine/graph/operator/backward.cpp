@@ -13,6 +13,7 @@
 #include "beanmachine/graph/operator/linalgop.h"
 #include "beanmachine/graph/operator/multiaryop.h"
 #include "beanmachine/graph/operator/unaryop.h"
+#include "beanmachine/graph/thread_pool.h"
 #include "beanmachine/graph/util.h"
 
 namespace beanmachine {
@@ -171,19 +172,10 @@ void LogSumExpVector::backward() {
   }
 }
 
-void IfThenElse::backward() {
-  assert(in_nodes.size() == 3);
-  int choice = in_nodes[0]->value._bool ? 1 : 2;
-  if (in_nodes[choice]->needs_gradient()) {
-    in_nodes[choice]->back_grad1 += back_grad1;
-  }
-}
-
-void Choice::backward() {
-  graph::natural_t choice = in_nodes[0]->value._natural + 1;
-  assert(in_nodes.size() < choice);
-  if (in_nodes[choice]->needs_gradient()) {
-    in_nodes[choice]->back_grad1 += back_grad1;
+void SelectionOperator::backward() {
+  graph::Node* selected = selected_input();
+  if (selected->needs_gradient()) {
+    selected->back_grad1 += back_grad1;
   }
 }
 
@@ -199,6 +191,20 @@ void MatrixMultiply::backward() {
   Eigen::MatrixXd& A = node_a->value._matrix;
   Eigen::MatrixXd& B = node_b->value._matrix;
 
+  double flops = 2.0 * A.rows() * A.cols() * B.cols();
+  if (util::use_parallel_kernel(flops) and
+      std::holds_alternative<Eigen::MatrixXd>(back_grad1)) {
+    Eigen::MatrixXd product;
+    if (node_a->needs_gradient()) {
+      matrix_product(back_grad1.as_matrix(), B.transpose(), product);
+      node_a->back_grad1 += product;
+    }
+    if (node_b->needs_gradient()) {
+      matrix_product(A.transpose(), back_grad1.as_matrix(), product);
+      node_b->back_grad1 += product;
+    }
+    return;
+  }
   if (node_a->needs_gradient()) {
     node_a->back_grad1 += graph::DoubleMatrix::times(back_grad1, B.transpose());
   }
@@ -223,11 +229,13 @@ void MatrixScale::backward() {
   Eigen::MatrixXd& B = node_b->value._matrix;
   // if C = A @ B is reduced to a scalar
   if (node_a->needs_gradient()) {
-    node_a->back_grad1 +=
-        graph::DoubleMatrix::times(back_grad1, B.transpose()).as_matrix().sum();
+    node_a->back_grad1 += graph::DoubleMatrix::times(back_grad1, B.transpose())
+                              .eval()
+                              .as_matrix()
+                              .sum();
   }
   if (node_b->needs_gradient()) {
-    node_b->back_grad1 += A * back_grad1;
+    node_b->back_grad1 += A * back_grad1.as_matrix();
   }
 }
 
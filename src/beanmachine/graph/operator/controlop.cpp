@@ -10,8 +10,12 @@
 namespace beanmachine {
 namespace oper {
 
+void SelectionOperator::eval(std::mt19937& /* gen */) {
+  value = selected_input()->value;
+}
+
 IfThenElse::IfThenElse(const std::vector<graph::Node*>& in_nodes)
-    : Operator(graph::OperatorType::IF_THEN_ELSE) {
+    : SelectionOperator(graph::OperatorType::IF_THEN_ELSE) {
   if (in_nodes.size() != 3) {
     throw std::invalid_argument(
         "operator IF_THEN_ELSE requires exactly three parents");
@@ -28,17 +32,13 @@ IfThenElse::IfThenElse(const std::vector<graph::Node*>& in_nodes)
   value = in_nodes[1]->value;
 }
 
-void IfThenElse::eval(std::mt19937& /* gen */) {
+uint IfThenElse::selected_input_index() const {
   assert(in_nodes.size() == 3);
-  if (in_nodes[0]->value._bool) {
-    value = in_nodes[1]->value;
-  } else {
-    value = in_nodes[2]->value;
-  }
+  return in_nodes[0]->value._bool ? 1 : 2;
 }
 
 Choice::Choice(const std::vector<graph::Node*>& in_nodes)
-    : Operator(graph::OperatorType::CHOICE) {
+    : SelectionOperator(graph::OperatorType::CHOICE) {
   if (in_nodes.size() < 2) {
     throw std::invalid_argument(
         "operator CHOICE requires at least two parents");
@@ -58,15 +58,15 @@ Choice::Choice(const std::vector<graph::Node*>& in_nodes)
   value = in_nodes[1]->value;
 }
 
-void Choice::eval(std::mt19937& /* gen */) {
+uint Choice::selected_input_index() const {
   assert(in_nodes.size() >= 2);
   graph::natural_t choice = in_nodes[0]->value._natural + 1;
-  if (choice > in_nodes.size()) {
+  if (choice >= in_nodes.size()) {
     throw std::runtime_error(
         "invalid value for CHOICE operator at node_id " +
         std::to_string(index));
   }
-  value = in_nodes[choice]->value;
+  return static_cast<uint>(choice);
 }
 
 } // namespace oper
@@ -12,14 +12,36 @@
 namespace beanmachine {
 namespace oper {
 
-class IfThenElse : public Operator {
+// Base class of the operators whose value is the value of one of their
+// inputs, selected by the value of the first input (the condition).
+// Only the selected input contributes to the value and gradients, so the
+// graph evaluator may leave the unselected inputs stale
+// (see Graph::eval and Graph::branch_only_by_node_id).
+class SelectionOperator : public Operator {
  public:
-  explicit IfThenElse(const std::vector<graph::Node*>& in_nodes);
-  ~IfThenElse() override {}
+  explicit SelectionOperator(graph::OperatorType op_type) : Operator(op_type) {}
+  ~SelectionOperator() override {}
+
+  // The index in in_nodes of the input selected by the current value
+  // of the condition in_nodes[0].
+  virtual uint selected_input_index() const = 0;
+
+  graph::Node* selected_input() const {
+    return in_nodes[selected_input_index()];
+  }
 
   void eval(std::mt19937& gen) override;
   void compute_gradients() override;
+  void compute_gradient_lanes() override;
   void backward() override;
+};
+
+class IfThenElse : public SelectionOperator {
+ public:
+  explicit IfThenElse(const std::vector<graph::Node*>& in_nodes);
+  ~IfThenElse() override {}
+
+  uint selected_input_index() const override;
 
   static std::unique_ptr<Operator> new_op(
       const std::vector<graph::Node*>& in_nodes) {
@@ -31,14 +53,12 @@ class IfThenElse : public Operator {
 };
 
 // This is IfThenElse but the condition is a natural and there are n choices.
-class Choice : public Operator {
+class Choice : public SelectionOperator {
  public:
   explicit Choice(const std::vector<graph::Node*>& in_nodes);
   ~Choice() override {}
 
-  void eval(std::mt19937& gen) override;
-  void compute_gradients() override;
-  void backward() override;
+  uint selected_input_index() const override;
 
   static std::unique_ptr<Operator> new_op(
       const std::vector<graph::Node*>& in_nodes) {
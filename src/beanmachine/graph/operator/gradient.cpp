@@ -24,6 +24,19 @@ namespace oper {
 // first: f'(g(x)) g'(x)
 // second: f''(g(x)) g'(x)^2 + f'(g(x))g''(x)
 
+namespace {
+
+// Applies the chain rule above to each lane of the single input of node,
+// given f'(g(x)) and f''(g(x)).
+void chain_rule_lanes(graph::Node* node, double f_grad, double f_grad2) {
+  const graph::Node* in_node = node->in_nodes[0];
+  node->grad1_lanes = f_grad * in_node->grad1_lanes;
+  node->grad2_lanes = f_grad2 * in_node->grad1_lanes.square() +
+      f_grad * in_node->grad2_lanes;
+}
+
+} // namespace
+
 void Complement::compute_gradients() {
   assert(in_nodes.size() == 1);
   // for complement (f(y)=1-y) and negate(f(y)=-y): f'(y) = -1 and f''(y) = 0
@@ -31,18 +44,33 @@ void Complement::compute_gradients() {
   grad2 = -1 * in_nodes[0]->grad2;
 }
 
+void Complement::compute_gradient_lanes() {
+  assert(in_nodes.size() == 1);
+  chain_rule_lanes(this, -1, 0);
+}
+
 void ToInt::compute_gradients() {
   assert(in_nodes.size() == 1);
   grad1 = in_nodes[0]->grad1;
   grad2 = in_nodes[0]->grad2;
 }
 
+void ToInt::compute_gradient_lanes() {
+  assert(in_nodes.size() == 1);
+  chain_rule_lanes(this, 1, 0);
+}
+
 void ToReal::compute_gradients() {
   assert(in_nodes.size() == 1);
   grad1 = in_nodes[0]->grad1;
   grad2 = in_nodes[0]->grad2;
 }
 
+void ToReal::compute_gradient_lanes() {
+  assert(in_nodes.size() == 1);
+  chain_rule_lanes(this, 1, 0);
+}
+
 void ToRealMatrix::compute_gradients() {
   assert(in_nodes.size() == 1);
   Grad1 = in_nodes[0]->Grad1;
@@ -55,6 +83,11 @@ void ToPosReal::compute_gradients() {
   grad2 = in_nodes[0]->grad2;
 }
 
+void ToPosReal::compute_gradient_lanes() {
+  assert(in_nodes.size() == 1);
+  chain_rule_lanes(this, 1, 0);
+}
+
 void ToPosRealMatrix::compute_gradients() {
   assert(in_nodes.size() == 1);
   Grad1 = in_nodes[0]->Grad1;
@@ -67,18 +100,33 @@ void ToProbability::compute_gradients() {
   grad2 = in_nodes[0]->grad2;
 }
 
+void ToProbability::compute_gradient_lanes() {
+  assert(in_nodes.size() == 1);
+  chain_rule_lanes(this, 1, 0);
+}
+
 void ToNegReal::compute_gradients() {
   assert(in_nodes.size() == 1);
   grad1 = in_nodes[0]->grad1;
   grad2 = in_nodes[0]->grad2;
 }
 
+void ToNegReal::compute_gradient_lanes() {
+  assert(in_nodes.size() == 1);
+  chain_rule_lanes(this, 1, 0);
+}
+
 void Negate::compute_gradients() {
   assert(in_nodes.size() == 1);
   grad1 = -1 * in_nodes[0]->grad1;
   grad2 = -1 * in_nodes[0]->grad2;
 }
 
+void Negate::compute_gradient_lanes() {
+  assert(in_nodes.size() == 1);
+  chain_rule_lanes(this, -1, 0);
+}
+
 void Exp::compute_gradients() {
   assert(in_nodes.size() == 1);
   // for f(y) = exp(y) or f(y) = exp(y)-1 we have f'(y) = exp(y) and f''(y) =
@@ -88,6 +136,12 @@ void Exp::compute_gradients() {
   grad2 = grad1 * in_nodes[0]->grad1 + exp_parent * in_nodes[0]->grad2;
 }
 
+void Exp::compute_gradient_lanes() {
+  assert(in_nodes.size() == 1);
+  double exp_parent = std::exp(in_nodes[0]->value._double);
+  chain_rule_lanes(this, exp_parent, exp_parent);
+}
+
 void ExpM1::compute_gradients() {
   assert(in_nodes.size() == 1);
   double exp_parent = std::exp(in_nodes[0]->value._double);
@@ -95,6 +149,12 @@ void ExpM1::compute_gradients() {
   grad2 = grad1 * in_nodes[0]->grad1 + exp_parent * in_nodes[0]->grad2;
 }
 
+void ExpM1::compute_gradient_lanes() {
+  assert(in_nodes.size() == 1);
+  double exp_parent = std::exp(in_nodes[0]->value._double);
+  chain_rule_lanes(this, exp_parent, exp_parent);
+}
+
 void Log1pExp::compute_gradients() {
   assert(in_nodes.size() == 1);
   // f(x) = log (1 + exp(x))
@@ -108,6 +168,12 @@ void Log1pExp::compute_gradients() {
       f_grad * in_nodes[0]->grad2;
 }
 
+void Log1pExp::compute_gradient_lanes() {
+  assert(in_nodes.size() == 1);
+  double f_grad = 1.0 - std::exp(-value._double);
+  chain_rule_lanes(this, f_grad, f_grad * (1.0 - f_grad));
+}
+
 void Log1mExp::compute_gradients() {
   assert(in_nodes.size() == 1);
   // f(x) = log (1 - exp(x))
@@ -121,6 +187,12 @@ void Log1mExp::compute_gradients() {
       f_grad * in_nodes[0]->grad2;
 }
 
+void Log1mExp::compute_gradient_lanes() {
+  assert(in_nodes.size() == 1);
+  double f_grad = 1.0 - std::exp(-value._double);
+  chain_rule_lanes(this, f_grad, f_grad * (1.0 - f_grad));
+}
+
 void Log::compute_gradients() {
   assert(in_nodes.size() == 1);
   // f(x) = log(x)
@@ -134,6 +206,12 @@ void Log::compute_gradients() {
       f_grad * in_nodes[0]->grad2;
 }
 
+void Log::compute_gradient_lanes() {
+  assert(in_nodes.size() == 1);
+  double f_grad = 1.0 / in_nodes[0]->value._double;
+  chain_rule_lanes(this, f_grad, -f_grad * f_grad);
+}
+
 void Phi::compute_gradients() {
   assert(in_nodes.size() == 1);
   // gradient of the cumulative of the normal density is simply
@@ -150,6 +228,13 @@ void Phi::compute_gradients() {
       grad1_x * in_nodes[0]->grad2;
 }
 
+void Phi::compute_gradient_lanes() {
+  assert(in_nodes.size() == 1);
+  double x = in_nodes[0]->value._double;
+  double grad1_x = M_SQRT1_2 * (M_2_SQRTPI / 2) * std::exp(-0.5 * x * x);
+  chain_rule_lanes(this, grad1_x, grad1_x * (-x));
+}
+
 void Logistic::compute_gradients() {
   assert(in_nodes.size() == 1);
   // f(x) = 1 / (1 + exp(-x))
@@ -163,6 +248,13 @@ void Logistic::compute_gradients() {
       f_grad * in_nodes[0]->grad2;
 }
 
+void Logistic::compute_gradient_lanes() {
+  assert(in_nodes.size() == 1);
+  double f_x = value._double;
+  double f_grad = f_x * (1 - f_x);
+  chain_rule_lanes(this, f_grad, f_grad * (1 - 2 * f_x));
+}
+
 void Pow::compute_gradients() {
   assert(in_nodes.size() == 2);
   // We wish to compute the first and second derivatives of x ** y.
@@ -247,6 +339,36 @@ void Pow::compute_gradients() {
   }
 }
 
+void Pow::compute_gradient_lanes() {
+  assert(in_nodes.size() == 2);
+  // see compute_gradients for the derivation
+  double f = value._double;
+  double x = in_nodes[0]->value._double;
+  double y = in_nodes[1]->value._double;
+  const Eigen::ArrayXd& x1 = in_nodes[0]->grad1_lanes;
+  const Eigen::ArrayXd& y1 = in_nodes[1]->grad1_lanes;
+  const Eigen::ArrayXd& x2 = in_nodes[0]->grad2_lanes;
+  const Eigen::ArrayXd& y2 = in_nodes[1]->grad2_lanes;
+
+  bool constant_exponent = in_nodes[1]->in_nodes.size() == 0;
+  if (constant_exponent) {
+    grad1_lanes = y * std::pow(x, y - 1) * x1;
+    grad2_lanes = y * (y - 1) * std::pow(x, y - 2) * x1.square() +
+        y * std::pow(x, y - 1) * x2;
+  } else if (x <= 0) {
+    grad1_lanes.setConstant(x1.size(), std::nan(""));
+    grad2_lanes.setConstant(x1.size(), std::nan(""));
+  } else {
+    double logx = std::log(x);
+    Eigen::ArrayXd g1 = y1 * logx + x1 * y / x;
+    Eigen::ArrayXd c = x1 * y1 / x;
+    Eigen::ArrayXd g2 =
+        y2 * logx + c + x2 * y / x + c - x1.square() * y / (x * x);
+    grad1_lanes = g1 * f;
+    grad2_lanes = g2 * f + g1 * grad1_lanes;
+  }
+}
+
 void Add::compute_gradients() {
   grad1 = grad2 = 0;
   for (const auto node : in_nodes) {
@@ -255,6 +377,15 @@ void Add::compute_gradients() {
   }
 }
 
+void Add::compute_gradient_lanes() {
+  grad1_lanes.setZero(in_nodes[0]->grad1_lanes.size());
+  grad2_lanes.setZero(in_nodes[0]->grad2_lanes.size());
+  for (const auto node : in_nodes) {
+    grad1_lanes += node->grad1_lanes;
+    grad2_lanes += node->grad2_lanes;
+  }
+}
+
 void MatrixMultiply::compute_gradients() {
   assert(in_nodes.size() == 2);
   int rows = static_cast<int>(in_nodes[0]->value.type.rows);
@@ -306,6 +437,27 @@ void Multiply::compute_gradients() {
   grad2 = sum_product_two_grad1 * 2 + sum_product_one_grad2;
 }
 
+void Multiply::compute_gradient_lanes() {
+  // the running terms of compute_gradients, one lane each
+  auto num_lanes = in_nodes[0]->grad1_lanes.size();
+  double product = 1.0;
+  Eigen::ArrayXd sum_product_one_grad1 = Eigen::ArrayXd::Zero(num_lanes);
+  Eigen::ArrayXd sum_product_two_grad1 = Eigen::ArrayXd::Zero(num_lanes);
+  Eigen::ArrayXd sum_product_one_grad2 = Eigen::ArrayXd::Zero(num_lanes);
+  for (const auto in_node : in_nodes) {
+    double x = in_node->value._double;
+    sum_product_one_grad2 = sum_product_one_grad2 * x +
+        product * in_node->grad2_lanes;
+    sum_product_two_grad1 = sum_product_two_grad1 * x +
+        sum_product_one_grad1 * in_node->grad1_lanes;
+    sum_product_one_grad1 = sum_product_one_grad1 * x +
+        product * in_node->grad1_lanes;
+    product *= x;
+  }
+  grad1_lanes = sum_product_one_grad1;
+  grad2_lanes = sum_product_two_grad1 * 2 + sum_product_one_grad2;
+}
+
 void ElementwiseMultiply::compute_gradients() {
   assert(in_nodes.size() == 2);
   int rows = static_cast<int>(in_nodes[1]->value.type.rows);
@@ -368,6 +520,24 @@ void LogSumExp::compute_gradients() {
   }
 }
 
+void LogSumExp::compute_gradient_lanes() {
+  // see compute_gradients; grad1 must be complete before grad2 uses it
+  grad1_lanes.setZero(in_nodes[0]->grad1_lanes.size());
+  grad2_lanes.setZero(in_nodes[0]->grad2_lanes.size());
+  std::vector<double> f_grad;
+  for (const auto node_i : in_nodes) {
+    double f_grad_i = std::exp(node_i->value._double - value._double);
+    grad1_lanes += f_grad_i * node_i->grad1_lanes;
+    f_grad.push_back(f_grad_i);
+  }
+  for (uint i = 0; i < static_cast<uint>(in_nodes.size()); i++) {
+    const auto node_i = in_nodes[i];
+    grad2_lanes += f_grad[i] *
+        (node_i->grad1_lanes * (node_i->grad1_lanes - grad1_lanes) +
+         node_i->grad2_lanes);
+  }
+}
+
 void LogSumExpVector::compute_gradients() {
   // f(g1, ..., gn) = log(sum_i^n exp(gi))
   // note: in the following equations, df/dx means partial derivative
@@ -387,18 +557,16 @@ void LogSumExpVector::compute_gradients() {
               .sum();
 }
 
-void IfThenElse::compute_gradients() {
-  assert(in_nodes.size() == 3);
-  int choice = in_nodes[0]->value._bool ? 1 : 2;
-  grad1 = in_nodes[choice]->grad1;
-  grad2 = in_nodes[choice]->grad2;
+void SelectionOperator::compute_gradients() {
+  const graph::Node* selected = selected_input();
+  grad1 = selected->grad1;
+  grad2 = selected->grad2;
 }
 
-void Choice::compute_gradients() {
-  graph::natural_t choice = in_nodes[0]->value._natural + 1;
-  assert(in_nodes.size() < choice);
-  grad1 = in_nodes[choice]->grad1;
-  grad2 = in_nodes[choice]->grad2;
+void SelectionOperator::compute_gradient_lanes() {
+  const graph::Node* selected = selected_input();
+  grad1_lanes = selected->grad1_lanes;
+  grad2_lanes = selected->grad2_lanes;
 }
 
 void Index::compute_gradients() {
@@ -573,6 +741,20 @@ void LogProb::compute_gradients() {
   this->grad2 = result_grad2;
 }
 
+void LogProb::compute_gradient_lanes() {
+  auto dist = (Distribution*)in_nodes[0];
+  auto value = in_nodes[1];
+  // the chain rule of compute_gradients through the value, one lane each,
+  // and then through the parameters
+  double log_prob_value_grad1 = 0, log_prob_value_grad2 = 0;
+  dist->gradient_log_prob_value(
+      value->value, log_prob_value_grad1, log_prob_value_grad2);
+  grad1_lanes = value->grad1_lanes * log_prob_value_grad1;
+  grad2_lanes = log_prob_value_grad2 * value->grad1_lanes.square() +
+      value->grad2_lanes * log_prob_value_grad1;
+  dist->gradient_log_prob_param_lanes(value->value, grad1_lanes, grad2_lanes);
+}
+
 void LogProb::backward() {
   auto dist = (Distribution*)in_nodes[0];
   auto value = in_nodes[1];
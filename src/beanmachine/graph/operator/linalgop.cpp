@@ -5,9 +5,13 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <algorithm>
+#include <cmath>
+
 #include "beanmachine/graph/operator/linalgop.h"
 #include <beanmachine/graph/graph.h>
 #include "beanmachine/graph/graph.h"
+#include "beanmachine/graph/thread_pool.h"
 
 /*
 A MACRO that checks the atomic_type of a node to make sure the underlying
@@ -85,9 +89,37 @@ MatrixMultiply::MatrixMultiply(const std::vector<graph::Node*>& in_nodes)
   value = graph::NodeValue(new_type);
 }
 
+// The number of columns per range of a parallel kernel, so that a range
+// does about 1/8 of the work of the smallest parallel kernel.
+static std::size_t column_grain(double flops_per_column) {
+  return static_cast<std::size_t>(std::max(
+      1.0,
+      std::ceil(util::PARALLEL_KERNEL_THRESHOLD / 8 / flops_per_column)));
+}
+
+void matrix_product(
+    const Eigen::Ref<const Eigen::MatrixXd>& a,
+    const Eigen::Ref<const Eigen::MatrixXd>& b,
+    Eigen::MatrixXd& result) {
+  double flops_per_column = 2.0 * a.rows() * a.cols();
+  if (not util::use_parallel_kernel(flops_per_column * b.cols())) {
+    result = a * b;
+    return;
+  }
+  result.resize(a.rows(), b.cols());
+  util::parallel_for(
+      b.cols(),
+      column_grain(flops_per_column),
+      [&](std::size_t begin, std::size_t end) {
+        result.middleCols(begin, end - begin).noalias() =
+            a * b.middleCols(begin, end - begin);
+      });
+}
+
 void MatrixMultiply::eval(std::mt19937& /* gen */) {
   assert(in_nodes.size() == 2);
-  value._matrix = in_nodes[0]->value._matrix * in_nodes[1]->value._matrix;
+  matrix_product(
+      in_nodes[0]->value._matrix, in_nodes[1]->value._matrix, value._matrix);
   if (value.type.variable_type == graph::VariableType::SCALAR) {
     to_scalar();
   }
@@ -410,9 +442,58 @@ Cholesky::Cholesky(const std::vector<graph::Node*>& in_nodes)
       type.cols));
 }
 
+// The number of columns of the blocks of the parallel Cholesky
+// factorization.
+const Eigen::Index CHOLESKY_BLOCK_SIZE = 128;
+
+void cholesky_factor(const Eigen::MatrixXd& matrix, Eigen::MatrixXd& result) {
+  Eigen::Index n = matrix.rows();
+  double flops = std::pow(static_cast<double>(n), 3) / 3;
+  if (not util::use_parallel_kernel(flops)) {
+    result = matrix.llt().matrixL();
+    return;
+  }
+  // Right-looking blocked factorization: each diagonal block is factored
+  // in place, then the panel below it is solved and the trailing matrix
+  // updated, both split into ranges of its columns.
+  result = matrix.triangularView<Eigen::Lower>();
+  for (Eigen::Index k = 0; k < n; k += CHOLESKY_BLOCK_SIZE) {
+    Eigen::Index size = std::min(CHOLESKY_BLOCK_SIZE, n - k);
+    Eigen::Index rest = n - k - size;
+    auto diagonal = result.block(k, k, size, size);
+    diagonal = diagonal.llt().matrixL();
+    if (rest == 0) {
+      break;
+    }
+    // L21 = A21 L11^-T, one range of rows of L21 at a time
+    auto panel = result.block(k + size, k, rest, size);
+    util::parallel_for(
+        rest,
+        column_grain(static_cast<double>(size) * size),
+        [&](std::size_t begin, std::size_t end) {
+          auto rows = panel.middleRows(begin, end - begin);
+          diagonal.triangularView<Eigen::Lower>()
+              .transpose()
+              .solveInPlace<Eigen::OnTheRight>(rows);
+        });
+    // A22 -= L21 L21^T on and below the diagonal
+    util::parallel_for(
+        rest,
+        column_grain(2.0 * rest * size),
+        [&](std::size_t begin, std::size_t end) {
+          Eigen::Index cols = end - begin;
+          Eigen::Index first = k + size + begin;
+          result.block(first, first, n - first, cols).noalias() -=
+              panel.bottomRows(rest - begin) *
+              panel.middleRows(begin, cols).transpose();
+        });
+  }
+  result.triangularView<Eigen::StrictlyUpper>().setZero();
+}
+
 void Cholesky::eval(std::mt19937& /* gen */) {
   assert(in_nodes.size() == 1);
-  value._matrix = in_nodes[0]->value._matrix.llt().matrixL();
+  cholesky_factor(in_nodes[0]->value._matrix, value._matrix);
 }
 
 MatrixExp::MatrixExp(const std::vector<graph::Node*>& in_nodes)
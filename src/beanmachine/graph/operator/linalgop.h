@@ -12,6 +12,19 @@
 namespace beanmachine {
 namespace oper {
 
+/*
+The kernels of MATRIX_MULTIPLY and CHOLESKY. Unless they are large enough
+for util::use_parallel_kernel, they are plain Eigen calls; otherwise they
+split their work into ranges of columns with util::parallel_for.
+*/
+void matrix_product(
+    const Eigen::Ref<const Eigen::MatrixXd>& a,
+    const Eigen::Ref<const Eigen::MatrixXd>& b,
+    Eigen::MatrixXd& result);
+// The lower triangular Cholesky factor of a symmetric positive definite
+// matrix.
+void cholesky_factor(const Eigen::MatrixXd& matrix, Eigen::MatrixXd& result);
+
 /*
  * Transposes a non-scalar parent.
  */
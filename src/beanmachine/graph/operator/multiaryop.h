@@ -47,6 +47,7 @@ class Add : public MultiaryOperator {
 
   void eval(std::mt19937& gen) override;
   void compute_gradients() override;
+  void compute_gradient_lanes() override;
   void backward() override;
 
   static std::unique_ptr<Operator> new_op(
@@ -65,6 +66,7 @@ class Multiply : public MultiaryOperator {
 
   void eval(std::mt19937& gen) override;
   void compute_gradients() override;
+  void compute_gradient_lanes() override;
   void backward() override;
 
   static std::unique_ptr<Operator> new_op(
@@ -83,6 +85,7 @@ class LogSumExp : public MultiaryOperator {
 
   void eval(std::mt19937& gen) override;
   void compute_gradients() override;
+  void compute_gradient_lanes() override;
   void backward() override;
 
   static std::unique_ptr<Operator> new_op(
@@ -103,6 +106,7 @@ class Pow : public Operator {
 
   void eval(std::mt19937& gen) override;
   void compute_gradients() override;
+  void compute_gradient_lanes() override;
   void backward() override;
 
   static std::unique_ptr<Operator> new_op(
@@ -139,6 +143,7 @@ class LogProb : public Operator {
 
   void eval(std::mt19937& gen) override;
   void compute_gradients() override;
+  void compute_gradient_lanes() override;
   void backward() override;
 
   static std::unique_ptr<Operator> new_op(
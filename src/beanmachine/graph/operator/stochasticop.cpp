@@ -80,6 +80,23 @@ void StochasticOperator::gradient_log_prob(
   }
 }
 
+void StochasticOperator::gradient_log_prob_lanes(
+    Eigen::ArrayXd& log_prob_grad1,
+    Eigen::ArrayXd& log_prob_grad2) const {
+  // As explained in gradient_log_prob, the value of this node only depends
+  // on the variable of a lane if this node is its source, and then the
+  // parameters do not, so the lanes of the value (one for a source lane,
+  // zero for the others) and of the parameters may simply be combined.
+  const auto dist = static_cast<const distribution::Distribution*>(in_nodes[0]);
+  if ((grad1_lanes != 0).any()) {
+    double value_grad1 = 0, value_grad2 = 0;
+    dist->gradient_log_prob_value(value, value_grad1, value_grad2);
+    log_prob_grad1 += value_grad1 * grad1_lanes;
+    log_prob_grad2 += value_grad2 * grad1_lanes.square();
+  }
+  dist->gradient_log_prob_param_lanes(value, log_prob_grad1, log_prob_grad2);
+}
+
 graph::NodeValue* StochasticOperator::get_original_value(
     bool sync_from_unconstrained) {
   if (transform_type != graph::TransformType::NONE and
@@ -31,6 +31,9 @@ class StochasticOperator : public Operator {
       const graph::Node* target_node,
       double& first_grad,
       double& second_grad) const override;
+  void gradient_log_prob_lanes(
+      Eigen::ArrayXd& first_grad,
+      Eigen::ArrayXd& second_grad) const override;
   bool is_stochastic() const override {
     return true;
   }
@@ -1391,3 +1391,103 @@ TEST(testgradient, log_prob) {
     }
   }
 }
+
+TEST(testgradient, vector_mode_forward) {
+  Graph g;
+  uint zero = g.add_constant(0.0);
+  uint one = g.add_constant_pos_real(1.0);
+  uint two = g.add_constant_pos_real(2.0);
+  uint normal = g.add_distribution(
+      DistributionType::NORMAL, AtomicType::REAL, {zero, one});
+  uint x = g.add_operator(OperatorType::SAMPLE, {normal});
+  uint gamma = g.add_distribution(
+      DistributionType::GAMMA, AtomicType::POS_REAL, {two, two});
+  uint s = g.add_operator(OperatorType::SAMPLE, {gamma});
+  uint beta = g.add_distribution(
+      DistributionType::BETA, AtomicType::PROBABILITY, {two, two});
+  uint p = g.add_operator(OperatorType::SAMPLE, {beta});
+  // x, s and p share most of their descendants
+  uint s_real = g.add_operator(OperatorType::TO_REAL, {s});
+  uint xs = g.add_operator(OperatorType::MULTIPLY, {x, s_real, x});
+  uint exp_x = g.add_operator(OperatorType::EXP, {x});
+  uint log_s = g.add_operator(OperatorType::LOG, {s});
+  uint lse = g.add_operator(OperatorType::LOGSUMEXP, {xs, log_s, x});
+  uint exp_x_real = g.add_operator(OperatorType::TO_REAL, {exp_x});
+  uint logit = g.add_operator(
+      OperatorType::ADD,
+      {lse, g.add_operator(OperatorType::NEGATE, {exp_x_real})});
+  uint s_pow = g.add_operator(
+      OperatorType::POW,
+      {s, g.add_operator(OperatorType::TO_POS_REAL, {exp_x})});
+  uint p_comp = g.add_operator(OperatorType::COMPLEMENT, {p});
+  uint p_pos = g.add_operator(OperatorType::TO_POS_REAL, {p_comp});
+  uint d1 = g.add_distribution(
+      DistributionType::NORMAL, AtomicType::REAL, {logit, s_pow});
+  uint y1 = g.add_operator(OperatorType::SAMPLE, {d1});
+  uint d2 = g.add_distribution(
+      DistributionType::BERNOULLI_LOGIT,
+      AtomicType::BOOLEAN,
+      {g.add_operator(
+          OperatorType::MULTIPLY,
+          {logit, g.add_operator(OperatorType::TO_REAL, {p})})});
+  uint y2 = g.add_operator(OperatorType::SAMPLE, {d2});
+  uint d3 = g.add_distribution(
+      DistributionType::GAMMA, AtomicType::POS_REAL, {p_pos, s});
+  uint y3 = g.add_operator(OperatorType::SAMPLE, {d3});
+  uint d4 = g.add_distribution(
+      DistributionType::BETA,
+      AtomicType::PROBABILITY,
+      {s, g.add_operator(OperatorType::TO_POS_REAL, {exp_x})});
+  uint y4 = g.add_operator(OperatorType::SAMPLE, {d4});
+  g.add_factor(FactorType::EXP_PRODUCT, {xs, p, s});
+  g.observe(x, 0.3);
+  g.observe(s, 1.5);
+  g.observe(p, 0.4);
+  g.observe(y1, 0.6);
+  g.observe(y2, true);
+  g.observe(y3, 2.5);
+  g.observe(y4, 0.7);
+
+  // lanes can repeat a source and mix sources with disjoint descendants
+  std::array<uint, 8> src_idx{x, s, p, y1, x, y3, s, y4};
+  std::array<double, 8> grad1;
+  std::array<double, 8> grad2;
+  g.gradient_log_prob(src_idx, grad1, grad2);
+  for (std::size_t lane = 0; lane < 8; lane++) {
+    double expected_grad1 = 0;
+    double expected_grad2 = 0;
+    g.gradient_log_prob(src_idx[lane], expected_grad1, expected_grad2);
+    EXPECT_NEAR(grad1[lane], expected_grad1, 1e-10);
+    EXPECT_NEAR(grad2[lane], expected_grad2, 1e-10);
+  }
+  std::array<uint, 1> single{p};
+  std::array<double, 1> single_grad1;
+  std::array<double, 1> single_grad2;
+  g.gradient_log_prob(single, single_grad1, single_grad2);
+  EXPECT_EQ(single_grad1[0], grad1[2]);
+  EXPECT_EQ(single_grad2[0], grad2[2]);
+
+  // sources must be scalar stochastic nodes, and the nodes they affect
+  // need lane rules, which matrix operators do not have
+  std::array<uint, 2> bad_idx{x, xs};
+  std::array<double, 2> bad_grad1;
+  std::array<double, 2> bad_grad2;
+  EXPECT_THROW(
+      g.gradient_log_prob(bad_idx, bad_grad1, bad_grad2), std::runtime_error);
+  uint q = g.add_operator(OperatorType::SAMPLE, {normal});
+  uint m = g.add_operator(
+      OperatorType::TO_MATRIX,
+      {g.add_constant((natural_t)1), g.add_constant((natural_t)1), q});
+  uint m0 =
+      g.add_operator(OperatorType::INDEX, {m, g.add_constant((natural_t)0)});
+  uint y5 = g.add_operator(
+      OperatorType::SAMPLE,
+      {g.add_distribution(
+          DistributionType::NORMAL, AtomicType::REAL, {m0, one})});
+  g.observe(q, 0.1);
+  g.observe(y5, 0.2);
+  std::array<uint, 2> matrix_idx{x, q};
+  EXPECT_THROW(
+      g.gradient_log_prob(matrix_idx, bad_grad1, bad_grad2),
+      std::runtime_error);
+}
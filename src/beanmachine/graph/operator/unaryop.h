@@ -49,6 +49,7 @@ class Complement : public UnaryOperator {
 
   void eval(std::mt19937& gen) override;
   void compute_gradients() override;
+  void compute_gradient_lanes() override;
   double jacobian() const override;
 
   static std::unique_ptr<Operator> new_op(
@@ -67,6 +68,7 @@ class ToInt : public UnaryOperator {
 
   void eval(std::mt19937& gen) override;
   void compute_gradients() override;
+  void compute_gradient_lanes() override;
 
   static std::unique_ptr<Operator> new_op(
       const std::vector<graph::Node*>& in_nodes) {
@@ -84,6 +86,7 @@ class ToReal : public UnaryOperator {
 
   void eval(std::mt19937& gen) override;
   void compute_gradients() override;
+  void compute_gradient_lanes() override;
 
   static std::unique_ptr<Operator> new_op(
       const std::vector<graph::Node*>& in_nodes) {
@@ -118,6 +121,7 @@ class ToPosReal : public UnaryOperator {
 
   void eval(std::mt19937& gen) override;
   void compute_gradients() override;
+  void compute_gradient_lanes() override;
 
   static std::unique_ptr<Operator> new_op(
       const std::vector<graph::Node*>& in_nodes) {
@@ -152,6 +156,7 @@ class ToProbability : public UnaryOperator {
 
   void eval(std::mt19937& gen) override;
   void compute_gradients() override;
+  void compute_gradient_lanes() override;
 
   static std::unique_ptr<Operator> new_op(
       const std::vector<graph::Node*>& in_nodes) {
@@ -169,6 +174,7 @@ class ToNegReal : public UnaryOperator {
 
   void eval(std::mt19937& gen) override;
   void compute_gradients() override;
+  void compute_gradient_lanes() override;
 
   static std::unique_ptr<Operator> new_op(
       const std::vector<graph::Node*>& in_nodes) {
@@ -186,6 +192,7 @@ class Negate : public UnaryOperator {
 
   void eval(std::mt19937& gen) override;
   void compute_gradients() override;
+  void compute_gradient_lanes() override;
   double jacobian() const override;
 
   static std::unique_ptr<Operator> new_op(
@@ -204,6 +211,7 @@ class Exp : public UnaryOperator {
 
   void eval(std::mt19937& gen) override;
   void compute_gradients() override;
+  void compute_gradient_lanes() override;
   double jacobian() const override;
 
   static std::unique_ptr<Operator> new_op(
@@ -222,6 +230,7 @@ class ExpM1 : public UnaryOperator {
 
   void eval(std::mt19937& gen) override;
   void compute_gradients() override;
+  void compute_gradient_lanes() override;
   double jacobian() const override;
 
   static std::unique_ptr<Operator> new_op(
@@ -240,6 +249,7 @@ class Phi : public UnaryOperator {
 
   void eval(std::mt19937& gen) override;
   void compute_gradients() override;
+  void compute_gradient_lanes() override;
   double jacobian() const override;
 
   static std::unique_ptr<Operator> new_op(
@@ -258,6 +268,7 @@ class Logistic : public UnaryOperator {
 
   void eval(std::mt19937& gen) override;
   void compute_gradients() override;
+  void compute_gradient_lanes() override;
   double jacobian() const override;
 
   static std::unique_ptr<Operator> new_op(
@@ -276,6 +287,7 @@ class Log1pExp : public UnaryOperator {
 
   void eval(std::mt19937& gen) override;
   void compute_gradients() override;
+  void compute_gradient_lanes() override;
   double jacobian() const override;
 
   static std::unique_ptr<Operator> new_op(
@@ -294,6 +306,7 @@ class Log : public UnaryOperator {
 
   void eval(std::mt19937& gen) override;
   void compute_gradients() override;
+  void compute_gradient_lanes() override;
   double jacobian() const override;
 
   static std::unique_ptr<Operator> new_op(
@@ -312,6 +325,7 @@ class Log1mExp : public UnaryOperator {
 
   void eval(std::mt19937& gen) override;
   void compute_gradients() override;
+  void compute_gradient_lanes() override;
   double jacobian() const override;
 
   static std::unique_ptr<Operator> new_op(
@@ -5,11 +5,13 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <limits>
 #include <random>
 
 #include "beanmachine/graph/proposer/mixture.h"
-#include "beanmachine/graph/util.h"
 
 namespace beanmachine {
 namespace proposer {
@@ -38,13 +40,25 @@ graph::NodeValue Mixture::sample(std::mt19937& gen) const {
 }
 
 double Mixture::log_prob(graph::NodeValue& value) const {
-  std::vector<double> log_probs;
-  for (std::vector<double>::size_type index = 0; index < weights.size();
-       index++) {
-    log_probs.push_back(
-        log(weights[index]) + proposers[index]->log_prob(value));
+  // log sum_i exp(log(w_i) + log_prob_i(value)), computed in place so that
+  // scoring a proposal does not allocate
+  std::array<double, 8> inline_log_probs;
+  PooledVector<double> pooled_log_probs;
+  double* log_probs = inline_log_probs.data();
+  if (weights.size() > inline_log_probs.size()) {
+    pooled_log_probs.resize(weights.size());
+    log_probs = pooled_log_probs.data();
   }
-  return util::log_sum_exp(log_probs) - std::log(weight_sum);
+  double max_log_prob = -std::numeric_limits<double>::infinity();
+  for (std::size_t index = 0; index < weights.size(); index++) {
+    log_probs[index] = log(weights[index]) + proposers[index]->log_prob(value);
+    max_log_prob = std::max(max_log_prob, log_probs[index]);
+  }
+  double sum_exp = 0;
+  for (std::size_t index = 0; index < weights.size(); index++) {
+    sum_exp += std::exp(log_probs[index] - max_log_prob);
+  }
+  return max_log_prob + std::log(sum_exp) - std::log(weight_sum);
 }
 
 } // namespace proposer
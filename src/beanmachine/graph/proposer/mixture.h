@@ -19,15 +19,25 @@ class Mixture : public Proposer {
   :param proposers:
   */
   Mixture(
-      std::vector<double> in_weights,
-      std::vector<std::unique_ptr<Proposer>> in_proposers)
-      : Proposer(), weights(in_weights), proposers(std::move(in_proposers)) {
+      PooledVector<double> in_weights,
+      PooledVector<std::unique_ptr<Proposer>> in_proposers)
+      : Proposer(),
+        weights(std::move(in_weights)),
+        proposers(std::move(in_proposers)) {
     assert(weights.size() == proposers.size());
     weight_sum = 0;
     for (auto weight : weights) {
       weight_sum += weight;
     }
   }
+  Mixture(
+      const std::vector<double>& in_weights,
+      std::vector<std::unique_ptr<Proposer>> in_proposers)
+      : Mixture(
+            PooledVector<double>(in_weights.begin(), in_weights.end()),
+            PooledVector<std::unique_ptr<Proposer>>(
+                std::make_move_iterator(in_proposers.begin()),
+                std::make_move_iterator(in_proposers.end()))) {}
   /*
   Sample a value from the proposer.
   :param gen: Random number generator.
@@ -43,8 +53,8 @@ class Mixture : public Proposer {
 
  private:
   double weight_sum;
-  std::vector<double> weights;
-  std::vector<std::unique_ptr<Proposer>> proposers;
+  PooledVector<double> weights;
+  PooledVector<std::unique_ptr<Proposer>> proposers;
 };
 
 } // namespace proposer
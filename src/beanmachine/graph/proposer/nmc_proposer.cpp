@@ -26,8 +26,11 @@ const double RANDOM_WALK_WEIGHT = 0.01;
 std::unique_ptr<Proposer>
 nmc_proposer(const graph::NodeValue& value, double grad1, double grad2) {
   bool is_valid_grad = std::isfinite(grad1) && std::isfinite(grad2);
-  std::vector<double> weights;
-  std::vector<std::unique_ptr<Proposer>> proposers;
+  // at most six components, see below
+  PooledVector<double> weights;
+  PooledVector<std::unique_ptr<Proposer>> proposers;
+  weights.reserve(8);
+  proposers.reserve(8);
   // For boolean variables we will put a point mass on the complementary value
   // and a small mass on the current value. This latter is needed to avoid
   // periodicity.
@@ -135,7 +138,7 @@ nmc_proposer(const graph::NodeValue& value, double grad1, double grad2) {
       proposers.push_back(std::make_unique<Gamma>(alpha / 10, beta / 10));
     }
   }
-  return std::make_unique<Mixture>(weights, std::move(proposers));
+  return std::make_unique<Mixture>(std::move(weights), std::move(proposers));
 }
 
 } // namespace proposer
@@ -7,6 +7,7 @@
 
 #pragma once
 #include "beanmachine/graph/graph.h"
+#include "beanmachine/graph/proposer/proposer_pool.h"
 
 // TODO: should change name to "Proposal" to better match the literature.
 
@@ -30,6 +31,15 @@ class Proposer {
   virtual double log_prob(graph::NodeValue& value) const = 0;
   // Destructor for Proposer
   virtual ~Proposer() {}
+
+  // Proposers are created anew for every single-site step, so they are
+  // allocated from the per-thread pool of proposer_pool.h.
+  static void* operator new(std::size_t size) {
+    return pool_allocate(size);
+  }
+  static void operator delete(void* ptr, std::size_t size) {
+    pool_deallocate(ptr, size);
+  }
 };
 
 /*
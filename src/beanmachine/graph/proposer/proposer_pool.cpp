@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <array>
+#include <new>
+
+#include "beanmachine/graph/proposer/proposer_pool.h"
+
+namespace beanmachine {
+namespace proposer {
+
+namespace {
+
+const std::size_t POOL_NUM_SIZE_CLASSES =
+    POOL_MAX_BLOCK_SIZE / POOL_BLOCK_GRANULARITY;
+
+struct BlockCache {
+  // free_blocks[k] holds blocks of (k + 1) * POOL_BLOCK_GRANULARITY bytes
+  std::array<std::vector<void*>, POOL_NUM_SIZE_CLASSES> free_blocks;
+
+  ~BlockCache() {
+    for (auto& blocks : free_blocks) {
+      for (void* block : blocks) {
+        ::operator delete(block);
+      }
+    }
+  }
+};
+
+thread_local BlockCache block_cache;
+
+std::size_t size_class(std::size_t size) {
+  return size == 0 ? 0 : (size - 1) / POOL_BLOCK_GRANULARITY;
+}
+
+} // namespace
+
+void* pool_allocate(std::size_t size) {
+  if (size > POOL_MAX_BLOCK_SIZE) {
+    return ::operator new(size);
+  }
+  std::size_t k = size_class(size);
+  auto& blocks = block_cache.free_blocks[k];
+  if (blocks.empty()) {
+    return ::operator new((k + 1) * POOL_BLOCK_GRANULARITY);
+  }
+  void* block = blocks.back();
+  blocks.pop_back();
+  return block;
+}
+
+void pool_deallocate(void* ptr, std::size_t size) {
+  if (ptr == nullptr) {
+    return;
+  }
+  if (size > POOL_MAX_BLOCK_SIZE) {
+    ::operator delete(ptr);
+    return;
+  }
+  block_cache.free_blocks[size_class(size)].push_back(ptr);
+}
+
+} // namespace proposer
+} // namespace beanmachine
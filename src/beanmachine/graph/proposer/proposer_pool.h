@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+#include <cstddef>
+#include <vector>
+
+namespace beanmachine {
+namespace proposer {
+
+/*
+A per-thread cache of small memory blocks for the short-lived objects that
+single-site steps create and destroy for every proposal (the proposers and
+their weight vectors). A block is allocated from the global heap the first
+time its size is needed and afterwards recycled through the free list of the
+thread releasing it, so steady-state inference does not go through the
+global allocator, whose lock parallel chains would otherwise contend for.
+
+Each block is an independent heap allocation, so a block may be released by
+a thread other than the one that allocated it, and the blocks cached by a
+thread are returned to the heap when the thread exits. Sizes above
+POOL_MAX_BLOCK_SIZE bytes are not cached.
+*/
+const std::size_t POOL_BLOCK_GRANULARITY = 16;
+const std::size_t POOL_MAX_BLOCK_SIZE = 512;
+
+void* pool_allocate(std::size_t size);
+void pool_deallocate(void* ptr, std::size_t size);
+
+// A standard allocator drawing from the cache above.
+template <typename T>
+struct PoolAllocator {
+  using value_type = T;
+
+  PoolAllocator() noexcept {}
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U>& /* other */) noexcept {}
+
+  T* allocate(std::size_t n) {
+    return static_cast<T*>(pool_allocate(n * sizeof(T)));
+  }
+  void deallocate(T* ptr, std::size_t n) noexcept {
+    pool_deallocate(ptr, n * sizeof(T));
+  }
+
+  template <typename U>
+  bool operator==(const PoolAllocator<U>& /* other */) const noexcept {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const PoolAllocator<U>& /* other */) const noexcept {
+    return false;
+  }
+};
+
+template <typename T>
+using PooledVector = std::vector<T, PoolAllocator<T>>;
+
+} // namespace proposer
+} // namespace beanmachine
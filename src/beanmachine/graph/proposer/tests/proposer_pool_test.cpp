@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+#include <thread>
+
+#include "beanmachine/graph/proposer/normal.h"
+#include "beanmachine/graph/proposer/proposer.h"
+#include "beanmachine/graph/proposer/proposer_pool.h"
+
+using namespace beanmachine::graph;
+using namespace beanmachine::proposer;
+
+TEST(testproposer, proposer_pool) {
+  // a released block is reused by the next allocation of its size class
+  void* block = pool_allocate(40);
+  pool_deallocate(block, 40);
+  EXPECT_EQ(pool_allocate(48), block);
+  pool_deallocate(block, 48);
+
+  // and so are proposers
+  const Proposer* address;
+  {
+    std::unique_ptr<Proposer> normal = std::make_unique<Normal>(0.0, 1.0);
+    address = normal.get();
+  }
+  std::unique_ptr<Proposer> normal = std::make_unique<Normal>(1.0, 2.0);
+  EXPECT_EQ(normal.get(), address);
+  NodeValue value(1.0);
+  EXPECT_NEAR(
+      normal->log_prob(value),
+      -std::log(2.0) - 0.5 * std::log(2 * M_PI),
+      1e-10);
+
+  // blocks may be released by another thread, and large sizes bypass the
+  // cache
+  void* other_thread_block = nullptr;
+  std::thread([&]() { other_thread_block = pool_allocate(24); }).join();
+  pool_deallocate(other_thread_block, 24);
+  void* large = pool_allocate(4 * POOL_MAX_BLOCK_SIZE);
+  pool_deallocate(large, 4 * POOL_MAX_BLOCK_SIZE);
+
+  PooledVector<double> values;
+  for (int i = 0; i < 100; i++) {
+    values.push_back(i);
+  }
+  EXPECT_EQ(values[99], 99.0);
+}
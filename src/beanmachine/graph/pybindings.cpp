@@ -106,6 +106,7 @@ PYBIND11_MODULE(graph, module) {
       .value("BERNOULLI_LOGIT", DistributionType::BERNOULLI_LOGIT)
       .value("GAMMA", DistributionType::GAMMA)
       .value("BIMIXTURE", DistributionType::BIMIXTURE)
+      .value("MIXTURE", DistributionType::MIXTURE)
       .value("DIRICHLET", DistributionType::DIRICHLET)
       .value("CATEGORICAL", DistributionType::CATEGORICAL)
       .value("POISSON", DistributionType::POISSON)
@@ -130,11 +131,22 @@ PYBIND11_MODULE(graph, module) {
   py::class_<InferConfig>(module, "InferConfig")
       .def(py::init())
       .def(py::init<bool, double, double, uint, bool>())
+      .def(py::init<bool, double, double, uint, bool, uint>())
       .def_readwrite("keep_log_prob", &InferConfig::keep_log_prob)
       .def_readwrite("path_length", &InferConfig::path_length)
       .def_readwrite("step_size", &InferConfig::step_size)
       .def_readwrite("num_warmup", &InferConfig::num_warmup)
-      .def_readwrite("keep_warmup", &InferConfig::keep_warmup);
+      .def_readwrite("keep_warmup", &InferConfig::keep_warmup)
+      .def_readwrite("thinning", &InferConfig::thinning)
+      .def_readwrite(
+          "delayed_acceptance_subset_size",
+          &InferConfig::delayed_acceptance_subset_size)
+      .def_readwrite("rao_blackwellize", &InferConfig::rao_blackwellize)
+      .def_readwrite("control_variates", &InferConfig::control_variates)
+      .def_readwrite("pin_threads", &InferConfig::pin_threads)
+      .def_readwrite("use_processes", &InferConfig::use_processes)
+      .def_readwrite("sample_store_path", &InferConfig::sample_store_path)
+      .def_readwrite("max_threads", &InferConfig::max_threads);
 
   // CONSIDER: Remove the overloaded add_constant APIs; the overloaded API's
   // binding behaviour is a little confusing. For example,
@@ -143,6 +155,15 @@ PYBIND11_MODULE(graph, module) {
       .def(py::init())
       .def("to_string", &Graph::to_string, "string representation of the graph")
       .def("to_dot", &Graph::to_dot, "DOT representation of the graph")
+      .def(
+          "serialize",
+          &serialize_graph,
+          "text representation of the graph, its observations and queries")
+      .def_static(
+          "deserialize",
+          &deserialize_graph,
+          "rebuild a graph from its serialized text",
+          py::arg("text"))
       .def(
           "add_constant_bool",
           (uint(Graph::*)(bool)) & Graph::add_constant,
@@ -306,6 +327,34 @@ PYBIND11_MODULE(graph, module) {
           (void (Graph::*)()) & Graph::remove_observations,
           "remove all observations from the graph")
       .def("query", &Graph::query, "query a node", py::arg("node_id"))
+      .def(
+          "add_data_slot",
+          &Graph::add_data_slot,
+          "name a constant or an observed node as a rebindable data slot",
+          py::arg("name"),
+          py::arg("node_id"))
+      .def(
+          "bind_data_slot",
+          [](Graph& g,
+             const std::string& name,
+             py::array_t<double, py::array::f_style | py::array::forcecast>
+                 values) {
+            g.bind_data_slot(name, values.data(), values.size());
+          },
+          "set the value of a real-valued data slot from an array",
+          py::arg("name"),
+          py::arg("values"))
+      .def(
+          "bind_data_slot",
+          (void (Graph::*)(const std::string&, NodeValue)) &
+              Graph::bind_data_slot,
+          "set the value of a data slot",
+          py::arg("name"),
+          py::arg("value"))
+      .def(
+          "get_data_slots",
+          &Graph::get_data_slots,
+          "the node ids of the data slots by name")
       .def(
           "infer_mean",
           (std::vector<double> & (Graph::*)(uint, InferenceType, uint)) &
@@ -345,6 +394,42 @@ PYBIND11_MODULE(graph, module) {
           py::arg("seed") = 5123401,
           py::arg("n_chains") = 4,
           py::arg("infer_config") = InferConfig())
+      .def_static(
+          "infer_batch",
+          [](std::vector<Graph*> graphs,
+             uint num_samples,
+             InferenceType algorithm,
+             uint seed,
+             uint n_chains,
+             InferConfig infer_config,
+             uint num_threads) {
+            std::vector<BatchInferJob> jobs;
+            for (Graph* graph : graphs) {
+              jobs.emplace_back(
+                  graph, num_samples, algorithm, seed, n_chains, infer_config);
+            }
+            {
+              py::gil_scoped_release release;
+              infer_batch(jobs, num_threads);
+            }
+            std::vector<std::vector<std::vector<std::vector<NodeValue>>>>
+                samples;
+            for (auto& job : jobs) {
+              if (not job.error.empty()) {
+                throw std::runtime_error(job.error);
+              }
+              samples.push_back(job.graph->samples_allchains);
+            }
+            return samples;
+          },
+          "infer the queried nodes of many graphs on a shared thread pool",
+          py::arg("graphs"),
+          py::arg("num_samples"),
+          py::arg("algorithm") = InferenceType::GIBBS,
+          py::arg("seed") = 5123401,
+          py::arg("n_chains") = 1,
+          py::arg("infer_config") = InferConfig(),
+          py::arg("num_threads") = 0)
       .def(
           "variational",
           &Graph::variational,
@@ -387,7 +472,22 @@ PYBIND11_MODULE(graph, module) {
           py::arg("seed"),
           py::arg("num_warmup_samples") = 0,
           py::arg("save_warmup") = false,
-          py::arg("init_type") = InitType::RANDOM);
+          py::arg("init_type") = InitType::RANDOM)
+      .def(
+          "set_gradient_checkpointing",
+          &NUTS::set_gradient_checkpointing,
+          "recompute intermediate matrices in the backward pass",
+          py::arg("checkpoint_interval"))
+      .def(
+          "set_density_compilation",
+          &NUTS::set_density_compilation,
+          "evaluate the log density with generated and compiled C++ code",
+          py::arg("enabled"))
+      .def(
+          "set_speculative_tree_building",
+          &NUTS::set_speculative_tree_building,
+          "build the trajectory in both directions on two threads",
+          py::arg("enabled"));
 
   py::class_<HMC>(module, "HMC")
       .def(py::init<Graph&, double, double>())
@@ -399,7 +499,50 @@ PYBIND11_MODULE(graph, module) {
           py::arg("seed"),
           py::arg("num_warmup_samples") = 0,
           py::arg("save_warmup") = false,
-          py::arg("init_type") = InitType::RANDOM);
+          py::arg("init_type") = InitType::RANDOM)
+      .def(
+          "set_gradient_checkpointing",
+          &HMC::set_gradient_checkpointing,
+          "recompute intermediate matrices in the backward pass",
+          py::arg("checkpoint_interval"))
+      .def(
+          "set_density_compilation",
+          &HMC::set_density_compilation,
+          "evaluate the log density with generated and compiled C++ code",
+          py::arg("enabled"))
+      .def(
+          "set_path_length_adaptation",
+          &HMC::set_path_length_adaptation,
+          "adapt the path length during warmup and jitter it",
+          py::arg("enabled"));
+
+  py::class_<LogDensity>(module, "LogDensity")
+      .def(
+          py::init<Graph&, uint>(),
+          py::arg("graph"),
+          py::arg("num_threads") = 0)
+      .def("dimension", &LogDensity::dimension, "length of a parameter vector")
+      .def(
+          "log_prob",
+          [](LogDensity& density, const Eigen::MatrixXd& thetas) {
+            Eigen::VectorXd log_probs;
+            density.log_prob(thetas, log_probs);
+            return log_probs;
+          },
+          "log density of each row of a [batch, dim] array",
+          py::arg("thetas"),
+          py::call_guard<py::gil_scoped_release>())
+      .def(
+          "log_prob_and_grad",
+          [](LogDensity& density, const Eigen::MatrixXd& thetas) {
+            Eigen::VectorXd log_probs;
+            Eigen::MatrixXd grads;
+            density.log_prob_and_grad(thetas, log_probs, grads);
+            return std::make_tuple(log_probs, grads);
+          },
+          "log density and its gradient at each row of a [batch, dim] array",
+          py::arg("thetas"),
+          py::call_guard<py::gil_scoped_release>());
 }
 
 } // namespace graph
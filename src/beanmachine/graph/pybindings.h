@@ -8,10 +8,13 @@
 #pragma once
 #include <pybind11/eigen.h>
 
+#include "beanmachine/graph/batch_infer.h"
 #include "beanmachine/graph/global/global_mh.h"
 #include "beanmachine/graph/global/hmc.h"
+#include "beanmachine/graph/global/log_density.h"
 #include "beanmachine/graph/global/nuts.h"
 #include "beanmachine/graph/graph.h"
+#include "beanmachine/graph/serialization.h"
 
 // to keep the linter happy this template specialization has been declared here
 // in a header file that is only meant to be included by pybindings.cpp
@@ -13,7 +13,8 @@ namespace graph {
 // TODO: move this inference method out of Graph.
 void Graph::rejection(uint num_samples, uint seed, InferConfig infer_config) {
   std::mt19937 gen(seed);
-  for (uint snum = 0; snum < num_samples + infer_config.num_warmup; snum++) {
+  for (uint snum = 0; snum < infer_config.num_iterations(num_samples);
+       snum++) {
     // rejection sampling
     bool rejected;
     do {
@@ -39,10 +40,11 @@ void Graph::rejection(uint num_samples, uint seed, InferConfig infer_config) {
         }
       }
     } while (rejected);
-    if (infer_config.keep_log_prob) {
-      collect_log_prob(full_log_prob());
-    }
-    if (infer_config.keep_warmup or snum >= infer_config.num_warmup) {
+    if (infer_config.is_collected(snum)) {
+      if (infer_config.keep_log_prob) {
+        // every node was just evaluated
+        collect_log_prob(log_prob_of_evaluated_supp());
+      }
       collect_sample();
     }
   }
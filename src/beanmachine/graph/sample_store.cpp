@@ -0,0 +1,337 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "beanmachine/graph/sample_store.h"
+
+namespace beanmachine {
+namespace graph {
+
+namespace {
+
+const char MAGIC[8] = {'B', 'M', 'G', 'S', 'T', 'O', 'R', 'E'};
+const std::uint32_t VERSION = 1;
+const std::size_t ALIGNMENT = 64;
+
+static_assert(sizeof(SampleStoreHeader) == 32, "packed sample store header");
+static_assert(sizeof(SampleStoreColumn) == 32, "packed sample store column");
+
+std::size_t align(std::size_t offset) {
+  return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+std::size_t draw_size(const SampleStoreColumn& column) {
+  return std::size_t(column.element_size) * column.rows * column.cols;
+}
+
+std::size_t metadata_size(uint num_columns, uint num_chains) {
+  return sizeof(SampleStoreHeader) + num_columns * sizeof(SampleStoreColumn) +
+      num_chains * sizeof(std::uint64_t);
+}
+
+SampleStoreColumn make_column(std::uint32_t node_id, const ValueType& type) {
+  SampleStoreColumn column;
+  column.node_id = node_id;
+  column.variable_type = static_cast<std::uint32_t>(type.variable_type);
+  column.atomic_type = static_cast<std::uint32_t>(type.atomic_type);
+  switch (type.atomic_type) {
+    case AtomicType::BOOLEAN:
+      column.element_size = sizeof(std::uint8_t);
+      break;
+    case AtomicType::NATURAL:
+      column.element_size = sizeof(std::uint64_t);
+      break;
+    case AtomicType::REAL:
+    case AtomicType::POS_REAL:
+    case AtomicType::NEG_REAL:
+    case AtomicType::PROBABILITY:
+      column.element_size = sizeof(double);
+      break;
+    default:
+      throw std::invalid_argument(
+          "cannot store samples of type " + type.to_string());
+  }
+  bool scalar = type.variable_type == VariableType::SCALAR;
+  column.rows = scalar ? 1 : type.rows;
+  column.cols = scalar ? 1 : type.cols;
+  column.offset = 0;
+  return column;
+}
+
+} // namespace
+
+SampleStoreWriter::SampleStoreWriter(
+    const std::string& path,
+    const std::vector<uint>& queries,
+    const std::vector<ValueType>& query_types,
+    uint num_chains,
+    std::size_t num_draws,
+    bool keep_log_prob)
+    : mapped_size(0),
+      data(nullptr),
+      header(nullptr),
+      columns(nullptr),
+      draws_written(nullptr),
+      log_probs_written(num_chains, 0) {
+#ifdef _WIN32
+  throw std::runtime_error("sample stores are not supported on this platform");
+#else
+  std::vector<SampleStoreColumn> layout;
+  for (uint i = 0; i < queries.size(); i++) {
+    layout.push_back(make_column(queries[i], query_types[i]));
+  }
+  if (keep_log_prob) {
+    layout.push_back(make_column(
+        SampleStoreColumn::LOG_PROB_COLUMN, ValueType(AtomicType::REAL)));
+  }
+  std::size_t offset = align(metadata_size(layout.size(), num_chains));
+  for (auto& column : layout) {
+    column.offset = offset;
+    offset = align(offset + num_chains * num_draws * draw_size(column));
+  }
+  mapped_size = offset;
+
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("cannot create sample store " + path);
+  }
+  // the file is sized up front, so unwritten draws read as zeros
+  if (ftruncate(fd, mapped_size) != 0) {
+    close(fd);
+    throw std::runtime_error("cannot allocate sample store " + path);
+  }
+  void* memory =
+      mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED) {
+    throw std::runtime_error("cannot map sample store " + path);
+  }
+  data = static_cast<char*>(memory);
+  header = reinterpret_cast<SampleStoreHeader*>(data);
+  std::memcpy(header->magic, MAGIC, sizeof(MAGIC));
+  header->version = VERSION;
+  header->num_columns = static_cast<std::uint32_t>(layout.size());
+  header->num_chains = num_chains;
+  header->reserved = 0;
+  header->num_draws = num_draws;
+  columns = reinterpret_cast<SampleStoreColumn*>(data + sizeof(*header));
+  std::memcpy(columns, layout.data(), layout.size() * sizeof(layout[0]));
+  draws_written = reinterpret_cast<std::uint64_t*>(columns + layout.size());
+  std::fill(draws_written, draws_written + num_chains, 0);
+#endif
+}
+
+SampleStoreWriter::~SampleStoreWriter() {
+#ifndef _WIN32
+  if (data != nullptr) {
+    munmap(data, mapped_size);
+  }
+#endif
+}
+
+void SampleStoreWriter::append(
+    uint chain,
+    const std::vector<NodeValue>& sample) {
+  std::uint64_t draw = draws_written[chain];
+  if (draw >= header->num_draws) {
+    throw std::runtime_error("the sample store of this run is full");
+  }
+  for (uint q = 0; q < sample.size(); q++) {
+    const SampleStoreColumn& column = columns[q];
+    const NodeValue& value = sample[q];
+    std::size_t size = draw_size(column);
+    char* out =
+        data + column.offset + (chain * header->num_draws + draw) * size;
+    // matrices are stored in row-major order, as NumPy expects
+    std::size_t i = 0;
+    for (uint r = 0; r < column.rows; r++) {
+      for (uint c = 0; c < column.cols; c++, i++) {
+        bool scalar = value.type.variable_type == VariableType::SCALAR;
+        switch (value.type.atomic_type) {
+          case AtomicType::BOOLEAN: {
+            std::uint8_t b = scalar ? value._bool : value._bmatrix(r, c);
+            std::memcpy(out + i * sizeof(b), &b, sizeof(b));
+            break;
+          }
+          case AtomicType::NATURAL: {
+            std::uint64_t n = scalar ? value._natural : value._nmatrix(r, c);
+            std::memcpy(out + i * sizeof(n), &n, sizeof(n));
+            break;
+          }
+          default: {
+            double d = scalar ? value._double : value._matrix(r, c);
+            std::memcpy(out + i * sizeof(d), &d, sizeof(d));
+            break;
+          }
+        }
+      }
+    }
+  }
+  draws_written[chain] = draw + 1;
+}
+
+void SampleStoreWriter::append_log_prob(uint chain, double log_prob) {
+  const SampleStoreColumn& column = columns[header->num_columns - 1];
+  if (column.node_id != SampleStoreColumn::LOG_PROB_COLUMN) {
+    throw std::runtime_error("the sample store does not keep log probs");
+  }
+  std::uint64_t draw = log_probs_written[chain];
+  if (draw >= header->num_draws) {
+    throw std::runtime_error("the sample store of this run is full");
+  }
+  std::size_t index = chain * header->num_draws + draw;
+  std::memcpy(
+      data + column.offset + index * sizeof(double),
+      &log_prob,
+      sizeof(double));
+  log_probs_written[chain] = draw + 1;
+}
+
+SampleStoreReader::SampleStoreReader(const std::string& path)
+    : mapped_size(0),
+      data(nullptr),
+      header(nullptr),
+      columns(nullptr),
+      draws_written(nullptr),
+      num_query_columns(0) {
+#ifdef _WIN32
+  throw std::runtime_error("sample stores are not supported on this platform");
+#else
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("cannot open sample store " + path);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 or
+      static_cast<std::size_t>(st.st_size) < sizeof(SampleStoreHeader)) {
+    close(fd);
+    throw std::runtime_error("not a sample store: " + path);
+  }
+  mapped_size = st.st_size;
+  void* memory = mmap(nullptr, mapped_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED) {
+    throw std::runtime_error("cannot map sample store " + path);
+  }
+  data = static_cast<const char*>(memory);
+  header = reinterpret_cast<const SampleStoreHeader*>(data);
+  columns = reinterpret_cast<const SampleStoreColumn*>(data + sizeof(*header));
+  bool valid = std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) == 0 and
+      header->version == VERSION and
+      metadata_size(header->num_columns, header->num_chains) <= mapped_size;
+  for (uint i = 0; valid and i < header->num_columns; i++) {
+    valid = columns[i].offset +
+            header->num_chains * header->num_draws * draw_size(columns[i]) <=
+        mapped_size;
+  }
+  if (not valid) {
+    munmap(memory, mapped_size);
+    data = nullptr;
+    throw std::runtime_error("not a valid sample store: " + path);
+  }
+  draws_written =
+      reinterpret_cast<const std::uint64_t*>(columns + header->num_columns);
+  num_query_columns = header->num_columns;
+  if (num_query_columns > 0 and
+      columns[num_query_columns - 1].node_id ==
+          SampleStoreColumn::LOG_PROB_COLUMN) {
+    num_query_columns--;
+  }
+#endif
+}
+
+SampleStoreReader::~SampleStoreReader() {
+#ifndef _WIN32
+  if (data != nullptr) {
+    munmap(const_cast<char*>(data), mapped_size);
+  }
+#endif
+}
+
+const void* SampleStoreReader::query_data(uint query, uint chain) const {
+  const SampleStoreColumn& column = columns[query];
+  return data + column.offset +
+      chain * header->num_draws * draw_size(column);
+}
+
+NodeValue SampleStoreReader::value(uint query, uint chain, std::size_t draw)
+    const {
+  const SampleStoreColumn& column = columns[query];
+  const char* in = static_cast<const char*>(query_data(query, chain)) +
+      draw * draw_size(column);
+  auto variable_type = static_cast<VariableType>(column.variable_type);
+  auto atomic_type = static_cast<AtomicType>(column.atomic_type);
+  if (variable_type == VariableType::SCALAR) {
+    switch (atomic_type) {
+      case AtomicType::BOOLEAN:
+        return NodeValue(bool(*reinterpret_cast<const std::uint8_t*>(in)));
+      case AtomicType::NATURAL: {
+        std::uint64_t n;
+        std::memcpy(&n, in, sizeof(n));
+        return NodeValue(natural_t(n));
+      }
+      default: {
+        double d;
+        std::memcpy(&d, in, sizeof(d));
+        return NodeValue(atomic_type, d);
+      }
+    }
+  }
+  ValueType type(variable_type, atomic_type, column.rows, column.cols);
+  switch (atomic_type) {
+    case AtomicType::BOOLEAN: {
+      Eigen::MatrixXb matrix(column.rows, column.cols);
+      for (uint r = 0, i = 0; r < column.rows; r++) {
+        for (uint c = 0; c < column.cols; c++, i++) {
+          matrix(r, c) = in[i] != 0;
+        }
+      }
+      return NodeValue(type, matrix);
+    }
+    case AtomicType::NATURAL: {
+      Eigen::MatrixXn matrix(column.rows, column.cols);
+      for (uint r = 0, i = 0; r < column.rows; r++) {
+        for (uint c = 0; c < column.cols; c++, i++) {
+          std::uint64_t n;
+          std::memcpy(&n, in + i * sizeof(n), sizeof(n));
+          matrix(r, c) = n;
+        }
+      }
+      return NodeValue(type, matrix);
+    }
+    default: {
+      Eigen::MatrixXd matrix(column.rows, column.cols);
+      for (uint r = 0, i = 0; r < column.rows; r++) {
+        for (uint c = 0; c < column.cols; c++, i++) {
+          std::memcpy(&matrix(r, c), in + i * sizeof(double), sizeof(double));
+        }
+      }
+      return NodeValue(type, matrix);
+    }
+  }
+}
+
+const double* SampleStoreReader::log_probs(uint chain) const {
+  if (num_query_columns == header->num_columns) {
+    return nullptr;
+  }
+  const SampleStoreColumn& column = columns[num_query_columns];
+  return reinterpret_cast<const double*>(
+      data + column.offset + chain * header->num_draws * sizeof(double));
+}
+
+} // namespace graph
+} // namespace beanmachine
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "beanmachine/graph/graph.h"
+
+namespace beanmachine {
+namespace graph {
+
+/*
+A columnar binary file of the samples of a multi-chain run, written in place
+through a shared memory mapping as the samples are collected (see
+InferConfig::sample_store_path), so that inference does not keep its samples
+in memory and the results can be memory-mapped without parsing.
+
+The file holds, in native byte order:
+  a SampleStoreHeader;
+  a SampleStoreColumn per query, in query order, followed by one for the log
+  probs if they were kept;
+  the number of draws written so far by each chain, as num_chains uint64;
+  the data of each column at its 64-byte aligned offset, as an array of shape
+  [num_chains][num_draws][rows][cols] (scalars are 1x1) of float64, uint64
+  for naturals or uint8 for booleans. Draws past a chain's written count are
+  zero.
+
+From NumPy:
+  header = np.dtype([("magic", "S8"), ("version", "u4"),
+      ("num_columns", "u4"), ("num_chains", "u4"), ("reserved", "u4"),
+      ("num_draws", "u8")])
+  column = np.dtype([("node_id", "u4"), ("variable_type", "u4"),
+      ("atomic_type", "u4"), ("element_size", "u4"), ("rows", "u4"),
+      ("cols", "u4"), ("offset", "u8")])
+  h = np.fromfile(path, header, 1)[0]
+  cols = np.fromfile(path, column, h["num_columns"], offset=header.itemsize)
+  c = cols[0]
+  values = np.memmap(path, "f8", "r", int(c["offset"]),
+      (h["num_chains"], h["num_draws"], c["rows"], c["cols"]))
+
+Only supported on POSIX systems; the constructors throw elsewhere.
+*/
+struct SampleStoreHeader {
+  char magic[8]; // "BMGSTORE"
+  std::uint32_t version;
+  std::uint32_t num_columns;
+  std::uint32_t num_chains;
+  std::uint32_t reserved;
+  std::uint64_t num_draws; // the number of draws each chain has room for
+};
+
+struct SampleStoreColumn {
+  // the queried node, or LOG_PROB_COLUMN
+  std::uint32_t node_id;
+  std::uint32_t variable_type;
+  std::uint32_t atomic_type;
+  std::uint32_t element_size;
+  std::uint32_t rows;
+  std::uint32_t cols;
+  // of the column data from the start of the file
+  std::uint64_t offset;
+
+  static const std::uint32_t LOG_PROB_COLUMN = 0xffffffff;
+};
+
+class SampleStoreWriter {
+ public:
+  /*
+  Create (or truncate) the file at path with room for num_draws draws of
+  each chain.
+
+  :param query_types: The value type of each query.
+  :param keep_log_prob: Whether the store has a log prob column.
+  */
+  SampleStoreWriter(
+      const std::string& path,
+      const std::vector<uint>& queries,
+      const std::vector<ValueType>& query_types,
+      uint num_chains,
+      std::size_t num_draws,
+      bool keep_log_prob);
+  ~SampleStoreWriter();
+  SampleStoreWriter(const SampleStoreWriter&) = delete;
+  SampleStoreWriter& operator=(const SampleStoreWriter&) = delete;
+
+  // Writes the next draw of a chain. Each chain must have a single writer,
+  // but different chains may be written concurrently, also from processes
+  // forked after the store was created.
+  void append(uint chain, const std::vector<NodeValue>& sample);
+  // Writes the log prob of the next draw of a chain.
+  void append_log_prob(uint chain, double log_prob);
+
+ private:
+  std::size_t mapped_size;
+  char* data;
+  SampleStoreHeader* header;
+  SampleStoreColumn* columns;
+  std::uint64_t* draws_written;
+  // log probs are counted apart from the samples, in this process only
+  std::vector<std::uint64_t> log_probs_written;
+};
+
+class SampleStoreReader {
+ public:
+  // Maps the file read-only, throwing std::runtime_error if it is not a
+  // valid sample store.
+  explicit SampleStoreReader(const std::string& path);
+  ~SampleStoreReader();
+  SampleStoreReader(const SampleStoreReader&) = delete;
+  SampleStoreReader& operator=(const SampleStoreReader&) = delete;
+
+  uint num_chains() const {
+    return header->num_chains;
+  }
+  uint num_queries() const {
+    return num_query_columns;
+  }
+  const SampleStoreColumn& query_column(uint query) const {
+    return columns[query];
+  }
+  // The number of draws written by a chain.
+  std::size_t num_draws(uint chain) const {
+    return draws_written[chain];
+  }
+  // A view of the draws of a chain of the given query, see the layout above.
+  const void* query_data(uint query, uint chain) const;
+  NodeValue value(uint query, uint chain, std::size_t draw) const;
+  // The log probs of the draws of a chain, or nullptr if they were not kept.
+  const double* log_probs(uint chain) const;
+
+ private:
+  std::size_t mapped_size;
+  const char* data;
+  const SampleStoreHeader* header;
+  const SampleStoreColumn* columns;
+  const std::uint64_t* draws_written;
+  uint num_query_columns;
+};
+
+} // namespace graph
+} // namespace beanmachine
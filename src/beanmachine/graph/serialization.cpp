@@ -0,0 +1,341 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#include "beanmachine/graph/distribution/distribution.h"
+#include "beanmachine/graph/factor/factor.h"
+#include "beanmachine/graph/operator/operator.h"
+#include "beanmachine/graph/serialization.h"
+
+namespace beanmachine {
+namespace graph {
+
+namespace {
+
+const int FORMAT_VERSION = 1;
+
+void write_value_type(const ValueType& type, std::ostream& os) {
+  os << static_cast<int>(type.variable_type) << " "
+     << static_cast<int>(type.atomic_type) << " " << type.rows << " "
+     << type.cols;
+}
+
+// Streams write infinities and NaNs in a form they cannot read back, so
+// these are written as the tokens inf, -inf and nan.
+void write_double(double value, std::ostream& os) {
+  if (std::isnan(value)) {
+    os << "nan";
+  } else if (std::isinf(value)) {
+    os << (value > 0 ? "inf" : "-inf");
+  } else {
+    os << value;
+  }
+}
+
+void write_value(const NodeValue& value, std::ostream& os) {
+  write_value_type(value.type, os);
+  if (value.type.variable_type == VariableType::SCALAR) {
+    switch (value.type.atomic_type) {
+      case AtomicType::BOOLEAN:
+        os << " " << value._bool;
+        break;
+      case AtomicType::NATURAL:
+        os << " " << value._natural;
+        break;
+      case AtomicType::REAL:
+      case AtomicType::POS_REAL:
+      case AtomicType::NEG_REAL:
+      case AtomicType::PROBABILITY:
+        os << " ";
+        write_double(value._double, os);
+        break;
+      default:
+        throw std::invalid_argument(
+            "cannot serialize a value of type " + value.type.to_string());
+    }
+    return;
+  }
+  // matrices are written in column-major order
+  uint size = value.type.rows * value.type.cols;
+  switch (value.type.atomic_type) {
+    case AtomicType::BOOLEAN:
+      for (uint i = 0; i < size; i++) {
+        os << " " << value._bmatrix(i);
+      }
+      break;
+    case AtomicType::NATURAL:
+      for (uint i = 0; i < size; i++) {
+        os << " " << value._nmatrix(i);
+      }
+      break;
+    case AtomicType::REAL:
+    case AtomicType::POS_REAL:
+    case AtomicType::NEG_REAL:
+    case AtomicType::PROBABILITY:
+      for (uint i = 0; i < size; i++) {
+        os << " ";
+        write_double(value._matrix(i), os);
+      }
+      break;
+    default:
+      throw std::invalid_argument(
+          "cannot serialize a value of type " + value.type.to_string());
+  }
+}
+
+void write_parents(const Node* node, std::ostream& os) {
+  os << " " << node->in_nodes.size();
+  for (const Node* parent : node->in_nodes) {
+    os << " " << parent->index;
+  }
+}
+
+// Reads the next field of a record, naming it in the error if it is missing.
+template <typename T>
+T read_field(std::istream& is, const char* what) {
+  T field;
+  if (not(is >> field)) {
+    throw std::invalid_argument(
+        std::string("malformed graph file: expected ") + what);
+  }
+  return field;
+}
+
+double read_double(std::istream& is) {
+  std::string token = read_field<std::string>(is, "a double");
+  if (token == "inf") {
+    return std::numeric_limits<double>::infinity();
+  } else if (token == "-inf") {
+    return -std::numeric_limits<double>::infinity();
+  } else if (token == "nan") {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  char* end = nullptr;
+  double value = std::strtod(token.c_str(), &end);
+  if (token.empty() or *end != '\0' or not std::isfinite(value)) {
+    throw std::invalid_argument(
+        "malformed graph file: expected a double, got " + token);
+  }
+  return value;
+}
+
+ValueType read_value_type(std::istream& is) {
+  auto variable_type =
+      static_cast<VariableType>(read_field<int>(is, "a variable type"));
+  auto atomic_type =
+      static_cast<AtomicType>(read_field<int>(is, "an atomic type"));
+  uint rows = read_field<uint>(is, "a row count");
+  uint cols = read_field<uint>(is, "a column count");
+  if (variable_type == VariableType::SCALAR) {
+    return ValueType(atomic_type);
+  }
+  if (variable_type == VariableType::COL_SIMPLEX_MATRIX and
+      atomic_type != AtomicType::PROBABILITY) {
+    throw std::invalid_argument(
+        "malformed graph file: a simplex must be of probabilities");
+  }
+  return ValueType(variable_type, atomic_type, rows, cols);
+}
+
+NodeValue read_value(std::istream& is) {
+  ValueType type = read_value_type(is);
+  if (type.variable_type == VariableType::SCALAR) {
+    switch (type.atomic_type) {
+      case AtomicType::BOOLEAN:
+        return NodeValue(read_field<bool>(is, "a boolean"));
+      case AtomicType::NATURAL:
+        return NodeValue(read_field<natural_t>(is, "a natural"));
+      case AtomicType::REAL:
+      case AtomicType::POS_REAL:
+      case AtomicType::NEG_REAL:
+      case AtomicType::PROBABILITY:
+        return NodeValue(type.atomic_type, read_double(is));
+      default:
+        throw std::invalid_argument(
+            "malformed graph file: unsupported value type " +
+            type.to_string());
+    }
+  }
+  if (type.variable_type != VariableType::BROADCAST_MATRIX and
+      type.variable_type != VariableType::COL_SIMPLEX_MATRIX) {
+    throw std::invalid_argument(
+        "malformed graph file: unsupported value type " + type.to_string());
+  }
+  switch (type.atomic_type) {
+    case AtomicType::BOOLEAN: {
+      Eigen::MatrixXb matrix(type.rows, type.cols);
+      for (uint i = 0; i < matrix.size(); i++) {
+        matrix(i) = read_field<bool>(is, "a boolean");
+      }
+      return NodeValue(type, matrix);
+    }
+    case AtomicType::NATURAL: {
+      Eigen::MatrixXn matrix(type.rows, type.cols);
+      for (uint i = 0; i < matrix.size(); i++) {
+        matrix(i) = read_field<natural_t>(is, "a natural");
+      }
+      return NodeValue(type, matrix);
+    }
+    case AtomicType::REAL:
+    case AtomicType::POS_REAL:
+    case AtomicType::NEG_REAL:
+    case AtomicType::PROBABILITY: {
+      Eigen::MatrixXd matrix(type.rows, type.cols);
+      for (uint i = 0; i < matrix.size(); i++) {
+        matrix(i) = read_double(is);
+      }
+      return NodeValue(type, matrix);
+    }
+    default:
+      throw std::invalid_argument(
+          "malformed graph file: unsupported value type " + type.to_string());
+  }
+}
+
+std::vector<uint> read_parents(std::istream& is) {
+  uint num_parents = read_field<uint>(is, "a parent count");
+  std::vector<uint> parents;
+  parents.reserve(num_parents);
+  for (uint i = 0; i < num_parents; i++) {
+    parents.push_back(read_field<uint>(is, "a parent id"));
+  }
+  return parents;
+}
+
+} // namespace
+
+void write_graph(const Graph& graph, std::ostream& os) {
+  std::ios_base::fmtflags flags = os.flags();
+  std::streamsize precision = os.precision();
+  os.precision(std::numeric_limits<double>::max_digits10);
+  os << "bmg " << FORMAT_VERSION << std::endl;
+  for (auto const& node : graph.nodes) {
+    switch (node->node_type) {
+      case NodeType::CONSTANT:
+        os << "constant ";
+        write_value(node->value, os);
+        break;
+      case NodeType::DISTRIBUTION: {
+        auto dist = static_cast<const distribution::Distribution*>(node.get());
+        os << "distribution " << static_cast<int>(dist->dist_type) << " ";
+        write_value_type(dist->sample_type, os);
+        write_parents(dist, os);
+        break;
+      }
+      case NodeType::OPERATOR: {
+        auto op = static_cast<const oper::Operator*>(node.get());
+        os << "operator " << static_cast<int>(op->op_type);
+        write_parents(op, os);
+        break;
+      }
+      case NodeType::FACTOR: {
+        auto fac = static_cast<const factor::Factor*>(node.get());
+        os << "factor " << static_cast<int>(fac->fac_type);
+        write_parents(fac, os);
+        break;
+      }
+      default:
+        throw std::invalid_argument(
+            "cannot serialize node " + std::to_string(node->index));
+    }
+    os << std::endl;
+  }
+  for (uint node_id : graph.observed) {
+    // factors are observed by construction
+    const Node* node = graph.nodes[node_id].get();
+    if (node->node_type == NodeType::FACTOR) {
+      continue;
+    }
+    os << "observe " << node_id << " ";
+    write_value(node->value, os);
+    os << std::endl;
+  }
+  for (uint node_id : graph.queries) {
+    os << "query " << node_id << std::endl;
+  }
+  for (const auto& [name, node_id] : graph.data_slots) {
+    if (name.empty() or name.find_first_of(" \t\r\n") != std::string::npos) {
+      throw std::invalid_argument("cannot serialize data slot " + name);
+    }
+    os << "slot " << name << " " << node_id << std::endl;
+  }
+  os.flags(flags);
+  os.precision(precision);
+}
+
+std::string serialize_graph(const Graph& graph) {
+  std::ostringstream os;
+  write_graph(graph, os);
+  return os.str();
+}
+
+std::unique_ptr<Graph> read_graph(std::istream& is) {
+  std::string header;
+  int version = 0;
+  if (not(is >> header >> version) or header != "bmg") {
+    throw std::invalid_argument("malformed graph file: missing bmg header");
+  }
+  if (version != FORMAT_VERSION) {
+    throw std::invalid_argument(
+        "unsupported graph file version " + std::to_string(version));
+  }
+  auto graph = std::make_unique<Graph>();
+  std::string line;
+  while (std::getline(is, line)) {
+    std::istringstream record(line);
+    std::string kind;
+    if (not(record >> kind) or kind[0] == '#') {
+      continue;
+    }
+    if (kind == "constant") {
+      graph->add_constant(read_value(record));
+    } else if (kind == "distribution") {
+      auto dist_type = static_cast<DistributionType>(
+          read_field<int>(record, "a distribution type"));
+      ValueType sample_type = read_value_type(record);
+      graph->add_distribution(dist_type, sample_type, read_parents(record));
+    } else if (kind == "operator") {
+      auto op_type =
+          static_cast<OperatorType>(read_field<int>(record, "an operator"));
+      graph->add_operator(op_type, read_parents(record));
+    } else if (kind == "factor") {
+      auto fac_type =
+          static_cast<FactorType>(read_field<int>(record, "a factor type"));
+      graph->add_factor(fac_type, read_parents(record));
+    } else if (kind == "observe") {
+      uint node_id = read_field<uint>(record, "a node id");
+      graph->observe(node_id, read_value(record));
+    } else if (kind == "query") {
+      graph->query(read_field<uint>(record, "a node id"));
+    } else if (kind == "slot") {
+      auto name = read_field<std::string>(record, "a slot name");
+      graph->add_data_slot(name, read_field<uint>(record, "a node id"));
+    } else {
+      throw std::invalid_argument(
+          "malformed graph file: unknown record " + kind);
+    }
+    std::string extra;
+    if (record >> extra) {
+      throw std::invalid_argument(
+          "malformed graph file: trailing input in line: " + line);
+    }
+  }
+  return graph;
+}
+
+std::unique_ptr<Graph> deserialize_graph(const std::string& text) {
+  std::istringstream is(text);
+  return read_graph(is);
+}
+
+} // namespace graph
+} // namespace beanmachine
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+
+#include "beanmachine/graph/graph.h"
+
+namespace beanmachine {
+namespace graph {
+
+/*
+A line-based text format for a graph together with its observations and
+queries, so that a graph built once (e.g. by the Python compiler) can be
+loaded again without rebuilding it, for instance by the bmg_run command-line
+runner. The file starts with a "bmg <version>" header followed by one record
+per line, where nodes appear in index order:
+
+  constant <value>
+  distribution <DistributionType> <sample ValueType> <n> <parent ids...>
+  operator <OperatorType> <n> <parent ids...>
+  factor <FactorType> <n> <parent ids...>
+  observe <node id> <value>
+  query <node id>
+  slot <name> <node id>
+
+Enums are written as their integer values. A ValueType is written as
+"<VariableType> <AtomicType> <rows> <cols>" and a value as its ValueType
+followed by its elements in column-major order (a single element for
+scalars). Doubles are written with enough digits to round trip exactly,
+and infinities and NaNs as inf, -inf and nan.
+Slot names (see Graph::add_data_slot) may not contain whitespace. Lines
+starting with '#' are comments.
+*/
+void write_graph(const Graph& graph, std::ostream& os);
+std::string serialize_graph(const Graph& graph);
+
+/*
+Rebuild a graph written by write_graph. Nodes, observations and queries are
+added through the public Graph API, so an invalid graph is reported by the
+same exceptions as building it directly; a malformed line throws
+std::invalid_argument.
+*/
+std::unique_ptr<Graph> read_graph(std::istream& is);
+std::unique_ptr<Graph> deserialize_graph(const std::string& text);
+
+} // namespace graph
+} // namespace beanmachine
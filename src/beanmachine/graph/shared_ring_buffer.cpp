@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#include "beanmachine/graph/shared_ring_buffer.h"
+
+namespace beanmachine {
+namespace graph {
+
+SharedRingBuffer::SharedRingBuffer(std::size_t capacity)
+    : capacity(capacity),
+      mapped_size(sizeof(Header) + capacity),
+      header(nullptr),
+      data(nullptr) {
+#ifdef _WIN32
+  throw std::runtime_error(
+      "shared memory sample streams are not supported on this platform");
+#else
+  static_assert(
+      std::atomic<std::uint64_t>::is_always_lock_free,
+      "the ring buffer positions are shared across processes");
+  void* memory = mmap(
+      nullptr,
+      mapped_size,
+      PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_ANONYMOUS,
+      -1,
+      0);
+  if (memory == MAP_FAILED) {
+    throw std::runtime_error("failed to map shared memory for a ring buffer");
+  }
+  header = new (memory) Header();
+  header->read_position.store(0);
+  header->write_position.store(0);
+  data = static_cast<char*>(memory) + sizeof(Header);
+#endif
+}
+
+SharedRingBuffer::~SharedRingBuffer() {
+#ifndef _WIN32
+  if (header != nullptr) {
+    header->~Header();
+    munmap(header, mapped_size);
+  }
+#endif
+}
+
+void SharedRingBuffer::write(const char* bytes, std::size_t size) {
+  while (size > 0) {
+    std::uint64_t write_position =
+        header->write_position.load(std::memory_order_relaxed);
+    std::uint64_t read_position =
+        header->read_position.load(std::memory_order_acquire);
+    std::size_t available =
+        capacity - static_cast<std::size_t>(write_position - read_position);
+    if (available == 0) {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+      continue;
+    }
+    std::size_t count = std::min(size, available);
+    std::size_t offset = static_cast<std::size_t>(write_position % capacity);
+    std::size_t first = std::min(count, capacity - offset);
+    std::memcpy(data + offset, bytes, first);
+    std::memcpy(data, bytes + first, count - first);
+    header->write_position.store(
+        write_position + count, std::memory_order_release);
+    bytes += count;
+    size -= count;
+  }
+}
+
+std::size_t SharedRingBuffer::read(std::vector<char>& out) {
+  std::uint64_t read_position =
+      header->read_position.load(std::memory_order_relaxed);
+  std::uint64_t write_position =
+      header->write_position.load(std::memory_order_acquire);
+  std::size_t count = static_cast<std::size_t>(write_position - read_position);
+  if (count == 0) {
+    return 0;
+  }
+  std::size_t offset = static_cast<std::size_t>(read_position % capacity);
+  std::size_t first = std::min(count, capacity - offset);
+  out.insert(out.end(), data + offset, data + offset + first);
+  out.insert(out.end(), data, data + (count - first));
+  header->read_position.store(
+      read_position + count, std::memory_order_release);
+  return count;
+}
+
+} // namespace graph
+} // namespace beanmachine
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace beanmachine {
+namespace graph {
+
+/*
+A single-producer single-consumer byte stream through an anonymous shared
+memory mapping, which stays shared with the processes forked after its
+creation. Used to stream the samples of chains run in worker processes back
+to the parent (see InferConfig::use_processes). Only supported on POSIX
+systems; the constructor throws elsewhere.
+*/
+class SharedRingBuffer {
+ public:
+  explicit SharedRingBuffer(std::size_t capacity);
+  ~SharedRingBuffer();
+  SharedRingBuffer(const SharedRingBuffer&) = delete;
+  SharedRingBuffer& operator=(const SharedRingBuffer&) = delete;
+
+  // Appends size bytes, waiting for the reader whenever the buffer is full.
+  void write(const char* bytes, std::size_t size);
+  // Appends all the bytes written so far and not yet read to out.
+  // :returns: The number of bytes read.
+  std::size_t read(std::vector<char>& out);
+
+ private:
+  struct Header {
+    // total number of bytes read and written, so that the buffer holds
+    // write_position - read_position bytes
+    std::atomic<std::uint64_t> read_position;
+    std::atomic<std::uint64_t> write_position;
+  };
+
+  std::size_t capacity;
+  std::size_t mapped_size;
+  Header* header;
+  char* data;
+};
+
+} // namespace graph
+} // namespace beanmachine
@@ -8,6 +8,7 @@
 #include <algorithm>
 #include <cmath>
 #include <random>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -60,30 +61,45 @@ void DefaultSingleSiteSteppingMethod::step(Node* tgt_node) {
   //   are factorized and the remaining stochastic nodes have
   //   their probabilities unchanged and cancel out.
   // * If we rejected it, restore the saved state.
+  //
+  // With delayed acceptance, the proposal must first pass a screen based on
+  // a cheap surrogate ratio r1, and the final test above then uses the
+  // acceptance ratio divided by r1. Since both factors satisfy
+  // r(x, y) = 1 / r(y, x), the product of the two acceptance probabilities
+  // still satisfies detailed balance (Christen and Fox, 2005;
+  // Banterle et al., 2015).
 
   auto proposal_given_old_value = get_proposal_distribution(tgt_node);
 
   NodeValue new_value = mh->sample(proposal_given_old_value);
 
-  graph->revertibly_set_and_propagate(tgt_node, new_value);
-
-  double new_sto_affected_nodes_log_prob =
-      graph->compute_log_prob_of(graph->get_sto_affected_nodes(tgt_node));
-
-  auto proposal_given_new_value = get_proposal_distribution(tgt_node);
-
-  NodeValue& old_value = graph->get_old_value(tgt_node);
-  double old_sto_affected_nodes_log_prob =
-      graph->get_old_sto_affected_nodes_log_prob();
-
-  double logacc = new_sto_affected_nodes_log_prob -
-      old_sto_affected_nodes_log_prob +
-      proposal_given_new_value->log_prob(old_value) -
-      proposal_given_old_value->log_prob(new_value);
-
-  bool accepted = util::flip_coin_with_log_prob(mh->gen, logacc);
-  if (!accepted) {
-    graph->revert_set_and_propagate(tgt_node);
+  double surrogate_log_ratio;
+  if (passes_delayed_acceptance_screen(
+          tgt_node, new_value, surrogate_log_ratio)) {
+    graph->revertibly_set_and_propagate(tgt_node, new_value);
+
+    double new_sto_affected_nodes_log_prob =
+        graph->compute_log_prob_of(graph->get_sto_affected_nodes(tgt_node));
+
+    auto proposal_given_new_value = get_proposal_distribution(tgt_node);
+
+    NodeValue& old_value = graph->get_old_value(tgt_node);
+    double old_sto_affected_nodes_log_prob =
+        graph->get_old_sto_affected_nodes_log_prob();
+
+    double logacc = new_sto_affected_nodes_log_prob -
+        old_sto_affected_nodes_log_prob +
+        proposal_given_new_value->log_prob(old_value) -
+        proposal_given_old_value->log_prob(new_value) - surrogate_log_ratio;
+
+    bool accepted = util::flip_coin_with_log_prob(mh->gen, logacc);
+    if (accepted) {
+      graph->add_to_tracked_log_prob(
+          tgt_node,
+          new_sto_affected_nodes_log_prob - old_sto_affected_nodes_log_prob);
+    } else {
+      graph->revert_set_and_propagate(tgt_node);
+    }
   }
 
   // Gradients must be cleared (equal to 0)
@@ -105,5 +121,89 @@ void DefaultSingleSiteSteppingMethod::step(Node* tgt_node) {
   graph->pd_finish(get_step_profiler_event());
 }
 
+// The surrogate is an estimate of the log prob of the stochastic affected
+// nodes from the target node itself plus a random subset of the others,
+// drawn with replacement and scaled up to their total number. The subset is
+// drawn independently of the current and proposed values, so the surrogate
+// is a fixed function of the state for each step, as delayed acceptance
+// requires. Only the deterministic nodes the subset depends on are
+// evaluated for the proposed value.
+bool DefaultSingleSiteSteppingMethod::passes_delayed_acceptance_screen(
+    Node* tgt_node,
+    const NodeValue& new_value,
+    double& surrogate_log_ratio) {
+  surrogate_log_ratio = 0;
+  auto graph = mh->graph;
+  uint subset_size = mh->infer_config.delayed_acceptance_subset_size;
+  const std::vector<Node*>& sto_nodes = graph->get_sto_affected_nodes(tgt_node);
+  // sto_nodes includes the target node itself
+  if (subset_size == 0 or sto_nodes.size() <= subset_size + 1) {
+    return true;
+  }
+
+  std::vector<Node*> subset;
+  subset.reserve(subset_size);
+  std::uniform_int_distribution<size_t> pick(0, sto_nodes.size() - 1);
+  while (subset.size() < subset_size) {
+    Node* node = sto_nodes[pick(mh->gen)];
+    if (node != tgt_node) {
+      subset.push_back(node);
+    }
+  }
+  double scale = static_cast<double>(sto_nodes.size() - 1) /
+      static_cast<double>(subset_size);
+
+  // Collect the deterministic affected nodes that the subset depends on,
+  // going through distributions which are not in the support.
+  const std::vector<Node*>& det_nodes = graph->get_det_affected_nodes(tgt_node);
+  auto is_det_affected = [&](Node* node) {
+    auto it = std::lower_bound(
+        det_nodes.begin(), det_nodes.end(), node, [](Node* a, Node* b) {
+          return a->index < b->index;
+        });
+    return it != det_nodes.end() and *it == node;
+  };
+  std::set<uint> visited;
+  std::vector<Node*> subset_det_nodes;
+  std::vector<Node*> to_visit(subset.begin(), subset.end());
+  while (not to_visit.empty()) {
+    Node* node = to_visit.back();
+    to_visit.pop_back();
+    for (Node* in_node : node->in_nodes) {
+      bool is_distribution = in_node->node_type == NodeType::DISTRIBUTION;
+      if ((is_distribution or is_det_affected(in_node)) and
+          visited.insert(in_node->index).second) {
+        if (not is_distribution) {
+          subset_det_nodes.push_back(in_node);
+        }
+        to_visit.push_back(in_node);
+      }
+    }
+  }
+  std::sort(
+      subset_det_nodes.begin(), subset_det_nodes.end(), [](Node* a, Node* b) {
+        return a->index < b->index;
+      });
+
+  auto surrogate_log_prob = [&]() {
+    double log_prob = 0;
+    for (Node* node : subset) {
+      log_prob += node->log_prob();
+    }
+    return tgt_node->log_prob() + scale * log_prob;
+  };
+  double old_log_prob = surrogate_log_prob();
+  graph->save_old_value(tgt_node);
+  graph->save_old_values(subset_det_nodes);
+  tgt_node->value = new_value;
+  graph->eval(subset_det_nodes);
+  double new_log_prob = surrogate_log_prob();
+  graph->restore_old_value(tgt_node);
+  graph->restore_old_values(subset_det_nodes);
+
+  surrogate_log_ratio = new_log_prob - old_log_prob;
+  return util::flip_coin_with_log_prob(mh->gen, surrogate_log_ratio);
+}
+
 } // namespace graph
 } // namespace beanmachine
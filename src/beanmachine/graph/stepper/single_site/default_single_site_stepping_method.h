@@ -36,6 +36,17 @@ class DefaultSingleSiteSteppingMethod : public SingleSiteSteppingMethod {
       Node* tgt_node) = 0;
 
   virtual ProfilerEvent get_step_profiler_event() = 0;
+
+  // First stage of delayed acceptance (see
+  // InferConfig::delayed_acceptance_subset_size). Accepts or rejects
+  // new_value based on a surrogate of the log prob of the target's
+  // stochastic affected nodes, leaving the graph unchanged.
+  // `surrogate_log_ratio` receives the surrogate log acceptance ratio, which
+  // the second stage must divide out (it is 0 if no screening took place).
+  bool passes_delayed_acceptance_screen(
+      Node* tgt_node,
+      const NodeValue& new_value,
+      double& surrogate_log_ratio);
 };
 
 } // namespace graph
@@ -93,7 +93,10 @@ void NMCDirichletGammaSingleSiteSteppingMethod::step(Node* tgt_node) {
 
     // decide acceptance
     bool accepted = util::flip_coin_with_log_prob(mh->gen, logacc);
-    if (!accepted) {
+    if (accepted) {
+      // the log probs above are of the gamma variables, not of the graph
+      graph->reset_tracked_log_prob();
+    } else {
       // revert
       graph->restore_old_values(det_affected_nodes);
       *(sto_tgt_node->unconstrained_value._matrix.data() + k) = old_x_k;
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "beanmachine/graph/batch_infer.h"
+#include "beanmachine/graph/graph.h"
+
+using namespace beanmachine::graph;
+
+// p ~ Beta(2, 2); k ~ Binomial(10, p) observed; queries p
+static std::unique_ptr<Graph> build_beta_binomial(natural_t k_obs) {
+  auto g = std::make_unique<Graph>();
+  uint two = g->add_constant_pos_real(2.0);
+  uint n = g->add_constant((natural_t)10);
+  uint beta = g->add_distribution(
+      DistributionType::BETA,
+      AtomicType::PROBABILITY,
+      std::vector<uint>{two, two});
+  uint p = g->add_operator(OperatorType::SAMPLE, {beta});
+  uint binomial = g->add_distribution(
+      DistributionType::BINOMIAL,
+      AtomicType::NATURAL,
+      std::vector<uint>{n, p});
+  uint k = g->add_operator(OperatorType::SAMPLE, {binomial});
+  g->observe(k, k_obs);
+  g->query(p);
+  return g;
+}
+
+TEST(testbatchinfer, matches_infer) {
+  uint num_graphs = 12;
+  uint num_samples = 40;
+  InferConfig config;
+  config.keep_log_prob = true;
+  std::vector<std::unique_ptr<Graph>> graphs;
+  std::vector<BatchInferJob> jobs;
+  for (uint i = 0; i < num_graphs; i++) {
+    graphs.push_back(build_beta_binomial(i % 11));
+    jobs.emplace_back(
+        graphs.back().get(),
+        num_samples,
+        i % 3 == 0 ? InferenceType::REJECTION : InferenceType::NMC,
+        7 + i,
+        1 + i % 3,
+        config);
+  }
+  // a job without queries fails without affecting the others
+  Graph unqueried;
+  unqueried.add_constant(1.0);
+  jobs.emplace_back(&unqueried, num_samples, InferenceType::NMC, 1, 2);
+  jobs.emplace_back(graphs[0].get(), num_samples, InferenceType::NMC, 1, 0);
+  std::vector<BatchInferJob> invalid(jobs.end() - 1, jobs.end());
+  jobs.pop_back();
+
+  // the progress bar settings of the graphs are kept
+  graphs[1]->show_progress = false;
+  infer_batch(jobs, 3);
+  infer_batch(invalid, 3);
+  EXPECT_FALSE(jobs.back().error.empty());
+  EXPECT_FALSE(invalid[0].error.empty());
+  for (uint i = 0; i < num_graphs; i++) {
+    const BatchInferJob& job = jobs[i];
+    EXPECT_TRUE(job.error.empty()) << job.error;
+    auto expected_graph = build_beta_binomial(i % 11);
+    auto& expected = expected_graph->infer(
+        num_samples, job.algorithm, job.seed, job.n_chains, config);
+    auto& samples = job.graph->samples_allchains;
+    ASSERT_EQ(samples.size(), job.n_chains);
+    for (uint chain = 0; chain < job.n_chains; chain++) {
+      ASSERT_EQ(samples[chain].size(), num_samples);
+      for (uint s = 0; s < num_samples; s++) {
+        EXPECT_EQ(samples[chain][s][0]._double, expected[chain][s][0]._double);
+      }
+    }
+    EXPECT_EQ(job.graph->get_log_prob(), expected_graph->get_log_prob());
+    EXPECT_EQ(job.graph->master_graph, nullptr);
+    EXPECT_EQ(job.graph->show_progress, i != 1);
+  }
+
+  // a second job of the same graph fails, since their chains would race
+  std::vector<BatchInferJob> duplicates;
+  duplicates.emplace_back(graphs[0].get(), num_samples, InferenceType::NMC, 1);
+  duplicates.emplace_back(graphs[0].get(), num_samples, InferenceType::NMC, 2);
+  infer_batch(duplicates, 2);
+  EXPECT_TRUE(duplicates[0].error.empty()) << duplicates[0].error;
+  EXPECT_FALSE(duplicates[1].error.empty());
+  EXPECT_EQ(graphs[0]->samples_allchains.size(), 1u);
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "beanmachine/graph/graph.h"
+#include "beanmachine/graph/serialization.h"
+
+using namespace beanmachine::graph;
+
+// x ~ Normal(mu[0] + mu[1], 1); y ~ Normal(x, 1) observed; queries x
+static std::unique_ptr<Graph>
+build_slot_model(const Eigen::MatrixXd& mu, double y, bool with_slots) {
+  auto g = std::make_unique<Graph>();
+  Eigen::MatrixXd mu_value = mu;
+  uint mu_node = g->add_constant_real_matrix(mu_value);
+  uint one = g->add_constant_pos_real(1.0);
+  uint first = g->add_constant((natural_t)0);
+  uint second = g->add_constant((natural_t)1);
+  uint mean = g->add_operator(
+      OperatorType::ADD,
+      {g->add_operator(OperatorType::INDEX, {mu_node, first}),
+       g->add_operator(OperatorType::INDEX, {mu_node, second})});
+  uint prior = g->add_distribution(
+      DistributionType::NORMAL,
+      AtomicType::REAL,
+      std::vector<uint>{mean, one});
+  uint x = g->add_operator(OperatorType::SAMPLE, {prior});
+  uint likelihood = g->add_distribution(
+      DistributionType::NORMAL, AtomicType::REAL, std::vector<uint>{x, one});
+  uint y_node = g->add_operator(OperatorType::SAMPLE, {likelihood});
+  g->observe(y_node, y);
+  g->query(x);
+  if (with_slots) {
+    g->add_data_slot("mu", mu_node);
+    g->add_data_slot("y", y_node);
+  }
+  return g;
+}
+
+TEST(testdataslot, rebind) {
+  Eigen::MatrixXd mu1(2, 1), mu2(2, 1);
+  mu1 << 0.5, -0.2;
+  mu2 << 2.0, 1.5;
+  auto g = build_slot_model(mu1, 0.3, true);
+  EXPECT_EQ(g->get_data_slots().size(), 2);
+  g->infer(20, InferenceType::NMC, 31);
+
+  // a rebound graph infers like a graph built with the new data
+  g->bind_data_slot("mu", mu2.data(), mu2.size());
+  g->bind_data_slot("y", NodeValue(AtomicType::REAL, 4.25));
+  auto expected_graph = build_slot_model(mu2, 4.25, false);
+  auto& samples = g->infer(20, InferenceType::NMC, 31);
+  auto& expected = expected_graph->infer(20, InferenceType::NMC, 31);
+  ASSERT_EQ(samples.size(), expected.size());
+  for (uint i = 0; i < samples.size(); i++) {
+    EXPECT_EQ(samples[i][0]._double, expected[i][0]._double);
+  }
+  // both graphs are left in the state of their last sample
+  EXPECT_EQ(g->full_log_prob(), expected_graph->full_log_prob());
+
+  // slots survive copies and serialization
+  Graph copy(*g);
+  EXPECT_EQ(copy.get_data_slots(), g->get_data_slots());
+  auto loaded = deserialize_graph(serialize_graph(*g));
+  EXPECT_EQ(loaded->get_data_slots(), g->get_data_slots());
+  EXPECT_EQ(
+      loaded->full_log_prob(),
+      build_slot_model(mu2, 4.25, false)->full_log_prob());
+
+  // removing the observations removes their slots
+  g->remove_observations();
+  EXPECT_EQ(g->get_data_slots().size(), 1);
+  EXPECT_EQ(g->get_data_slots().count("mu"), 1);
+}
+
+TEST(testdataslot, errors) {
+  Eigen::MatrixXd mu(2, 1);
+  mu << 0.5, -0.2;
+  auto g = build_slot_model(mu, 0.3, true);
+  uint x = g->queries[0];
+  // only constants and observations can be slots, with unique names
+  EXPECT_THROW(g->add_data_slot("x", x), std::invalid_argument);
+  EXPECT_THROW(g->add_data_slot("mu", 1), std::invalid_argument);
+  EXPECT_THROW(g->add_data_slot("bad", 100), std::out_of_range);
+  // values must match the type and size of the slot
+  EXPECT_THROW(
+      g->bind_data_slot("unknown", NodeValue(1.0)), std::invalid_argument);
+  EXPECT_THROW(
+      g->bind_data_slot("y", NodeValue(AtomicType::POS_REAL, 1.0)),
+      std::invalid_argument);
+  EXPECT_THROW(g->bind_data_slot("mu", mu.data(), 1), std::invalid_argument);
+  g->add_data_slot("n", 2);
+  double value = 2.0;
+  EXPECT_THROW(g->bind_data_slot("n", &value, 1), std::invalid_argument);
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "beanmachine/graph/double_matrix.h"
+
+using namespace beanmachine::graph;
+
+TEST(testdoublematrix, accumulate_expressions) {
+  Eigen::MatrixXd a(2, 2);
+  a << 1.0, 2.0, 3.0, 4.0;
+  Eigen::MatrixXd b(2, 2);
+  b << 0.5, -1.0, 2.0, 0.25;
+
+  DoubleMatrix dm(Eigen::MatrixXd::Zero(2, 2));
+  dm += (a.array() * b.array()).matrix();
+  dm -= 2.0 * a;
+  dm += a.array().square();
+  Eigen::MatrixXd expected =
+      (a.array() * b.array()).matrix() - 2.0 * a + a.array().square().matrix();
+  EXPECT_TRUE(dm.as_matrix().isApprox(expected));
+
+  DoubleMatrix scalar(1.0);
+  EXPECT_THROW(scalar += a.transpose(), DoubleMatrixError);
+  EXPECT_THROW(scalar -= a.transpose(), DoubleMatrixError);
+}
+
+TEST(testdoublematrix, lazy_products) {
+  Eigen::MatrixXd a(2, 3);
+  a << 1.0, 2.0, 3.0, 4.0, 5.0, 6.0;
+  Eigen::MatrixXd b(3, 2);
+  b << 0.5, -1.0, 2.0, 0.25, -0.75, 1.5;
+  DoubleMatrix dm_a(a);
+  DoubleMatrix dm_b(b);
+  DoubleMatrix two(2.0);
+
+  // products accumulated into a matrix, with the DoubleMatrix on either side
+  DoubleMatrix dm(Eigen::MatrixXd::Ones(2, 2));
+  dm += DoubleMatrix::times(dm_a, b);
+  dm -= DoubleMatrix::times(a, dm_b);
+  EXPECT_TRUE(dm.as_matrix().isApprox(Eigen::MatrixXd::Ones(2, 2)));
+  dm += DoubleMatrix::times(dm_a, b.transpose().transpose());
+  EXPECT_TRUE(dm.as_matrix().isApprox(Eigen::MatrixXd::Ones(2, 2) + a * b));
+
+  // a DoubleMatrix holding a double scales the matrix
+  DoubleMatrix scaled(Eigen::MatrixXd::Zero(3, 2));
+  scaled += DoubleMatrix::times(two, a.transpose());
+  scaled -= DoubleMatrix::times(a.transpose(), two);
+  scaled += DoubleMatrix::times(two, a.transpose());
+  EXPECT_TRUE(scaled.as_matrix().isApprox(2.0 * a.transpose()));
+
+  // evaluated when not accumulated
+  DoubleMatrix product = DoubleMatrix::times(dm_a, b);
+  EXPECT_TRUE(product.as_matrix().isApprox(a * b));
+  EXPECT_NEAR(
+      DoubleMatrix::times(dm_a, b).eval().as_matrix().sum(),
+      (a * b).sum(),
+      1e-12);
+}
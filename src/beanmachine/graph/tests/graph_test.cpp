@@ -341,6 +341,77 @@ TEST(testgraph, full_log_prob) {
   EXPECT_NEAR(g.full_log_prob(), -1.3344, 1e-3);
 }
 
+TEST(testgraph, tracked_log_prob) {
+  // The log probs kept by NMC and Gibbs are running sums; they must match
+  // full_log_prob of each sample, also across resynchronizations.
+  graph::Graph g;
+  uint zero = g.add_constant(0.0);
+  uint one = g.add_constant_pos_real(1.0);
+  uint two = g.add_constant(2.0);
+  uint prior = g.add_distribution(
+      graph::DistributionType::NORMAL,
+      graph::AtomicType::REAL,
+      std::vector<uint>({zero, one}));
+  uint x = g.add_operator(graph::OperatorType::SAMPLE, {prior});
+  uint x2 = g.add_operator(graph::OperatorType::MULTIPLY, {x, two});
+  uint z_dist = g.add_distribution(
+      graph::DistributionType::NORMAL,
+      graph::AtomicType::REAL,
+      std::vector<uint>({x2, one}));
+  uint z = g.add_operator(graph::OperatorType::SAMPLE, {z_dist});
+  uint y_dist = g.add_distribution(
+      graph::DistributionType::NORMAL,
+      graph::AtomicType::REAL,
+      std::vector<uint>({z, one}));
+  uint y1 = g.add_operator(graph::OperatorType::SAMPLE, {y_dist});
+  uint y2 = g.add_operator(graph::OperatorType::SAMPLE, {y_dist});
+  g.observe(y1, 0.5);
+  g.observe(y2, 1.5);
+  g.query(x);
+  g.query(z);
+  uint num_samples = 2500;
+  graph::InferConfig conf(true);
+  auto samples = g.infer(num_samples, graph::InferenceType::NMC, 11, 1, conf);
+  auto log_probs = g.get_log_prob();
+  for (uint i = 0; i < num_samples; i += 7) {
+    g.remove_observations();
+    g.observe(y1, 0.5);
+    g.observe(y2, 1.5);
+    g.observe(x, samples[0][i][0]._double);
+    g.observe(z, samples[0][i][1]._double);
+    EXPECT_NEAR(g.full_log_prob(), log_probs[0][i], 1e-9);
+  }
+
+  graph::Graph b;
+  uint p_low = b.add_constant_probability(0.2);
+  uint p_high = b.add_constant_probability(0.7);
+  uint bern = b.add_distribution(
+      graph::DistributionType::BERNOULLI,
+      graph::AtomicType::BOOLEAN,
+      std::vector<uint>({p_low}));
+  uint c1 = b.add_operator(graph::OperatorType::SAMPLE, {bern});
+  uint c2 = b.add_operator(graph::OperatorType::SAMPLE, {bern});
+  uint p =
+      b.add_operator(graph::OperatorType::IF_THEN_ELSE, {c1, p_high, p_low});
+  uint obs_dist = b.add_distribution(
+      graph::DistributionType::BERNOULLI,
+      graph::AtomicType::BOOLEAN,
+      std::vector<uint>({p}));
+  uint obs = b.add_operator(graph::OperatorType::SAMPLE, {obs_dist});
+  b.observe(obs, true);
+  b.query(c1);
+  b.query(c2);
+  samples = b.infer(num_samples, graph::InferenceType::GIBBS, 11, 1, conf);
+  log_probs = b.get_log_prob();
+  for (uint i = 0; i < num_samples; i += 7) {
+    b.remove_observations();
+    b.observe(obs, true);
+    b.observe(c1, samples[0][i][0]._bool);
+    b.observe(c2, samples[0][i][1]._bool);
+    EXPECT_NEAR(b.full_log_prob(), log_probs[0][i], 1e-9);
+  }
+}
+
 TEST(testgraph, bad_observations) {
   // Tests which demonstrate that we give errors for bad observations.
   Eigen::MatrixXb bool_matrix(1, 2);
@@ -452,3 +523,415 @@ TEST(testgraph, infer_runtime_error) {
       g.infer(num_samples, graph::InferenceType::NMC, seed, 2),
       std::runtime_error);
 }
+
+TEST(testgraph, branch_aware_eval) {
+  // c ~ Bernoulli(0.5); x ~ Normal(0, 1)
+  // y ~ Normal(if c then x * x else -x, 1), observed
+  graph::Graph g;
+  uint half = g.add_constant_probability(0.5);
+  uint zero = g.add_constant(0.0);
+  uint one = g.add_constant_pos_real(1.0);
+  uint bernoulli = g.add_distribution(
+      graph::DistributionType::BERNOULLI,
+      graph::AtomicType::BOOLEAN,
+      std::vector<uint>{half});
+  uint c = g.add_operator(graph::OperatorType::SAMPLE, {bernoulli});
+  uint normal = g.add_distribution(
+      graph::DistributionType::NORMAL,
+      graph::AtomicType::REAL,
+      std::vector<uint>{zero, one});
+  uint x = g.add_operator(graph::OperatorType::SAMPLE, {normal});
+  uint x_sq = g.add_operator(graph::OperatorType::MULTIPLY, {x, x});
+  uint neg_x = g.add_operator(graph::OperatorType::NEGATE, {x});
+  uint mu =
+      g.add_operator(graph::OperatorType::IF_THEN_ELSE, {c, x_sq, neg_x});
+  uint likelihood = g.add_distribution(
+      graph::DistributionType::NORMAL,
+      graph::AtomicType::REAL,
+      std::vector<uint>{mu, one});
+  uint y = g.add_operator(graph::OperatorType::SAMPLE, {likelihood});
+  g.observe(y, 0.5);
+  g.query(x);
+  g.query(c);
+
+  g.ensure_evaluation_and_inference_readiness();
+  EXPECT_TRUE(g.branch_only_by_node_id[x_sq]);
+  EXPECT_TRUE(g.branch_only_by_node_id[neg_x]);
+  EXPECT_FALSE(g.branch_only_by_node_id[mu]);
+
+  graph::Node* c_node = g.get_node(c);
+  graph::Node* x_node = g.get_node(x);
+  graph::Node* mu_node = g.get_node(mu);
+  c_node->value = graph::NodeValue(true);
+  x_node->value = graph::NodeValue(2.0);
+  std::mt19937 gen(1);
+  for (uint id : {x_sq, neg_x, mu}) {
+    g.get_node(id)->eval(gen);
+  }
+
+  // changing x only re-evaluates the selected branch
+  g.revertibly_set_and_propagate(x_node, graph::NodeValue(3.0));
+  EXPECT_EQ(mu_node->value._double, 9.0);
+  EXPECT_TRUE(g.stale_by_node_id[neg_x]);
+  EXPECT_FALSE(g.stale_by_node_id[x_sq]);
+
+  // flipping the condition brings the newly selected branch up to date
+  g.revertibly_set_and_propagate(c_node, graph::NodeValue(false));
+  EXPECT_EQ(mu_node->value._double, -3.0);
+  EXPECT_FALSE(g.stale_by_node_id[neg_x]);
+
+  // neg_x does not depend on c, so it stays up to date after reverting
+  g.revert_set_and_propagate(c_node);
+  EXPECT_EQ(mu_node->value._double, 9.0);
+  EXPECT_FALSE(g.stale_by_node_id[neg_x]);
+  EXPECT_EQ(g.get_node(neg_x)->value._double, -3.0);
+
+  // reverting a change of x restores the stale flag of the unselected branch
+  g.revertibly_set_and_propagate(x_node, graph::NodeValue(1.0));
+  EXPECT_EQ(mu_node->value._double, 1.0);
+  EXPECT_TRUE(g.stale_by_node_id[neg_x]);
+  g.revert_set_and_propagate(x_node);
+  EXPECT_EQ(mu_node->value._double, 9.0);
+  EXPECT_FALSE(g.stale_by_node_id[neg_x]);
+
+  // full log prob is unaffected by skipped branches
+  double log_prob = g.full_log_prob();
+  EXPECT_EQ(mu_node->value._double, 9.0);
+  EXPECT_NEAR(
+      log_prob,
+      std::log(0.5) - 0.5 * 9.0 - 0.5 * 8.5 * 8.5 - std::log(2 * M_PI),
+      1e-6);
+}
+
+TEST(testgraph, fixed_log_prob) {
+  // x ~ Normal(0, 1); s = 1 + 1
+  // y1, y2 ~ Normal(0, s), w ~ Normal(y1, 1), z ~ Normal(x + y1, 1) observed
+  graph::Graph g;
+  uint zero = g.add_constant(0.0);
+  uint one = g.add_constant_pos_real(1.0);
+  uint s = g.add_operator(graph::OperatorType::ADD, {one, one});
+  uint prior = g.add_distribution(
+      graph::DistributionType::NORMAL,
+      graph::AtomicType::REAL,
+      std::vector<uint>{zero, one});
+  uint x = g.add_operator(graph::OperatorType::SAMPLE, {prior});
+  uint fixed_normal = g.add_distribution(
+      graph::DistributionType::NORMAL,
+      graph::AtomicType::REAL,
+      std::vector<uint>{zero, s});
+  uint y1 = g.add_operator(graph::OperatorType::SAMPLE, {fixed_normal});
+  uint y2 = g.add_operator(graph::OperatorType::SAMPLE, {fixed_normal});
+  uint w_dist = g.add_distribution(
+      graph::DistributionType::NORMAL,
+      graph::AtomicType::REAL,
+      std::vector<uint>{y1, one});
+  uint w = g.add_operator(graph::OperatorType::SAMPLE, {w_dist});
+  uint mean = g.add_operator(graph::OperatorType::ADD, {x, y1});
+  uint likelihood = g.add_distribution(
+      graph::DistributionType::NORMAL,
+      graph::AtomicType::REAL,
+      std::vector<uint>{mean, one});
+  uint z = g.add_operator(graph::OperatorType::SAMPLE, {likelihood});
+  g.observe(y1, 1.5);
+  g.observe(y2, -1.0);
+  g.observe(w, 0.0);
+  g.observe(z, 0.5);
+  g.query(x);
+
+  g.ensure_evaluation_and_inference_readiness();
+  EXPECT_TRUE(g.fixed_by_node_id[s]);
+  EXPECT_TRUE(g.fixed_by_node_id[w_dist]);
+  EXPECT_FALSE(g.fixed_by_node_id[x]);
+  EXPECT_FALSE(g.fixed_by_node_id[mean]);
+  // y1, y2 and w are hoisted; z is observed but depends on x
+  auto visited = [&](uint node_id) {
+    return std::find(
+               g.non_fixed_supp.begin(),
+               g.non_fixed_supp.end(),
+               g.get_node(node_id)) != g.non_fixed_supp.end();
+  };
+  EXPECT_FALSE(visited(y1));
+  EXPECT_FALSE(visited(y2));
+  EXPECT_FALSE(visited(w));
+  EXPECT_FALSE(visited(s));
+  EXPECT_TRUE(visited(z));
+  EXPECT_TRUE(visited(x));
+
+  auto normal_log_prob = [](double value, double mu, double sigma) {
+    return -std::log(sigma) - 0.5 * std::log(2 * M_PI) -
+        0.5 * std::pow((value - mu) / sigma, 2);
+  };
+  g.get_node(x)->value = graph::NodeValue(0.3);
+  EXPECT_NEAR(
+      g.full_log_prob(),
+      normal_log_prob(0.3, 0, 1) + normal_log_prob(1.5, 0, 2) +
+          normal_log_prob(-1.0, 0, 2) + normal_log_prob(0.0, 1.5, 1) +
+          normal_log_prob(0.5, 1.8, 1),
+      1e-6);
+
+  // changing the observations recomputes the hoisted terms
+  g.remove_observations();
+  g.observe(y1, 0.5);
+  g.observe(y2, 2.0);
+  g.observe(w, 0.0);
+  g.observe(z, 0.5);
+  EXPECT_NEAR(
+      g.full_log_prob(),
+      normal_log_prob(0.3, 0, 1) + normal_log_prob(0.5, 0, 2) +
+          normal_log_prob(2.0, 0, 2) + normal_log_prob(0.0, 0.5, 1) +
+          normal_log_prob(0.5, 0.8, 1),
+      1e-6);
+}
+
+TEST(testgraph, query_only_nodes_and_thinning) {
+  // x ~ Normal(0, 1); y ~ Normal(x, 1) observed
+  // x_sq = x * x and x_sq_plus_one = x_sq + 1 are only queried
+  graph::Graph g;
+  uint zero = g.add_constant(0.0);
+  uint one = g.add_constant_pos_real(1.0);
+  uint real_one = g.add_constant(1.0);
+  uint prior = g.add_distribution(
+      graph::DistributionType::NORMAL,
+      graph::AtomicType::REAL,
+      std::vector<uint>{zero, one});
+  uint x = g.add_operator(graph::OperatorType::SAMPLE, {prior});
+  uint likelihood = g.add_distribution(
+      graph::DistributionType::NORMAL,
+      graph::AtomicType::REAL,
+      std::vector<uint>{x, one});
+  uint y = g.add_operator(graph::OperatorType::SAMPLE, {likelihood});
+  uint x_sq = g.add_operator(graph::OperatorType::MULTIPLY, {x, x});
+  uint x_sq_plus_one =
+      g.add_operator(graph::OperatorType::ADD, {x_sq, real_one});
+  g.observe(y, 0.5);
+  g.query(x);
+  g.query(x_sq_plus_one);
+
+  g.ensure_evaluation_and_inference_readiness();
+  EXPECT_TRUE(g.query_only_by_node_id[x_sq]);
+  EXPECT_TRUE(g.query_only_by_node_id[x_sq_plus_one]);
+  EXPECT_EQ(g.query_only_nodes.size(), 2);
+  EXPECT_TRUE(g.get_det_affected_nodes(g.get_node(x)).empty());
+
+  // query-only nodes are brought up to date when collecting samples
+  uint num_samples = 20;
+  auto& samples = g.infer(num_samples, graph::InferenceType::NMC, 31);
+  EXPECT_EQ(samples.size(), num_samples);
+  for (const auto& sample : samples) {
+    EXPECT_NEAR(
+        sample[1]._double, sample[0]._double * sample[0]._double + 1, 1e-10);
+  }
+
+  // a thinned chain yields every thinning-th sample of the unthinned chain
+  uint thinning = 3;
+  graph::InferConfig thinned_config;
+  thinned_config.thinning = thinning;
+  auto thinned =
+      g.infer(num_samples, graph::InferenceType::NMC, 31, 1, thinned_config)[0];
+  auto unthinned =
+      g.infer(num_samples * thinning, graph::InferenceType::NMC, 31);
+  EXPECT_EQ(thinned.size(), num_samples);
+  for (uint i = 0; i < num_samples; i++) {
+    EXPECT_EQ(
+        thinned[i][0]._double, unthinned[(i + 1) * thinning - 1][0]._double);
+  }
+
+  graph::InferConfig zero_thinning;
+  zero_thinning.thinning = 0;
+  EXPECT_THROW(
+      g.infer(num_samples, graph::InferenceType::NMC, 31, 1, zero_thinning),
+      std::runtime_error);
+}
+
+TEST(testgraph, pinned_chains) {
+  graph::Graph g;
+  uint zero = g.add_constant(0.0);
+  uint one = g.add_constant_pos_real(1.0);
+  uint prior = g.add_distribution(
+      graph::DistributionType::NORMAL,
+      graph::AtomicType::REAL,
+      std::vector<uint>{zero, one});
+  uint x = g.add_operator(graph::OperatorType::SAMPLE, {prior});
+  uint likelihood = g.add_distribution(
+      graph::DistributionType::NORMAL,
+      graph::AtomicType::REAL,
+      std::vector<uint>{x, one});
+  uint y = g.add_operator(graph::OperatorType::SAMPLE, {likelihood});
+  g.observe(y, 0.5);
+  g.query(x);
+
+  // pinning threads and copying the graph in each chain's thread changes
+  // where chains run, not what they sample
+  uint num_samples = 50;
+  uint n_chains = 3;
+  auto unpinned =
+      g.infer(num_samples, graph::InferenceType::NMC, 17, n_chains);
+  graph::InferConfig pinned_config;
+  pinned_config.pin_threads = true;
+  auto pinned = g.infer(
+      num_samples, graph::InferenceType::NMC, 17, n_chains, pinned_config);
+  ASSERT_EQ(pinned.size(), n_chains);
+  for (uint chain = 0; chain < n_chains; chain++) {
+    ASSERT_EQ(pinned[chain].size(), num_samples);
+    for (uint i = 0; i < num_samples; i++) {
+      EXPECT_EQ(pinned[chain][i][0]._double, unpinned[chain][i][0]._double);
+    }
+  }
+  EXPECT_NE(pinned[0][0][0]._double, pinned[1][0][0]._double);
+}
+
+TEST(testgraph, multiprocess_chains) {
+  // x ~ Normal(0, 1); y ~ Normal(x, 1) observed; queries x and [x; x^2]
+  auto build = [](bool query_matrix = true) {
+    auto g = std::make_unique<graph::Graph>();
+    uint zero = g->add_constant(0.0);
+    uint one = g->add_constant_pos_real(1.0);
+    uint nat_one = g->add_constant((graph::natural_t)1);
+    uint nat_two = g->add_constant((graph::natural_t)2);
+    uint prior = g->add_distribution(
+        graph::DistributionType::NORMAL,
+        graph::AtomicType::REAL,
+        std::vector<uint>{zero, one});
+    uint x = g->add_operator(graph::OperatorType::SAMPLE, {prior});
+    uint likelihood = g->add_distribution(
+        graph::DistributionType::NORMAL,
+        graph::AtomicType::REAL,
+        std::vector<uint>{x, one});
+    uint y = g->add_operator(graph::OperatorType::SAMPLE, {likelihood});
+    uint x_sq = g->add_operator(graph::OperatorType::MULTIPLY, {x, x});
+    uint m = g->add_operator(
+        graph::OperatorType::TO_MATRIX, {nat_two, nat_one, x, x_sq});
+    g->observe(y, 0.5);
+    g->query(x);
+    if (query_matrix) {
+      g->query(m);
+    }
+    return g;
+  };
+  uint num_samples = 30;
+  uint n_chains = 3;
+  graph::InferConfig config;
+  config.keep_log_prob = true;
+  auto threaded = build();
+  auto& threaded_samples = threaded->infer(
+      num_samples, graph::InferenceType::NMC, 23, n_chains, config);
+  config.use_processes = true;
+  auto forked = build();
+  auto& forked_samples = forked->infer(
+      num_samples, graph::InferenceType::NMC, 23, n_chains, config);
+  ASSERT_EQ(forked_samples.size(), n_chains);
+  for (uint chain = 0; chain < n_chains; chain++) {
+    ASSERT_EQ(forked_samples[chain].size(), num_samples);
+    for (uint i = 0; i < num_samples; i++) {
+      EXPECT_EQ(forked_samples[chain][i][0], threaded_samples[chain][i][0]);
+      EXPECT_EQ(
+          forked_samples[chain][i][1]._matrix,
+          threaded_samples[chain][i][1]._matrix);
+    }
+    EXPECT_EQ(forked->get_log_prob()[chain], threaded->get_log_prob()[chain]);
+  }
+
+  // means are sent at the end of each chain, and errors are rethrown
+  graph::InferConfig mean_config;
+  auto threaded_mean_graph = build(false);
+  auto threaded_means = threaded_mean_graph->infer_mean(
+      num_samples, graph::InferenceType::NMC, 29, n_chains, mean_config);
+  mean_config.use_processes = true;
+  auto forked_mean_graph = build(false);
+  auto forked_means = forked_mean_graph->infer_mean(
+      num_samples, graph::InferenceType::NMC, 29, n_chains, mean_config);
+  EXPECT_EQ(forked_means, threaded_means);
+  graph::InferConfig bad_config;
+  bad_config.use_processes = true;
+  bad_config.thinning = 0;
+  EXPECT_THROW(
+      build()->infer(
+          num_samples, graph::InferenceType::NMC, 23, n_chains, bad_config),
+      std::runtime_error);
+  // forked chains can't share a thread budget
+  graph::InferConfig budget_config;
+  budget_config.use_processes = true;
+  budget_config.max_threads = 2;
+  EXPECT_THROW(
+      build()->infer(
+          num_samples, graph::InferenceType::NMC, 23, n_chains, budget_config),
+      std::runtime_error);
+}
+
+TEST(testgraph, rao_blackwellized_gibbs) {
+  // two causes of a noisy-or effect, which is observed to be true
+  graph::Graph g;
+  uint c1 = g.add_constant_probability(0.1);
+  uint d1 = g.add_distribution(
+      graph::DistributionType::BERNOULLI,
+      graph::AtomicType::BOOLEAN,
+      std::vector<uint>({c1}));
+  uint o1 =
+      g.add_operator(graph::OperatorType::SAMPLE, std::vector<uint>({d1}));
+  uint c2 = g.add_constant_probability(0.2);
+  uint d2 = g.add_distribution(
+      graph::DistributionType::BERNOULLI,
+      graph::AtomicType::BOOLEAN,
+      std::vector<uint>({c2}));
+  uint o2 =
+      g.add_operator(graph::OperatorType::SAMPLE, std::vector<uint>({d2}));
+  uint w1 = g.add_constant_pos_real(0.8);
+  uint w2 = g.add_constant_pos_real(0.5);
+  uint leak = g.add_constant_pos_real(0.1);
+  uint o3 = g.add_operator(
+      graph::OperatorType::TO_POS_REAL, std::vector<uint>({o1}));
+  uint o4 = g.add_operator(
+      graph::OperatorType::TO_POS_REAL, std::vector<uint>({o2}));
+  uint o5 = g.add_operator(
+      graph::OperatorType::MULTIPLY, std::vector<uint>({w1, o3}));
+  uint o6 = g.add_operator(
+      graph::OperatorType::MULTIPLY, std::vector<uint>({w2, o4}));
+  uint o7 = g.add_operator(
+      graph::OperatorType::ADD, std::vector<uint>({leak, o5, o6}));
+  uint d3 = g.add_distribution(
+      graph::DistributionType::BERNOULLI_NOISY_OR,
+      graph::AtomicType::BOOLEAN,
+      std::vector<uint>({o7}));
+  uint o8 =
+      g.add_operator(graph::OperatorType::SAMPLE, std::vector<uint>({d3}));
+  g.observe(o8, true);
+  g.query(o1);
+  g.query(o2);
+  g.query(o8);
+  // exact posterior means by enumeration
+  double joint[2][2], total = 0;
+  for (uint x1 = 0; x1 < 2; x1++) {
+    for (uint x2 = 0; x2 < 2; x2++) {
+      joint[x1][x2] = (x1 ? 0.1 : 0.9) * (x2 ? 0.2 : 0.8) *
+          (1 - std::exp(-(0.1 + 0.8 * x1 + 0.5 * x2)));
+      total += joint[x1][x2];
+    }
+  }
+  std::vector<double> expected = {
+      (joint[1][0] + joint[1][1]) / total, (joint[0][1] + joint[1][1]) / total};
+  uint n_iter = 200;
+  uint n_chains = 20;
+  graph::InferConfig infer_config;
+  const auto raw_means = g.infer_mean(
+      n_iter, graph::InferenceType::GIBBS, 31, n_chains, infer_config);
+  infer_config.rao_blackwellize = true;
+  const auto rb_means = g.infer_mean(
+      n_iter, graph::InferenceType::GIBBS, 31, n_chains, infer_config);
+  for (uint pos = 0; pos < 2; pos++) {
+    double raw_sq_error = 0, rb_sq_error = 0;
+    for (uint i = 0; i < n_chains; i++) {
+      raw_sq_error += std::pow(raw_means[i][pos] - expected[pos], 2);
+      rb_sq_error += std::pow(rb_means[i][pos] - expected[pos], 2);
+      EXPECT_NEAR(rb_means[i][pos], expected[pos], 0.05);
+    }
+    EXPECT_LT(rb_sq_error, raw_sq_error);
+  }
+  // observed nodes are aggregated as before
+  EXPECT_NEAR(rb_means[0][2], 1.0, 1e-10);
+  // samples are unaffected
+  const auto& samples =
+      g.infer(n_iter, graph::InferenceType::GIBBS, 31, 1, infer_config)[0];
+  for (const auto& sample : samples) {
+    ASSERT_EQ(sample[0].type, graph::AtomicType::BOOLEAN);
+  }
+}
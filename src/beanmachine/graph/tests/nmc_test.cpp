@@ -455,3 +455,134 @@ TEST(testnmc, warmup) {
   samples = g.infer(num_samples, InferenceType::NMC, 17, 1, infer_config);
   EXPECT_EQ(samples[0].size(), 300);
 }
+
+TEST(testnmc, delayed_acceptance) {
+  // x ~ Normal(0, 10); y_i ~ Normal(x + offset_i, 1) for i = 1..n
+  // posterior of x is Normal(sum(y_i - offset_i) / (n + 0.01),
+  //                          1 / sqrt(n + 0.01))
+  Graph g;
+  uint n = 200;
+  auto zero = g.add_constant(0.0);
+  auto ten = g.add_constant_pos_real(10.0);
+  auto one = g.add_constant_pos_real(1.0);
+  auto prior = g.add_distribution(
+      DistributionType::NORMAL, AtomicType::REAL, std::vector<uint>{zero, ten});
+  auto x = g.add_operator(OperatorType::SAMPLE, std::vector<uint>{prior});
+  double sum = 0;
+  for (uint i = 0; i < n; i++) {
+    double offset = std::cos(i);
+    double y_value = 2.0 + offset + std::sin(3.0 * i);
+    sum += y_value - offset;
+    auto offset_node = g.add_constant(offset);
+    auto mean = g.add_operator(
+        OperatorType::ADD, std::vector<uint>{x, offset_node});
+    auto dist = g.add_distribution(
+        DistributionType::NORMAL, AtomicType::REAL, std::vector<uint>{mean, one});
+    auto y = g.add_operator(OperatorType::SAMPLE, std::vector<uint>{dist});
+    g.observe(y, y_value);
+  }
+  g.query(x);
+  double posterior_mean = sum / (n + 0.01);
+  double posterior_var = 1 / (n + 0.01);
+
+  InferConfig infer_config;
+  infer_config.delayed_acceptance_subset_size = 20;
+  uint num_samples = 20000;
+  auto samples =
+      g.infer(num_samples, InferenceType::NMC, 23, 1, infer_config)[0];
+  double mean = 0, sq = 0;
+  for (const auto& sample : samples) {
+    mean += sample[0]._double / num_samples;
+    sq += sample[0]._double * sample[0]._double / num_samples;
+  }
+  EXPECT_NEAR(mean, posterior_mean, 0.01);
+  EXPECT_NEAR(sq - mean * mean, posterior_var, 0.001);
+
+  // targets with too few affected nodes are not screened
+  infer_config.delayed_acceptance_subset_size = n;
+  auto unscreened =
+      g.infer(100, InferenceType::NMC, 23, 1, infer_config)[0];
+  auto plain = g.infer(100, InferenceType::NMC, 23);
+  for (uint i = 0; i < 100; i++) {
+    EXPECT_EQ(unscreened[i][0]._double, plain[i][0]._double);
+  }
+}
+
+TEST(testnmc, control_variates) {
+  // the model of normal_normal, where the posterior of x is N(20, sqrt(20))
+  Graph g;
+  auto mean0 = g.add_constant(0.0);
+  auto sigma0 = g.add_constant_pos_real(5.0);
+  auto dist0 = g.add_distribution(
+      DistributionType::NORMAL,
+      AtomicType::REAL,
+      std::vector<uint>{mean0, sigma0});
+  auto x = g.add_operator(OperatorType::SAMPLE, std::vector<uint>{dist0});
+  auto x_sq = g.add_operator(OperatorType::MULTIPLY, std::vector<uint>{x, x});
+  auto sigma1 = g.add_constant_pos_real(10.0);
+  auto dist1 = g.add_distribution(
+      DistributionType::NORMAL, AtomicType::REAL, std::vector<uint>{x, sigma1});
+  auto y = g.add_operator(OperatorType::SAMPLE, std::vector<uint>{dist1});
+  g.observe(y, 100.0);
+  g.query(x);
+  g.query(x_sq);
+  uint n_chains = 4;
+  InferConfig infer_config;
+  auto plain_means =
+      g.infer_mean(500, InferenceType::NMC, 17, n_chains, infer_config);
+  infer_config.control_variates = true;
+  auto cv_means =
+      g.infer_mean(500, InferenceType::NMC, 17, n_chains, infer_config);
+  double plain_sq_error = 0, cv_sq_error = 0;
+  for (uint i = 0; i < n_chains; i++) {
+    // x is a linear function of the score -(x - 20) / 20, so the corrected
+    // mean is exact
+    EXPECT_NEAR(cv_means[i][0], 20, 1e-6);
+    plain_sq_error += std::pow(plain_means[i][1] - 420, 2);
+    cv_sq_error += std::pow(cv_means[i][1] - 420, 2);
+  }
+  EXPECT_LT(cv_sq_error, plain_sq_error);
+
+  // s ~ Gamma(2, 1), y_i ~ Poisson(s), y = (3, 5, 4) so the posterior is
+  // Gamma(14, 4). The score of log(s) is 14 - 4 s, again exact.
+  Graph g2;
+  auto two = g2.add_constant_pos_real(2.0);
+  auto one = g2.add_constant_pos_real(1.0);
+  auto gamma = g2.add_distribution(
+      DistributionType::GAMMA,
+      AtomicType::POS_REAL,
+      std::vector<uint>{two, one});
+  auto s = g2.add_operator(OperatorType::SAMPLE, std::vector<uint>{gamma});
+  auto poisson = g2.add_distribution(
+      DistributionType::POISSON, AtomicType::NATURAL, std::vector<uint>{s});
+  for (natural_t count : std::vector<natural_t>{3, 5, 4}) {
+    auto obs = g2.add_operator(OperatorType::SAMPLE, std::vector<uint>{poisson});
+    g2.observe(obs, count);
+  }
+  g2.query(s);
+  auto gamma_means =
+      g2.infer_mean(500, InferenceType::NMC, 17, n_chains, infer_config);
+  for (uint i = 0; i < n_chains; i++) {
+    EXPECT_NEAR(gamma_means[i][0], 3.5, 1e-6);
+  }
+
+  // a PROBABILITY latent has no score, so the means are left as they are
+  Graph g3;
+  auto shape = g3.add_constant_pos_real(2.0);
+  auto beta = g3.add_distribution(
+      DistributionType::BETA,
+      AtomicType::PROBABILITY,
+      std::vector<uint>{shape, shape});
+  auto p = g3.add_operator(OperatorType::SAMPLE, std::vector<uint>{beta});
+  auto coin = g3.add_distribution(
+      DistributionType::BERNOULLI, AtomicType::BOOLEAN, std::vector<uint>{p});
+  auto heads = g3.add_operator(OperatorType::SAMPLE, std::vector<uint>{coin});
+  g3.observe(heads, true);
+  g3.query(p);
+  auto cv_beta_means =
+      g3.infer_mean(200, InferenceType::NMC, 17, n_chains, infer_config);
+  infer_config.control_variates = false;
+  auto plain_beta_means =
+      g3.infer_mean(200, InferenceType::NMC, 17, n_chains, infer_config);
+  EXPECT_EQ(cv_beta_means, plain_beta_means);
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <cstdio>
+#include <fstream>
+
+#include "beanmachine/graph/graph.h"
+#include "beanmachine/graph/sample_store.h"
+
+using namespace beanmachine::graph;
+
+// x ~ Normal(0, 1); y ~ Normal(x, 1) observed 0.5; b ~ Bernoulli(0.3);
+// queries x, [x; x^2] and b
+static std::unique_ptr<Graph> build_store_model() {
+  auto g = std::make_unique<Graph>();
+  uint zero = g->add_constant(0.0);
+  uint one = g->add_constant_pos_real(1.0);
+  uint prob = g->add_constant_probability(0.3);
+  uint nat_one = g->add_constant((natural_t)1);
+  uint nat_two = g->add_constant((natural_t)2);
+  uint prior = g->add_distribution(
+      DistributionType::NORMAL,
+      AtomicType::REAL,
+      std::vector<uint>{zero, one});
+  uint x = g->add_operator(OperatorType::SAMPLE, {prior});
+  uint likelihood = g->add_distribution(
+      DistributionType::NORMAL, AtomicType::REAL, std::vector<uint>{x, one});
+  uint y = g->add_operator(OperatorType::SAMPLE, {likelihood});
+  uint x_sq = g->add_operator(OperatorType::MULTIPLY, {x, x});
+  uint m =
+      g->add_operator(OperatorType::TO_MATRIX, {nat_two, nat_one, x, x_sq});
+  uint bern = g->add_distribution(
+      DistributionType::BERNOULLI,
+      AtomicType::BOOLEAN,
+      std::vector<uint>{prob});
+  uint b = g->add_operator(OperatorType::SAMPLE, {bern});
+  g->observe(y, 0.5);
+  g->query(x);
+  g->query(m);
+  g->query(b);
+  return g;
+}
+
+TEST(testsamplestore, infer_to_store) {
+  std::string path = "/tmp/sample_store_test" + std::to_string(getpid());
+  uint num_samples = 25;
+  uint n_chains = 3;
+  InferConfig config;
+  config.keep_log_prob = true;
+  config.num_warmup = 5;
+  config.keep_warmup = true;
+  auto in_memory = build_store_model();
+  auto& expected =
+      in_memory->infer(num_samples, InferenceType::NMC, 17, n_chains, config);
+  auto& expected_log_probs = in_memory->get_log_prob();
+
+  for (bool use_processes : {false, true}) {
+    config.sample_store_path = path;
+    config.use_processes = use_processes;
+    auto stored = build_store_model();
+    auto& samples =
+        stored->infer(num_samples, InferenceType::NMC, 17, n_chains, config);
+    // the samples are not kept in memory
+    ASSERT_EQ(samples.size(), n_chains);
+    EXPECT_TRUE(samples[0].empty());
+
+    SampleStoreReader reader(path);
+    ASSERT_EQ(reader.num_chains(), n_chains);
+    ASSERT_EQ(reader.num_queries(), 3);
+    EXPECT_EQ(reader.query_column(0).node_id, stored->queries[0]);
+    EXPECT_EQ(reader.query_column(1).rows, 2);
+    EXPECT_EQ(reader.query_column(1).cols, 1);
+    for (uint chain = 0; chain < n_chains; chain++) {
+      ASSERT_EQ(reader.num_draws(chain), num_samples + 5);
+      auto x = static_cast<const double*>(reader.query_data(0, chain));
+      auto m = static_cast<const double*>(reader.query_data(1, chain));
+      auto b = static_cast<const std::uint8_t*>(reader.query_data(2, chain));
+      for (uint i = 0; i < num_samples + 5; i++) {
+        const auto& sample = expected[chain][i];
+        EXPECT_EQ(x[i], sample[0]._double);
+        EXPECT_EQ(m[2 * i], sample[1]._matrix(0));
+        EXPECT_EQ(m[2 * i + 1], sample[1]._matrix(1));
+        EXPECT_EQ(b[i], sample[2]._bool);
+        EXPECT_EQ(reader.value(1, chain, i)._matrix, sample[1]._matrix);
+        EXPECT_EQ(reader.value(2, chain, i)._bool, sample[2]._bool);
+        EXPECT_EQ(reader.log_probs(chain)[i], expected_log_probs[chain][i]);
+      }
+    }
+  }
+
+  // without log probs there is no log prob column
+  config.keep_log_prob = false;
+  auto stored = build_store_model();
+  stored->infer(num_samples, InferenceType::NMC, 17, 1, config);
+  SampleStoreReader reader(path);
+  EXPECT_EQ(reader.num_queries(), 3);
+  EXPECT_EQ(reader.log_probs(0), nullptr);
+  std::remove(path.c_str());
+
+  // files that are not sample stores are rejected
+  std::ofstream(path) << "not a sample store";
+  EXPECT_THROW(SampleStoreReader bad(path), std::runtime_error);
+  std::remove(path.c_str());
+}
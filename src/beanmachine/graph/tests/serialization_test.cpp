@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <cmath>
+#include <limits>
+
+#include <gtest/gtest.h>
+
+#include "beanmachine/graph/graph.h"
+#include "beanmachine/graph/serialization.h"
+
+using namespace beanmachine;
+using namespace beanmachine::graph;
+
+TEST(testserialization, round_trip) {
+  Graph g;
+  uint c_real = g.add_constant(0.1);
+  uint c_pos = g.add_constant_pos_real(2.5);
+  uint c_prob = g.add_constant_probability(1.0 / 3.0);
+  uint c_natural = g.add_constant((natural_t)2);
+  Eigen::MatrixXd simplex(3, 1);
+  simplex << 0.2, 0.3, 0.5;
+  g.add_constant_col_simplex_matrix(simplex);
+  Eigen::MatrixXn naturals(1, 2);
+  naturals << 4, 7;
+  g.add_constant_natural_matrix(naturals);
+  uint d_bernoulli = g.add_distribution(
+      DistributionType::BERNOULLI,
+      AtomicType::BOOLEAN,
+      std::vector<uint>{c_prob});
+  uint d_normal = g.add_distribution(
+      DistributionType::NORMAL,
+      AtomicType::REAL,
+      std::vector<uint>{c_real, c_pos});
+  uint d_beta = g.add_distribution(
+      DistributionType::BETA,
+      AtomicType::PROBABILITY,
+      std::vector<uint>{c_pos, c_pos});
+  uint o_bool =
+      g.add_operator(OperatorType::SAMPLE, std::vector<uint>{d_bernoulli});
+  uint o_real =
+      g.add_operator(OperatorType::SAMPLE, std::vector<uint>{d_normal});
+  uint o_prob = g.add_operator(OperatorType::SAMPLE, std::vector<uint>{d_beta});
+  uint o_iid = g.add_operator(
+      OperatorType::IID_SAMPLE, std::vector<uint>{d_normal, c_natural});
+  uint o_pos =
+      g.add_operator(OperatorType::TO_POS_REAL, std::vector<uint>{o_prob});
+  uint o_ifelse = g.add_operator(
+      OperatorType::IF_THEN_ELSE, std::vector<uint>{o_bool, o_real, c_real});
+  g.add_factor(
+      FactorType::EXP_PRODUCT, std::vector<uint>{o_real, o_pos, c_pos});
+  Eigen::MatrixXd iid_obs(2, 1);
+  iid_obs << 0.7, -1.0 / 7.0;
+  g.observe(o_iid, iid_obs);
+  g.observe(o_bool, true);
+  g.query(o_ifelse);
+  g.query(o_prob);
+  g.query(o_iid);
+
+  std::string text = serialize_graph(g);
+  std::unique_ptr<Graph> loaded = deserialize_graph(text);
+  EXPECT_EQ(loaded->to_string(), g.to_string());
+  EXPECT_EQ(serialize_graph(*loaded), text);
+  EXPECT_EQ(loaded->queries, g.queries);
+  EXPECT_EQ(loaded->observed, g.observed);
+  // doubles round trip exactly, so the log probs and samples agree
+  EXPECT_EQ(loaded->full_log_prob(), g.full_log_prob());
+  auto& samples = g.infer(20, InferenceType::NMC, 31);
+  auto& loaded_samples = loaded->infer(20, InferenceType::NMC, 31);
+  ASSERT_EQ(loaded_samples.size(), samples.size());
+  for (uint i = 0; i < samples.size(); i++) {
+    EXPECT_EQ(loaded_samples[i][0]._double, samples[i][0]._double);
+    EXPECT_EQ(loaded_samples[i][1]._double, samples[i][1]._double);
+  }
+}
+
+TEST(testserialization, non_finite) {
+  Graph g;
+  uint c_inf = g.add_constant_pos_real(std::numeric_limits<double>::infinity());
+  uint c_neg_inf = g.add_constant(-std::numeric_limits<double>::infinity());
+  Eigen::MatrixXd m(1, 3);
+  m << 1.5, std::numeric_limits<double>::quiet_NaN(),
+      -std::numeric_limits<double>::infinity();
+  uint c_matrix = g.add_constant_real_matrix(m);
+  g.query(c_inf);
+  g.query(c_neg_inf);
+  g.query(c_matrix);
+
+  std::string text = serialize_graph(g);
+  std::unique_ptr<Graph> loaded = deserialize_graph(text);
+  EXPECT_EQ(serialize_graph(*loaded), text);
+  const auto& nodes = loaded->nodes;
+  EXPECT_EQ(
+      nodes[c_inf]->value._double, std::numeric_limits<double>::infinity());
+  EXPECT_EQ(
+      nodes[c_neg_inf]->value._double,
+      -std::numeric_limits<double>::infinity());
+  const Eigen::MatrixXd& loaded_m = nodes[c_matrix]->value._matrix;
+  EXPECT_EQ(loaded_m(0), 1.5);
+  EXPECT_TRUE(std::isnan(loaded_m(1)));
+  EXPECT_EQ(loaded_m(2), -std::numeric_limits<double>::infinity());
+  // out of range doubles are not silently turned into infinities
+  EXPECT_THROW(
+      deserialize_graph("bmg 1\nconstant 1 3 0 0 1e999\n"),
+      std::invalid_argument);
+}
+
+TEST(testserialization, malformed) {
+  EXPECT_THROW(deserialize_graph(""), std::invalid_argument);
+  EXPECT_THROW(deserialize_graph("bmg 99\n"), std::invalid_argument);
+  EXPECT_THROW(deserialize_graph("bmg 1\nnode 0\n"), std::invalid_argument);
+  // a parent that does not exist
+  EXPECT_THROW(
+      deserialize_graph("bmg 1\noperator 6 1 0\n"), std::out_of_range);
+  // a truncated and an overlong constant
+  EXPECT_THROW(
+      deserialize_graph("bmg 1\nconstant 1 3 0 0\n"), std::invalid_argument);
+  EXPECT_THROW(
+      deserialize_graph("bmg 1\nconstant 1 3 0 0 1.5 2.5\n"),
+      std::invalid_argument);
+  // comments and blank lines are skipped
+  std::unique_ptr<Graph> g =
+      deserialize_graph("bmg 1\n# a real\n\nconstant 1 3 0 0 1.5\nquery 0\n");
+  EXPECT_EQ(g->queries, std::vector<uint>{0});
+}
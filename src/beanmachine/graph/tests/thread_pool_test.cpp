@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "beanmachine/graph/graph.h"
+#include "beanmachine/graph/operator/linalgop.h"
+#include "beanmachine/graph/thread_pool.h"
+
+using namespace beanmachine;
+using namespace graph;
+
+TEST(testthreadpool, parallel_for) {
+  std::vector<int> counts(1000, 0);
+  auto count = [&counts](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; i++) {
+      counts[i]++;
+    }
+  };
+  // without a budget the ranges run in this thread
+  util::parallel_for(counts.size(), 7, count);
+  util::ThreadBudget budget(4);
+  {
+    util::ChainScope chain_scope(&budget);
+    EXPECT_EQ(util::ThreadBudget::current(), &budget);
+    util::parallel_for(counts.size(), 7, count);
+    // the chain holds one thread and the helpers were given back
+    EXPECT_EQ(budget.try_acquire(10), 3);
+    budget.release(3);
+    EXPECT_THROW(
+        util::parallel_for(
+            100,
+            1,
+            [](std::size_t begin, std::size_t /* end */) {
+              if (begin == 42) {
+                throw std::runtime_error("range failed");
+              }
+            }),
+        std::runtime_error);
+  }
+  EXPECT_EQ(util::ThreadBudget::current(), nullptr);
+  EXPECT_EQ(budget.try_acquire(10), 4);
+  for (int c : counts) {
+    EXPECT_EQ(c, 2);
+  }
+  EXPECT_THROW(util::ThreadBudget(0), std::invalid_argument);
+}
+
+TEST(testthreadpool, try_parallel_invoke) {
+  int first = 0;
+  int second = 0;
+  auto invoke = [&]() {
+    return util::try_parallel_invoke([&]() { first++; }, [&]() { second++; });
+  };
+  // without a spare helper neither function runs
+  EXPECT_FALSE(invoke());
+  util::ThreadBudget single(1);
+  {
+    util::ChainScope chain_scope(&single);
+    EXPECT_FALSE(invoke());
+  }
+  EXPECT_EQ(first, 0);
+  EXPECT_EQ(second, 0);
+  util::ThreadBudget budget(2);
+  util::ChainScope chain_scope(&budget);
+  EXPECT_TRUE(invoke());
+  EXPECT_EQ(first, 1);
+  EXPECT_EQ(second, 1);
+  EXPECT_THROW(
+      util::try_parallel_invoke(
+          [&]() { first++; },
+          []() { throw std::runtime_error("helper failed"); }),
+      std::runtime_error);
+  EXPECT_EQ(first, 2);
+  // the helper was given back
+  EXPECT_EQ(budget.try_acquire(2), 1);
+}
+
+TEST(testthreadpool, concurrent_budgets) {
+  // the helpers of several budgets all run at once: every range waits until
+  // the ranges of all the budgets have started
+  const unsigned num_budgets = 4;
+  const unsigned max_threads = 4;
+  std::mutex mutex;
+  std::condition_variable started_cv;
+  unsigned num_started = 0;
+  std::atomic<unsigned> num_timeouts{0};
+  auto body = [&](std::size_t /* begin */, std::size_t /* end */) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (++num_started == num_budgets * max_threads) {
+      started_cv.notify_all();
+    } else if (not started_cv.wait_for(
+                   lock, std::chrono::seconds(30), [&]() {
+                     return num_started == num_budgets * max_threads;
+                   })) {
+      num_timeouts++;
+    }
+  };
+  std::vector<std::unique_ptr<util::ThreadBudget>> budgets;
+  std::vector<std::thread> chains;
+  for (unsigned i = 0; i < num_budgets; i++) {
+    budgets.push_back(std::make_unique<util::ThreadBudget>(max_threads));
+    util::ThreadBudget* budget = budgets.back().get();
+    chains.emplace_back([&body, budget]() {
+      util::ChainScope chain_scope(budget);
+      util::parallel_for(max_threads, 1, body);
+    });
+  }
+  for (auto& chain : chains) {
+    chain.join();
+  }
+  EXPECT_EQ(num_started, num_budgets * max_threads);
+  EXPECT_EQ(num_timeouts, 0);
+}
+
+TEST(testthreadpool, parallel_kernels) {
+  std::mt19937 gen(17);
+  std::normal_distribution<double> dist;
+  auto random_matrix = [&](int rows, int cols) {
+    return Eigen::MatrixXd::NullaryExpr(rows, cols, [&]() { return dist(gen); })
+        .eval();
+  };
+  Eigen::MatrixXd a = random_matrix(150, 120);
+  Eigen::MatrixXd b = random_matrix(120, 90);
+  Eigen::MatrixXd m = random_matrix(300, 300);
+  Eigen::MatrixXd spd =
+      m * m.transpose() + 300 * Eigen::MatrixXd::Identity(300, 300);
+
+  util::ThreadBudget budget(3);
+  util::ChainScope chain_scope(&budget);
+  ASSERT_TRUE(util::use_parallel_kernel(2.0 * 150 * 120 * 90));
+  Eigen::MatrixXd product;
+  oper::matrix_product(a, b, product);
+  EXPECT_LT((product - a * b).cwiseAbs().maxCoeff(), 1e-10);
+  Eigen::MatrixXd factor;
+  oper::cholesky_factor(spd, factor);
+  Eigen::MatrixXd expected = spd.llt().matrixL();
+  EXPECT_LT((factor - expected).cwiseAbs().maxCoeff(), 1e-10);
+  EXPECT_TRUE(factor.isLowerTriangular());
+}
+
+TEST(testthreadpool, infer_max_threads) {
+  // x ~ Normal(0, 1); queries A (x B) for constant 200 x 200 matrices
+  std::mt19937 gen(31);
+  std::uniform_real_distribution<double> dist(-1, 1);
+  Eigen::MatrixXd a = Eigen::MatrixXd::NullaryExpr(
+      200, 200, [&]() { return dist(gen); });
+  Eigen::MatrixXd b = Eigen::MatrixXd::NullaryExpr(
+      200, 200, [&]() { return dist(gen); });
+  Graph g;
+  uint zero = g.add_constant(0.0);
+  uint one = g.add_constant_pos_real(1.0);
+  uint x = g.add_operator(
+      OperatorType::SAMPLE,
+      {g.add_distribution(
+          DistributionType::NORMAL, AtomicType::REAL, {zero, one})});
+  uint scaled = g.add_operator(
+      OperatorType::MATRIX_SCALE, {x, g.add_constant_real_matrix(b)});
+  uint product = g.add_operator(
+      OperatorType::MATRIX_MULTIPLY, {g.add_constant_real_matrix(a), scaled});
+  g.query(x);
+  g.query(product);
+
+  Eigen::MatrixXd ab = a * b;
+  auto run = [&g, &ab](uint max_threads) {
+    InferConfig config;
+    config.max_threads = max_threads;
+    auto& samples = g.infer(10, InferenceType::NMC, 23, 2, config);
+    for (auto& chain : samples) {
+      for (auto& sample : chain) {
+        EXPECT_LT(
+            (sample[1]._matrix - sample[0]._double * ab).cwiseAbs().maxCoeff(),
+            1e-9);
+      }
+    }
+    return samples;
+  };
+  auto serial = run(0);
+  // the products are split the same way whatever the number of threads
+  auto shared = run(3);
+  auto spare = run(8);
+  for (uint c = 0; c < 2; c++) {
+    for (uint i = 0; i < 10; i++) {
+      EXPECT_EQ(shared[c][i][0]._double, serial[c][i][0]._double);
+      EXPECT_EQ(shared[c][i][1]._matrix, spare[c][i][1]._matrix);
+    }
+  }
+}
+
+TEST(testthreadpool, shared_mixture_components) {
+  // two mixtures sharing an inner mixture are the components of an outer
+  // mixture, whose large iid observation is split into concurrent ranges
+  uint n = 4000;
+  Eigen::MatrixXd xobs = Eigen::VectorXd::LinSpaced(n, -5.0, 5.0);
+  // a fresh graph per run, since the log prob of its only (observed) node
+  // is computed once and then kept as part of the fixed log prob
+  auto log_prob = [&](util::ThreadBudget* budget) {
+    Graph g;
+    uint one = g.add_constant_pos_real(1.0);
+    Eigen::MatrixXd w(2, 1);
+    w << 0.3, 0.7;
+    uint weights = g.add_constant_col_simplex_matrix(w);
+    auto normal = [&](double mean) {
+      return g.add_distribution(
+          DistributionType::NORMAL,
+          AtomicType::REAL,
+          std::vector<uint>{g.add_constant(mean), one});
+    };
+    auto mixture = [&](uint first, uint second) {
+      return g.add_distribution(
+          DistributionType::MIXTURE,
+          AtomicType::REAL,
+          std::vector<uint>{weights, first, second});
+    };
+    uint inner = mixture(normal(-1.0), normal(1.0));
+    uint outer =
+        mixture(mixture(inner, normal(-3.0)), mixture(inner, normal(3.0)));
+    uint xiid = g.add_operator(
+        OperatorType::IID_SAMPLE,
+        std::vector<uint>{outer, g.add_constant((natural_t)n)});
+    g.observe(xiid, xobs);
+    util::ChainScope chain_scope(budget);
+    return g.full_log_prob();
+  };
+  auto density = [](double x, double mean) {
+    return std::exp(-0.5 * (x - mean) * (x - mean)) / std::sqrt(2 * M_PI);
+  };
+  double expected = 0.0;
+  for (uint i = 0; i < n; i++) {
+    double x = xobs(i);
+    double inner = 0.3 * density(x, -1.0) + 0.7 * density(x, 1.0);
+    double left = 0.3 * inner + 0.7 * density(x, -3.0);
+    double right = 0.3 * inner + 0.7 * density(x, 3.0);
+    expected += std::log(0.3 * left + 0.7 * right);
+  }
+
+  double serial = log_prob(nullptr);
+  util::ThreadBudget budget(4);
+  {
+    util::ChainScope chain_scope(&budget);
+    ASSERT_TRUE(util::use_parallel_kernel(40.0 * 2 * n));
+  }
+  double shared = log_prob(&budget);
+  EXPECT_NEAR(serial, expected, 1e-9 * std::abs(expected));
+  EXPECT_NEAR(shared, expected, 1e-9 * std::abs(expected));
+  // the helpers were given back
+  EXPECT_EQ(budget.try_acquire(10), 4);
+}
@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include <Eigen/Core>
+
+#include "beanmachine/graph/thread_pool.h"
+
+namespace beanmachine {
+namespace util {
+
+namespace {
+
+thread_local ThreadBudget* current_budget = nullptr;
+
+// The helper threads of all budgets. They are created on demand and live
+// for the rest of the process, waiting for ranges of parallel_for. Each
+// task stands for a helper acquired from some budget, so a worker is
+// started whenever a task finds no idle worker to take it; the pool then
+// grows to the most helpers ever outstanding across all budgets at once.
+class WorkerPool {
+ public:
+  static WorkerPool& instance() {
+    // never destroyed, since its detached threads may outlive main
+    static WorkerPool* pool = new WorkerPool();
+    return *pool;
+  }
+
+  void submit(std::function<void()> task) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      tasks.push_back(std::move(task));
+      if (tasks.size() > num_idle) {
+        // a new worker is idle until it takes a task
+        num_idle++;
+        std::thread([this]() { work(); }).detach();
+      }
+    }
+    cv.notify_one();
+  }
+
+ private:
+  void work() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      cv.wait(lock, [this]() { return not tasks.empty(); });
+      std::function<void()> task = std::move(tasks.front());
+      tasks.pop_front();
+      num_idle--;
+      lock.unlock();
+      task();
+      lock.lock();
+      num_idle++;
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<std::function<void()>> tasks;
+  // the workers waiting for a task, or started and about to wait
+  std::size_t num_idle = 0;
+};
+
+// The ranges of one parallel_for, shared with its helpers, which may start
+// after the calling thread has returned and then find no ranges left.
+struct ParallelWork {
+  const std::function<void(std::size_t, std::size_t)>* body;
+  std::size_t size;
+  std::size_t grain;
+  std::size_t num_ranges;
+  std::atomic<std::size_t> next_range{0};
+  std::mutex mutex;
+  std::condition_variable done_cv;
+  std::size_t num_done = 0;
+  std::exception_ptr error = nullptr;
+
+  void run_ranges() {
+    std::size_t range;
+    while ((range = next_range.fetch_add(1)) < num_ranges) {
+      std::size_t begin = range * grain;
+      std::size_t end = std::min(size, begin + grain);
+      std::exception_ptr range_error = nullptr;
+      try {
+        (*body)(begin, end);
+      } catch (...) {
+        range_error = std::current_exception();
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      if (range_error != nullptr and error == nullptr) {
+        error = range_error;
+      }
+      if (++num_done == num_ranges) {
+        done_cv.notify_all();
+      }
+    }
+  }
+};
+
+} // namespace
+
+ThreadBudget::ThreadBudget(unsigned max_threads)
+    : max_threads(max_threads), available(static_cast<int>(max_threads)) {
+  if (max_threads == 0) {
+    throw std::invalid_argument("a thread budget needs at least one thread");
+  }
+  eigen_threads = Eigen::nbThreads();
+#ifdef EIGEN_HAS_OPENMP
+  Eigen::setNbThreads(1);
+#endif
+}
+
+ThreadBudget::~ThreadBudget() {
+#ifdef EIGEN_HAS_OPENMP
+  Eigen::setNbThreads(eigen_threads);
+#endif
+}
+
+unsigned ThreadBudget::try_acquire(unsigned num_threads) {
+  int left = available.load();
+  int taken;
+  do {
+    taken = std::max(0, std::min(left, static_cast<int>(num_threads)));
+    if (taken == 0) {
+      return 0;
+    }
+  } while (not available.compare_exchange_weak(left, left - taken));
+  return static_cast<unsigned>(taken);
+}
+
+void ThreadBudget::release(unsigned num_threads) {
+  available += static_cast<int>(num_threads);
+}
+
+ThreadBudget* ThreadBudget::current() {
+  return current_budget;
+}
+
+ChainScope::ChainScope(ThreadBudget* budget)
+    : budget(budget), previous(current_budget) {
+  if (budget != nullptr) {
+    // a chain runs even if more chains than threads were asked for
+    budget->available--;
+    current_budget = budget;
+  }
+}
+
+ChainScope::~ChainScope() {
+  if (budget != nullptr) {
+    budget->release(1);
+    current_budget = previous;
+  }
+}
+
+bool use_parallel_kernel(double num_flops) {
+  return current_budget != nullptr and current_budget->get_max_threads() > 1 and
+      num_flops >= PARALLEL_KERNEL_THRESHOLD;
+}
+
+void parallel_for(
+    std::size_t size,
+    std::size_t grain,
+    const std::function<void(std::size_t, std::size_t)>& body) {
+  grain = std::max<std::size_t>(grain, 1);
+  std::size_t num_ranges = (size + grain - 1) / grain;
+  ThreadBudget* budget = current_budget;
+  unsigned num_helpers = 0;
+  if (budget != nullptr and num_ranges > 1) {
+    num_helpers = budget->try_acquire(static_cast<unsigned>(
+        std::min<std::size_t>(num_ranges - 1, budget->get_max_threads())));
+  }
+  if (num_helpers == 0) {
+    for (std::size_t begin = 0; begin < size; begin += grain) {
+      body(begin, std::min(size, begin + grain));
+    }
+    return;
+  }
+  auto work = std::make_shared<ParallelWork>();
+  work->body = &body;
+  work->size = size;
+  work->grain = grain;
+  work->num_ranges = num_ranges;
+  WorkerPool& pool = WorkerPool::instance();
+  for (unsigned i = 0; i < num_helpers; i++) {
+    pool.submit([work]() { work->run_ranges(); });
+  }
+  work->run_ranges();
+  {
+    std::unique_lock<std::mutex> lock(work->mutex);
+    work->done_cv.wait(
+        lock, [&work]() { return work->num_done == work->num_ranges; });
+  }
+  // helpers still queued will find no ranges left
+  budget->release(num_helpers);
+  if (work->error != nullptr) {
+    std::rethrow_exception(work->error);
+  }
+}
+
+bool try_parallel_invoke(
+    const std::function<void()>& first,
+    const std::function<void()>& second) {
+  ThreadBudget* budget = current_budget;
+  if (budget == nullptr or budget->try_acquire(1) == 0) {
+    return false;
+  }
+  // second is the only range, so the calling thread never takes it
+  std::function<void(std::size_t, std::size_t)> body =
+      [&second](std::size_t /* begin */, std::size_t /* end */) { second(); };
+  auto work = std::make_shared<ParallelWork>();
+  work->body = &body;
+  work->size = 1;
+  work->grain = 1;
+  work->num_ranges = 1;
+  WorkerPool::instance().submit([work]() { work->run_ranges(); });
+  std::exception_ptr error = nullptr;
+  try {
+    first();
+  } catch (...) {
+    error = std::current_exception();
+  }
+  {
+    std::unique_lock<std::mutex> lock(work->mutex);
+    work->done_cv.wait(lock, [&work]() { return work->num_done == 1; });
+  }
+  budget->release(1);
+  if (error == nullptr) {
+    error = work->error;
+  }
+  if (error != nullptr) {
+    std::rethrow_exception(error);
+  }
+  return true;
+}
+
+} // namespace util
+} // namespace beanmachine
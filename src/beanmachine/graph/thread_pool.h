@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <functional>
+
+namespace beanmachine {
+namespace util {
+
+/*
+A number of threads shared by the chains of an inference run and the large
+kernels (MATRIX_MULTIPLY, CHOLESKY, mixture log_prob_iid) they evaluate; see
+InferConfig::max_threads. Each running chain holds one thread of the
+budget, and a kernel evaluated by a chain may borrow the threads left over
+as helpers from the process-wide worker pool. So a run with fewer chains
+than threads spreads its kernels over the idle threads, and a run with as
+many chains as threads keeps its kernels single-threaded rather than
+oversubscribing the machine.
+
+While a budget is in use, Eigen's own OpenMP parallelism, if compiled in, is
+turned off, since it would not respect the budget.
+*/
+class ThreadBudget {
+ public:
+  // :param max_threads: The total number of threads, at least 1.
+  explicit ThreadBudget(unsigned max_threads);
+  ~ThreadBudget();
+  ThreadBudget(const ThreadBudget&) = delete;
+  ThreadBudget& operator=(const ThreadBudget&) = delete;
+
+  unsigned get_max_threads() const {
+    return max_threads;
+  }
+  // Takes up to num_threads threads, as many as are left, and returns how
+  // many were taken.
+  unsigned try_acquire(unsigned num_threads);
+  void release(unsigned num_threads);
+
+  // The budget of the chain running in the calling thread, or nullptr if
+  // its kernels are single-threaded.
+  static ThreadBudget* current();
+
+ private:
+  friend class ChainScope;
+  unsigned max_threads;
+  std::atomic<int> available;
+  int eigen_threads;
+};
+
+/*
+Runs a chain under a budget: for the lifetime of the scope, the calling
+thread holds one thread of the budget and its kernels may borrow the rest.
+A null budget leaves the calling thread as it is.
+*/
+class ChainScope {
+ public:
+  explicit ChainScope(ThreadBudget* budget);
+  ~ChainScope();
+  ChainScope(const ChainScope&) = delete;
+  ChainScope& operator=(const ChainScope&) = delete;
+
+ private:
+  ThreadBudget* budget;
+  ThreadBudget* previous;
+};
+
+/*
+Whether a kernel of the given number of floating point operations should
+be split with parallel_for, i.e. the calling thread runs under a budget
+with more than one thread and the kernel is at least
+PARALLEL_KERNEL_THRESHOLD.
+*/
+constexpr double PARALLEL_KERNEL_THRESHOLD = 1 << 18;
+bool use_parallel_kernel(double num_flops);
+
+/*
+Calls body(begin, end) on consecutive ranges covering [0, size). The ranges
+only depend on size and grain, so the results do not depend on how many
+helper threads are available. The calling thread runs ranges too, and
+helpers are borrowed from the budget of the calling thread only while
+ranges remain; without a budget the ranges run in order in the calling
+thread. Kernels run by helpers are single-threaded. Exceptions thrown by
+body are rethrown in the calling thread after all the ranges have run.
+
+:param size: The number of items.
+:param grain: The number of items of each range but the last, at least 1.
+:param body: The work on a range, safe to run concurrently on others.
+*/
+void parallel_for(
+    std::size_t size,
+    std::size_t grain,
+    const std::function<void(std::size_t, std::size_t)>& body);
+
+/*
+Runs first in the calling thread and second on a helper thread at the same
+time, if a helper can be borrowed from the budget of the calling thread;
+otherwise runs neither. Unlike parallel_for, the caller decides what to do
+without a helper (e.g. skip optional work). Exceptions thrown by either
+function are rethrown in the calling thread after both have run.
+
+:param first: The work of the calling thread.
+:param second: The work of the helper, safe to run concurrently with first.
+:returns: Whether a helper was borrowed and both functions ran.
+*/
+bool try_parallel_invoke(
+    const std::function<void()>& first,
+    const std::function<void()>& second);
+
+} // namespace util
+} // namespace beanmachine
@@ -113,6 +113,8 @@ class DOT {
         return "Gamma";
       case DistributionType::BIMIXTURE:
         return "Bimixture";
+      case DistributionType::MIXTURE:
+        return "Mixture";
       case DistributionType::CATEGORICAL:
         return "Categorical";
       case DistributionType::HALF_NORMAL: